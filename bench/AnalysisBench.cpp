@@ -0,0 +1,290 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <math.h>
+
+#include "SpectrumAnalyzer.h"
+
+/**
+\file AnalysisBench.cpp
+\brief Compares single-plan and batched analysis throughput.
+
+Generates a synthetic track, one hour long by default, and analyses it with one plan execution
+per frame and then with one fftw_plan_many_dft_r2c execution per block of fftFramesPerBlock
+frames. Reports frames per second for each path. Needs no window or audio device. --hop and
+--window run the same comparison on overlapping, windowed frames.
+
+Then reads the history of every band, from a fresh analysis and from the same analysis mapped
+back from the cache in --cache, with the results laid out as --layout says, frame or band major.
+
+--precision compare instead analyses the signal in double and in single precision and reports
+the worst difference of a band peak, as a fraction of that band's peak over the whole track.
+It fails above 1e-4, the error SinglePrecisionAnalysis is allowed.
+
+Build from this folder with, for example,
+
+~~~~~~~~~~~~~~~{.sh}
+g++ -O2 -std=c++11 -I../src AnalysisBench.cpp ../src/SpectrumAnalyzer.cpp ../src/FftPlanCache.cpp ../src/AnalysisKernels.cpp ../src/BandLayout.cpp ../src/WindowFunction.cpp ../src/MappedFile.cpp ../src/AnalysisCache.cpp ../src/AnalysisResult.cpp ../src/SpectralTimeline.cpp ../src/FileUtil.cpp ../src/OnsetDetector.cpp ../src/ConstantQKernel.cpp -lfftw3 -lfftw3f -lpthread -o AnalysisBench
+./AnalysisBench --seconds 3600 --threads 1 --precision single --hop 256 --window hann
+./AnalysisBench --seconds 600 --layout band --cache bench_cache
+./AnalysisBench --seconds 600 --precision compare --hop 256 --window hann
+~~~~~~~~~~~~~~~
+
+*/
+
+/// Worst band peak error of single precision, as a fraction of the band's overall peak.
+static const double PrecisionLimit = 1e-4;
+
+/**
+\brief Fill the buffer with a few tones over a little noise, scaled like 16 bit samples.
+
+*/
+
+static void makeSignal(std::vector<double>& samples, unsigned int rate)
+{
+    unsigned int seed = 12345;
+    for (std::size_t i = 0; i < samples.size(); i++)
+    {
+        double t = (double) i / rate;
+        seed = seed * 1664525u + 1013904223u;
+        double noise = ((seed >> 9) / (double) (1 << 23)) - 0.5;
+        samples[i] = 8000 * sin(2 * PI * 60 * t) + 6000 * sin(2 * PI * 440 * t)
+                   + 3000 * sin(2 * PI * 3000 * t) + 2000 * noise;
+    }
+}
+
+/**
+\brief Analyse the samples once and return the time taken in seconds.
+
+*/
+
+static double timeAnalysis(std::vector<double>& samples, std::vector<float>& samplesF, unsigned int rate,
+                           unsigned threads, bool batch, int hop, WindowType window, int* frames)
+{
+    SpectrumAnalyzer analyzer;
+    if (samplesF.empty())
+        analyzer.setSamples(&samples[0], samples.size(), rate);
+    else
+        analyzer.setSamples(&samplesF[0], samplesF.size(), rate);
+    analyzer.setThreadCount(threads);
+    analyzer.setBatchMode(batch);
+    analyzer.setHopSize(hop);
+    analyzer.setWindow(window);
+    *frames = analyzer.getNumFrames();
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    analyzer.performFFT();
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double>(end - start).count();
+}
+
+/**
+\brief Read the history of every band once and return the time taken in seconds.
+
+\param analyzer --- a finished analysis.
+\param sum --- output, the sum of every value read, so the reads are not optimised away.
+
+*/
+
+static double timeBandReads(SpectrumAnalyzer& analyzer, double* sum)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    double total = 0;
+    for (int v = 0; v < analyzer.getViewCount(); v++)
+    {
+        for (int b = 0; b < analyzer.getBandCount(); b++)
+        {
+            ValueSpan history = analyzer.getBand(b, v);
+            for (std::size_t f = 0; f < history.count; f++)
+                total += history[f];
+        }
+    }
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+    *sum = total;
+    return std::chrono::duration<double>(end - start).count();
+}
+
+/**
+\brief Analyse the samples with a result layout, then time reading every band fresh and from the cache.
+
+\param cacheDir --- the cache folder, the first run there saves the result and later ones map it.
+
+\return False if the mapped result does not match the fresh one.
+
+*/
+
+static bool benchLayout(std::vector<double>& samples, std::vector<float>& samplesF, unsigned int rate, unsigned threads,
+                        int hop, WindowType window, ResultLayout layout, const std::string& cacheDir)
+{
+    SpectrumAnalyzer fresh, cached, mapped;
+    SpectrumAnalyzer* runs[3] = {&fresh, &cached, &mapped};
+    for (int r = 0; r < 3; r++)
+    {
+        if (samplesF.empty())
+            runs[r]->setSamples(&samples[0], samples.size(), rate);
+        else
+            runs[r]->setSamples(&samplesF[0], samplesF.size(), rate);
+        runs[r]->setThreadCount(threads);
+        runs[r]->setHopSize(hop);
+        runs[r]->setWindow(window);
+        runs[r]->setResultLayout(layout);
+        if (r > 0)
+            runs[r]->setCacheDirectory(cacheDir); // the first of these saves the result if the cache has none yet
+        runs[r]->performFFT();
+    }
+
+    double freshSum, mappedSum;
+    double freshTime = timeBandReads(fresh, &freshSum);
+    double mappedTime = timeBandReads(mapped, &mappedSum);
+    double values = (double) fresh.getNumFrames() * fresh.getBandCount() * fresh.getViewCount();
+
+    printf("%s major band reads %10.0f values/s fresh %10.0f values/s mapped\n",
+           layout == ResultBandMajor ? "band" : "frame", values / freshTime, values / mappedTime);
+    return freshSum == mappedSum;
+}
+
+/**
+\brief Analyse the samples in double and in single precision and compare the band peaks.
+
+\return The worst difference of a band peak over every frame, band and view, as a fraction of
+that band's peak over the whole track in double precision.
+
+*/
+
+static double comparePrecision(std::vector<double>& samples, unsigned int rate, unsigned threads, int hop, WindowType window)
+{
+    std::vector<float> samplesF(samples.begin(), samples.end());
+    SpectrumAnalyzer precise, single;
+    precise.setSamples(&samples[0], samples.size(), rate);
+    single.setSamples(&samplesF[0], samplesF.size(), rate);
+    SpectrumAnalyzer* runs[2] = {&precise, &single};
+    for (int r = 0; r < 2; r++)
+    {
+        runs[r]->setThreadCount(threads);
+        runs[r]->setHopSize(hop);
+        runs[r]->setWindow(window);
+        runs[r]->performFFT();
+    }
+
+    int bands = precise.getBandCount();
+    std::vector<double> peak(bands), a(bands), b(bands);
+    double worst = 0;
+    for (int v = 0; v < precise.getViewCount(); v++)
+    {
+        precise.getMaxMag(&peak[0], v);
+        for (int f = 0; f < precise.getNumFrames(); f++)
+        {
+            precise.getFrameMags(f, &a[0], v);
+            single.getFrameMags(f, &b[0], v);
+            for (int k = 0; k < bands; k++)
+            {
+                double error = (peak[k] > 0) ? fabs(a[k] - b[k]) / peak[k] : 0;
+                worst = (error > worst) ? error : worst;
+            }
+        }
+    }
+    return worst;
+}
+
+/**
+\brief Benchmark entry point.
+
+\return EXIT_SUCCESS, or EXIT_FAILURE if a result mapped from the cache differs from the fresh one,
+or with --precision compare if single precision is off by more than PrecisionLimit.
+
+*/
+
+int main(int argc, char** argv)
+{
+    double seconds = 3600;
+    unsigned int rate = 44100;
+    unsigned threads = 1;
+    int repeats = 3;
+    bool single = false;
+    bool compare = false;
+    int hop = fftBuffer;
+    WindowType window = WindowRectangular;
+    ResultLayout layout = ResultFrameMajor;
+    std::string cacheDir = "bench_cache";
+
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "--seconds") == 0)
+            seconds = atof(argv[i + 1]);
+        else if (strcmp(argv[i], "--rate") == 0)
+            rate = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--threads") == 0)
+            threads = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--repeats") == 0)
+            repeats = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--precision") == 0)
+        {
+            single = strcmp(argv[i + 1], "single") == 0;
+            compare = strcmp(argv[i + 1], "compare") == 0;
+        }
+        else if (strcmp(argv[i], "--hop") == 0)
+            hop = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--layout") == 0)
+            layout = (strcmp(argv[i + 1], "band") == 0) ? ResultBandMajor : ResultFrameMajor;
+        else if (strcmp(argv[i], "--cache") == 0)
+            cacheDir = argv[i + 1];
+        else if (strcmp(argv[i], "--window") == 0)
+        {
+            for (int w = WindowRectangular; w <= WindowKaiser; w++)
+                if (strcmp(argv[i + 1], windowName((WindowType) w)) == 0)
+                    window = (WindowType) w;
+        }
+    }
+
+    std::vector<double> samples((std::size_t) (seconds * rate));
+    std::vector<float> samplesF;
+    makeSignal(samples, rate);
+    if (compare)
+    {
+        double worst = comparePrecision(samples, rate, threads, hop, window);
+        printf("%.0f s at %u Hz, hop %d, %s window: single precision band peaks within %.2e of the band's peak, limit %.0e\n",
+               seconds, rate, hop, windowName(window), worst, PrecisionLimit);
+        return (worst <= PrecisionLimit) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if (single)
+    {
+        samplesF.assign(samples.begin(), samples.end());
+        std::vector<double>().swap(samples);
+    }
+    SpectrumAnalyzer counter;
+    counter.setSamples((double*) NULL, (std::uint64_t) (seconds * rate), rate);
+    counter.setHopSize(hop);
+    int frames = counter.getNumFrames();
+
+    printf("%.0f s at %u Hz, %d frames, hop %d, %s window, %u thread(s), %s precision (%s kernels), best of %d\n",
+           seconds, rate, frames, hop, windowName(window), threads, single ? "single" : "double",
+           magnitudeKernelName(), repeats);
+
+    // The first run of each path builds its plans, later runs take them from the cache.
+    const char* names[2] = {"single-plan", "batched"};
+    double best[2];
+    for (int path = 0; path < 2; path++)
+    {
+        best[path] = 0;
+        for (int r = 0; r <= repeats; r++)
+        {
+            double t = timeAnalysis(samples, samplesF, rate, threads, path == 1, hop, window, &frames);
+            if (r > 0 && (best[path] == 0 || t < best[path]))
+                best[path] = t;
+        }
+        printf("%-12s %10.3f s %14.0f frames/s\n", names[path], best[path], frames / best[path]);
+    }
+
+    printf("speedup      %10.2fx\n", best[0] / best[1]);
+
+    if (!benchLayout(samples, samplesF, rate, threads, hop, window, layout, cacheDir))
+    {
+        printf("the result mapped from %s differs from the fresh one\n", cacheDir.c_str());
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,400 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <math.h>
+
+#include "SpectrumAnalyzer.h"
+
+/**
+\file AnalysisKernelsBench.cpp
+\brief Times each stage of the analysis on its own, in ns per frame and GB/s.
+
+Generates a synthetic interleaved 16 bit track of any length, sample rate and channel count and
+runs the analysis stages over it block by block, as a worker does, timing every stage apart:
+
+- convert, the samples mixed down or converted and windowed into the FFT input,
+- plan, a fresh plan for one block, and a lookup in FftPlanCache,
+- transform, the batched real FFT of each block,
+- magnitudes, computeMagnitudes over each block's spectra,
+- bands, the bin to band max through the BandLayout table and the running band maxima,
+- normalise, each frame's bands scaled by the track maxima with normaliseBands,
+
+and then the whole of SpectrumAnalyzer::performFFT on one thread for comparison.  GB/s counts the
+bytes each stage reads and writes, so it shows how near a stage is to the memory bandwidth.
+Needs no window or audio device; the best of --repeats runs is kept, after one warm-up run.
+
+Build from this folder with, for example,
+
+~~~~~~~~~~~~~~~{.sh}
+g++ -O2 -std=c++11 -I../src AnalysisKernelsBench.cpp ../src/SpectrumAnalyzer.cpp ../src/FftPlanCache.cpp ../src/AnalysisKernels.cpp ../src/BandLayout.cpp ../src/WindowFunction.cpp ../src/MappedFile.cpp ../src/AnalysisCache.cpp ../src/AnalysisResult.cpp ../src/SpectralTimeline.cpp ../src/FileUtil.cpp ../src/OnsetDetector.cpp ../src/ConstantQKernel.cpp -lfftw3 -lfftw3f -lpthread -o AnalysisKernelsBench
+./AnalysisKernelsBench --seconds 600 --rate 48000 --channels 2 --precision single --bands 64
+~~~~~~~~~~~~~~~
+
+*/
+
+/**
+\brief The FFTW types of each precision.
+
+*/
+
+template <typename T> struct FftTypes;
+
+template <> struct FftTypes<double>
+{
+    typedef fftw_complex Complex;
+    typedef fftw_plan Plan;
+};
+
+template <> struct FftTypes<float>
+{
+    typedef fftwf_complex Complex;
+    typedef fftwf_plan Plan;
+};
+
+/**
+\brief Thin overloads over the FFTW calls of each precision.
+
+*/
+
+static double* allocReal(double*, std::size_t n) { return fftw_alloc_real(n); }
+static float* allocReal(float*, std::size_t n) { return fftwf_alloc_real(n); }
+static fftw_complex* allocComplex(double*, std::size_t n) { return fftw_alloc_complex(n); }
+static fftwf_complex* allocComplex(float*, std::size_t n) { return fftwf_alloc_complex(n); }
+static void freeBuffer(void* p, double*) { fftw_free(p); }
+static void freeBuffer(void* p, float*) { fftwf_free(p); }
+
+static fftw_plan makePlan(int n, int howmany, double* in, fftw_complex* out, unsigned flags)
+{
+    return fftw_plan_many_dft_r2c(1, &n, howmany, in, NULL, 1, n, out, NULL, 1, n / 2 + 1, flags);
+}
+
+static fftwf_plan makePlan(int n, int howmany, float* in, fftwf_complex* out, unsigned flags)
+{
+    return fftwf_plan_many_dft_r2c(1, &n, howmany, in, NULL, 1, n, out, NULL, 1, n / 2 + 1, flags);
+}
+
+static void destroyPlan(fftw_plan plan) { fftw_destroy_plan(plan); }
+static void destroyPlan(fftwf_plan plan) { fftwf_destroy_plan(plan); }
+static void execute(fftw_plan plan, double* in, fftw_complex* out) { fftw_execute_dft_r2c(plan, in, out); }
+static void execute(fftwf_plan plan, float* in, fftwf_complex* out) { fftwf_execute_dft_r2c(plan, in, out); }
+
+/**
+\brief Fill the buffer with a few tones over a little noise, interleaved 16 bit, a different mix per channel.
+
+*/
+
+static void makeSignal(std::vector<std::int16_t>& samples, unsigned int rate, unsigned channels)
+{
+    unsigned int seed = 12345;
+    std::size_t frames = samples.size() / channels;
+    for (std::size_t i = 0; i < frames; i++)
+    {
+        double t = (double) i / rate;
+        for (unsigned c = 0; c < channels; c++)
+        {
+            seed = seed * 1664525u + 1013904223u;
+            double noise = ((seed >> 9) / (double) (1 << 23)) - 0.5;
+            samples[i * channels + c] = (std::int16_t) (8000 * sin(2 * PI * 60 * (c + 1) * t)
+                                      + 6000 * sin(2 * PI * 440 * t) + 3000 * sin(2 * PI * 3000 * t) + 2000 * noise);
+        }
+    }
+}
+
+/**
+\brief Seconds since a time point.
+
+*/
+
+static double since(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+\brief What one stage cost over the whole track.
+
+*/
+
+struct StageTime
+{
+    const char* name;   ///< Printed name.
+    double seconds;     ///< Best time over the track.
+    double bytes;       ///< Bytes read and written over the track.
+};
+
+/**
+\brief Run every stage over the track once, adding each stage's time to its slot.
+
+\param samples --- the interleaved track.
+\param channels --- samples per frame of the track.
+\param hop --- samples between frames.
+\param layout --- the band layout reduced to.
+\param rate --- sample rate.
+\param times --- convert, transform, magnitudes, bands and normalise, in that order.
+
+\return The number of frames analysed.
+
+*/
+
+template <typename T>
+static int runStages(const std::vector<std::int16_t>& samples, unsigned channels, int hop, const BandLayout& layout,
+                     unsigned int rate, double* times)
+{
+    typedef typename FftTypes<T>::Complex Complex;
+    typedef typename FftTypes<T>::Plan Plan;
+
+    const int n = fftBuffer;
+    const int rowLen = n / 2 + 1;
+    const int bands = layout.getBandCount();
+    std::uint64_t length = samples.size() / channels;
+    int frames = (length < (std::uint64_t) n) ? 0 : (int) ((length - n) / hop + 1);
+
+    std::vector<double> windowD;
+    buildWindow(WindowHann, n, windowD);
+    std::vector<T> window(windowD.begin(), windowD.end());
+    std::vector<int> table;
+    layout.buildBinTable(rate, n, table);
+
+    T* in = allocReal((T*) NULL, (std::size_t) n * fftFramesPerBlock);
+    Complex* out = allocComplex((T*) NULL, (std::size_t) rowLen * fftFramesPerBlock);
+    std::vector<T> mags((std::size_t) rowLen * fftFramesPerBlock);
+    std::vector<float> planar(n);
+    std::vector<double> peaks((std::size_t) frames * bands);
+    std::vector<double> bandMax(bands, 0.0);
+    std::vector<double> bandPeak(bands + 1);
+    std::vector<float> levels(bands);
+
+    Plan plan = FftPlanCache::instance().getManyR2C(n, fftFramesPerBlock, in, out);
+
+    for (int frame = 0; frame < frames; frame += fftFramesPerBlock)
+    {
+        int rows = (frames - frame < fftFramesPerBlock) ? frames - frame : fftFramesPerBlock;
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (int r = 0; r < rows; r++)
+        {
+            std::uint64_t first = (std::uint64_t) (frame + r) * hop;
+            if (channels == 1)
+                windowSamples(&samples[0], SampleInt16, first, &window[0], in + (std::size_t) r * n, n);
+            else
+            {
+                downmix(&samples[0], SampleInt16, channels, first, &planar[0], n);
+                windowFrame(&planar[0], &window[0], in + (std::size_t) r * n, n);
+            }
+        }
+        times[0] += since(start);
+
+        start = std::chrono::steady_clock::now();
+        execute(plan, in, out); // a short last block transforms stale rows, as the analysis does
+        times[1] += since(start);
+
+        start = std::chrono::steady_clock::now();
+        computeMagnitudes(out, &mags[0], rows * rowLen);
+        times[2] += since(start);
+
+        start = std::chrono::steady_clock::now();
+        for (int r = 0; r < rows; r++)
+        {
+            for (int b = 0; b <= bands; b++)
+                bandPeak[b] = 0;
+            gatherMax(&mags[(std::size_t) r * rowLen], &table[0], n / 2, &bandPeak[0]);
+            double* framePeak = &peaks[(std::size_t) (frame + r) * bands];
+            for (int b = 0; b < bands; b++)
+            {
+                framePeak[b] = bandPeak[b];
+                bandMax[b] = (bandPeak[b] > bandMax[b]) ? bandPeak[b] : bandMax[b];
+            }
+        }
+        times[3] += since(start);
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int f = 0; f < frames; f++)
+        normaliseBands(&peaks[(std::size_t) f * bands], &bandMax[0], &levels[0], bands);
+    times[4] += since(start);
+
+    freeBuffer(in, (T*) NULL);
+    freeBuffer(out, (T*) NULL);
+    return frames;
+}
+
+/**
+\brief Time building a fresh plan for one block, and a plan cache lookup.
+
+\param times --- output, seconds per estimated plan, per measured plan and per lookup.
+
+*/
+
+template <typename T>
+static void timePlans(double* times)
+{
+    typedef typename FftTypes<T>::Complex Complex;
+    typedef typename FftTypes<T>::Plan Plan;
+
+    const int n = fftBuffer;
+    T* in = allocReal((T*) NULL, (std::size_t) n * fftFramesPerBlock);
+    Complex* out = allocComplex((T*) NULL, (std::size_t) (n / 2 + 1) * fftFramesPerBlock);
+
+    const unsigned flags[2] = {FFTW_ESTIMATE, FFTW_MEASURE};
+    for (int f = 0; f < 2; f++)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        Plan plan = makePlan(n, fftFramesPerBlock, in, out, flags[f]); // measure may reuse saved wisdom
+        times[f] = since(start);
+        destroyPlan(plan);
+    }
+
+    FftPlanCache::instance().getManyR2C(n, fftFramesPerBlock, in, out);
+    const int lookups = 1000;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < lookups; i++)
+        FftPlanCache::instance().getManyR2C(n, fftFramesPerBlock, in, out);
+    times[2] = since(start) / lookups;
+
+    freeBuffer(in, (T*) NULL);
+    freeBuffer(out, (T*) NULL);
+}
+
+/**
+\brief Time performFFT over the track on one thread.
+
+*/
+
+static double timeAnalysis(const std::vector<std::int16_t>& samples, unsigned channels, unsigned int rate,
+                           bool single, int hop, const BandLayout& layout)
+{
+    SampleSpan span;
+    span.data = &samples[0];
+    span.format = SampleInt16;
+    span.count = samples.size();
+    span.channels = channels;
+
+    SpectrumAnalyzer analyzer;
+    analyzer.setSamples(span, rate, single);
+    analyzer.setThreadCount(1);
+    analyzer.setHopSize(hop);
+    analyzer.setWindow(WindowHann);
+    analyzer.setBandLayout(layout);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    analyzer.performFFT();
+    return since(start);
+}
+
+/**
+\brief Print one line of the report.
+
+*/
+
+static void report(const char* name, double seconds, double bytes, int frames)
+{
+    if (bytes > 0)
+        printf("%-14s %12.1f ns/frame %10.2f GB/s\n", name, seconds * 1e9 / frames, bytes / seconds * 1e-9);
+    else
+        printf("%-14s %12.1f ns/frame\n", name, seconds * 1e9 / frames);
+}
+
+/**
+\brief Benchmark entry point.
+
+\return EXIT_SUCCESS
+
+*/
+
+int main(int argc, char** argv)
+{
+    double seconds = 600;
+    unsigned int rate = 44100;
+    unsigned channels = 2;
+    int repeats = 5;
+    bool single = SinglePrecisionAnalysis;
+    int hop = AnalysisHopSize;
+    int bands = 64;
+
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "--seconds") == 0)
+            seconds = atof(argv[i + 1]);
+        else if (strcmp(argv[i], "--rate") == 0)
+            rate = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--channels") == 0)
+            channels = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--repeats") == 0)
+            repeats = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--precision") == 0)
+            single = strcmp(argv[i + 1], "single") == 0;
+        else if (strcmp(argv[i], "--hop") == 0)
+            hop = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--bands") == 0)
+            bands = atoi(argv[i + 1]);
+    }
+    channels = (channels < 1) ? 1 : channels;
+    hop = (hop < 1) ? 1 : hop;
+    repeats = (repeats < 1) ? 1 : repeats;
+
+    std::vector<std::int16_t> samples((std::size_t) (seconds * rate) * channels);
+    makeSignal(samples, rate, channels);
+    BandLayout layout(BandLogarithmic, bands);
+
+    const int stageCount = 5;
+    double best[stageCount] = {0, 0, 0, 0, 0};
+    int frames = 0;
+    for (int r = 0; r <= repeats; r++)
+    {
+        double times[stageCount] = {0, 0, 0, 0, 0};
+        frames = single ? runStages<float>(samples, channels, hop, layout, rate, times)
+                        : runStages<double>(samples, channels, hop, layout, rate, times);
+        for (int s = 0; r > 0 && s < stageCount; s++)
+            best[s] = (best[s] == 0 || times[s] < best[s]) ? times[s] : best[s];
+    }
+    if (frames == 0)
+    {
+        printf("the track is shorter than one frame\n");
+        return EXIT_SUCCESS;
+    }
+
+    double plans[3];
+    if (single)
+        timePlans<float>(plans);
+    else
+        timePlans<double>(plans);
+
+    double total = 0;
+    for (int r = 0; r <= repeats; r++)
+    {
+        double t = timeAnalysis(samples, channels, rate, single, hop, layout);
+        total = (r == 1 || (r > 1 && t < total)) ? t : total;
+    }
+
+    printf("%.0f s at %u Hz, %u channel(s), %d frames of %d, hop %d, %d bands, %s precision (%s kernels), best of %d\n",
+           seconds, rate, channels, frames, fftBuffer, hop, bands, single ? "single" : "double",
+           magnitudeKernelName(), repeats);
+
+    double real = single ? sizeof(float) : sizeof(double);
+    double rowLen = fftBuffer / 2 + 1;
+    double blocks = (frames + fftFramesPerBlock - 1) / fftFramesPerBlock;
+    StageTime stages[stageCount] = {
+        {"convert", best[0], (double) frames * fftBuffer * (channels * sizeof(std::int16_t) + real + real)},
+        {"transform", best[1], blocks * fftFramesPerBlock * (fftBuffer * real + rowLen * 2 * real)},
+        {"magnitudes", best[2], (double) frames * rowLen * 3 * real},
+        {"bands", best[3], (double) frames * (fftBuffer / 2 * (real + sizeof(int)) + bands * sizeof(double))},
+        {"normalise", best[4], (double) frames * bands * (2 * sizeof(double) + sizeof(float))}
+    };
+
+    double sum = 0;
+    for (int s = 0; s < stageCount; s++)
+    {
+        report(stages[s].name, stages[s].seconds, stages[s].bytes, frames);
+        sum += stages[s].seconds;
+    }
+    report("stages", sum, 0, frames);
+    report("performFFT", total, 0, frames);
+
+    printf("plan estimate  %12.1f us, %.1f ns/frame over the track\n", plans[0] * 1e6, plans[0] * 1e9 / frames);
+    printf("plan measure   %12.1f us, %.1f ns/frame over the track\n", plans[1] * 1e6, plans[1] * 1e9 / frames);
+    printf("plan lookup    %12.1f ns\n", plans[2] * 1e9);
+
+    return EXIT_SUCCESS;
+}
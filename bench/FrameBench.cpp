@@ -0,0 +1,382 @@
+#ifdef __APPLE__
+#include <OpenGL/gl3.h>
+#include <OpenGL/glu.h>
+#else
+#include <GL/glew.h>
+#endif // __APPLE__
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <math.h>
+
+#include "GraphicsEngine.h"
+
+/**
+\file FrameBench.cpp
+\brief Times whole frames of the visualiser, with a generated track and a scripted camera.
+
+Writes a test track of sweeps, pink noise and impulses, opens GraphicsEngine on it with vertical
+sync off and draws a fixed number of frames while a camera script switches between the spherical
+camera and the yaw-pitch-roll camera.  Each frame's display time, GL submit time and buffer swap
+time, see GraphicsEngine::getFrameTiming, are kept, and their p50, p95 and p99 are written to a
+JSON file together with the GL renderer, so runs on different machines and builds compare alike.
+
+Frames are only timed once the analysis of the track has finished, so the worker threads do not
+compete with the render thread, and after --warmup frames to let the driver settle.  The camera
+script only depends on the frame number, every run sees the same views.
+
+Run it from the folder with the shaders, VertexShaderBasic3D.glsl and PassThroughFrag.glsl.  It
+needs an OpenGL 3.3 core context, not a GPU.  On a machine without one, Mesa's llvmpipe software
+renderer works, under Xvfb when there is no display:
+
+~~~~~~~~~~~~~~~{.sh}
+LIBGL_ALWAYS_SOFTWARE=1 GALLIUM_DRIVER=llvmpipe xvfb-run -s "-screen 0 1280x1024x24" ./FrameBench --frames 2000 --out llvmpipe.json
+~~~~~~~~~~~~~~~
+
+Older Mesa releases only offer a compatibility context by default, MESA_GL_VERSION_OVERRIDE=3.3
+turns on the core one.  The renderer string in the JSON tells llvmpipe runs from hardware ones.
+
+Build from this folder with, for example,
+
+~~~~~~~~~~~~~~~{.sh}
+g++ -O2 -std=c++11 -I../src FrameBench.cpp ../src/GraphicsEngine.cpp ../src/fft_SFML.cpp ../src/Track.cpp ../src/Cube.cpp ../src/Axes.cpp ../src/LoadShaders.cpp ../src/SphericalCamera.cpp ../src/YPRCamera.cpp ../src/AudioStream.cpp ../src/DecodePipeline.cpp ../src/PreparedTrack.cpp ../src/Playlist.cpp ../src/StreamAnalyzer.cpp ../src/LiveAnalyzer.cpp ../src/LiveCapture.cpp ../src/BandSmoother.cpp ../src/FrameProfiler.cpp ../src/FrameGraph.cpp ../src/SpectrumAnalyzer.cpp ../src/FftPlanCache.cpp ../src/AnalysisKernels.cpp ../src/BandLayout.cpp ../src/WindowFunction.cpp ../src/WavFile.cpp ../src/MappedFile.cpp ../src/AnalysisCache.cpp ../src/AnalysisResult.cpp ../src/SpectralTimeline.cpp ../src/FileUtil.cpp ../src/OnsetDetector.cpp ../src/ConstantQKernel.cpp -lsfml-graphics -lsfml-window -lsfml-audio -lsfml-system -lGLEW -lGLU -lGL -lfftw3 -lfftw3f -lpthread -o FrameBench
+~~~~~~~~~~~~~~~
+
+*/
+
+/**
+\brief Write a 16 bit stereo WAV file of a log sweep, pink noise and impulses, a third each.
+
+\param path --- the file to write.
+\param rate --- sample rate.
+\param seconds --- length of the track.
+
+\return False if the file could not be written.
+
+*/
+
+static bool writeTestTrack(const std::string& path, unsigned int rate, double seconds)
+{
+    const unsigned channels = 2;
+    std::size_t frames = (std::size_t) (seconds * rate);
+    std::size_t third = frames / 3;
+    std::vector<std::int16_t> samples(frames * channels);
+
+    unsigned int seed = 12345;
+    double b0 = 0, b1 = 0, b2 = 0; // pink noise filter state
+    double phase = 0;
+    for (std::size_t i = 0; i < frames; i++)
+    {
+        double left = 0;
+        double right = 0;
+        if (i < third)
+        {
+            // 20 Hz to 20 kHz, the same on both channels.
+            double freq = 20 * pow(1000.0, (double) i / third);
+            phase += 2 * PI * freq / rate;
+            left = right = 0.5 * sin(phase);
+        }
+        else if (i < 2 * third)
+        {
+            // White noise through Paul Kellet's economy pink filter, the right channel a little quieter.
+            seed = seed * 1664525u + 1013904223u;
+            double white = ((seed >> 9) / (double) (1 << 23)) - 0.5;
+            b0 = 0.99765 * b0 + white * 0.0990460;
+            b1 = 0.96300 * b1 + white * 0.2965164;
+            b2 = 0.57000 * b2 + white * 1.0526913;
+            left = (b0 + b1 + b2 + white * 0.1848) * 0.5;
+            right = left * 0.7;
+        }
+        else
+        {
+            // Four clicks a second, each a few samples of a decaying burst.
+            std::size_t since = (i - 2 * third) % (rate / 4);
+            left = right = (since < 64) ? 0.9 * exp(-(double) since / 8) * ((since & 1) ? -1 : 1) : 0;
+        }
+        left = (left > 1) ? 1 : ((left < -1) ? -1 : left);
+        right = (right > 1) ? 1 : ((right < -1) ? -1 : right);
+        samples[i * channels] = (std::int16_t) (left * 32767);
+        samples[i * channels + 1] = (std::int16_t) (right * 32767);
+    }
+
+    FILE* file = fopen(path.c_str(), "wb");
+    if (file == NULL)
+        return false;
+
+    // Little endian header fields, written a byte at a time.
+    unsigned char header[44];
+    unsigned int dataBytes = (unsigned int) (samples.size() * sizeof(std::int16_t));
+    unsigned int fields[] = {36 + dataBytes, 16, (1u << 16) | channels, rate, rate * channels * 2,
+                             (16u << 16) | (channels * 2), dataBytes};
+    memcpy(header, "RIFF", 4);
+    memcpy(header + 8, "WAVEfmt ", 8);
+    memcpy(header + 36, "data", 4);
+    const int offsets[] = {4, 16, 20, 24, 28, 32, 40};
+    for (int f = 0; f < 7; f++)
+        for (int b = 0; b < 4; b++)
+            header[offsets[f] + b] = (unsigned char) (fields[f] >> (8 * b));
+
+    bool written = fwrite(header, 1, sizeof(header), file) == sizeof(header);
+    for (std::size_t i = 0; written && i < samples.size(); i++)
+    {
+        unsigned char bytes[2] = {(unsigned char) (samples[i] & 0xff), (unsigned char) ((samples[i] >> 8) & 0xff)};
+        written = fwrite(bytes, 1, 2, file) == 2;
+    }
+    return (fclose(file) == 0) && written;
+}
+
+/**
+\brief Move the camera for one frame of the script.
+
+Four segments of segmentFrames each, over and over: an orbit with the spherical camera, the
+yaw-pitch-roll camera flying along the track, the spherical camera zooming in and out, and the
+yaw-pitch-roll camera again.
+
+*/
+
+static void stepCamera(GraphicsEngine& ge, int frame, int segmentFrames)
+{
+    int step = frame % segmentFrames;
+    switch ((frame / segmentFrames) % 4)
+    {
+    case 0:
+        if (step == 0)
+        {
+            ge.setSphericalCameraOn();
+            ge.getSphericalCamera()->setPosition(30, 30, 20);
+        }
+        ge.getSphericalCamera()->addTheta(1);
+        ge.getSphericalCamera()->setPsi(20 + 10 * sin(2 * PI * step / segmentFrames));
+        break;
+    case 2:
+        if (step == 0)
+        {
+            ge.setSphericalCameraOn();
+            ge.getSphericalCamera()->setPosition(30, 60, 30);
+        }
+        ge.getSphericalCamera()->setR(20 + 15 * cos(2 * PI * step / segmentFrames));
+        break;
+    default:
+        if (step == 0)
+            ge.setYPRCameraOn(); // display moves it along the track
+        break;
+    }
+}
+
+/**
+\brief The percentiles of one timing, in milliseconds.
+
+*/
+
+struct TimingSummary
+{
+    double mean;    ///< Mean.
+    double p50;     ///< Median.
+    double p95;     ///< 95th percentile.
+    double p99;     ///< 99th percentile.
+    double max;     ///< Slowest frame.
+};
+
+/**
+\brief Summarise a list of times in seconds, nearest rank percentiles.
+
+*/
+
+static TimingSummary summarise(std::vector<double> times)
+{
+    TimingSummary summary = {0, 0, 0, 0, 0};
+    if (times.empty())
+        return summary;
+
+    std::sort(times.begin(), times.end());
+    std::size_t n = times.size();
+    double sum = 0;
+    for (std::size_t i = 0; i < n; i++)
+        sum += times[i];
+
+    summary.mean = sum / n * 1e3;
+    summary.p50 = times[(std::size_t) ceil(0.50 * n) - 1] * 1e3;
+    summary.p95 = times[(std::size_t) ceil(0.95 * n) - 1] * 1e3;
+    summary.p99 = times[(std::size_t) ceil(0.99 * n) - 1] * 1e3;
+    summary.max = times[n - 1] * 1e3;
+    return summary;
+}
+
+/**
+\brief Returns a string quoted for JSON.
+
+*/
+
+static std::string jsonString(const std::string& text)
+{
+    std::string out = "\"";
+    for (std::size_t i = 0; i < text.size(); i++)
+    {
+        if (text[i] == '"' || text[i] == '\\')
+            out += '\\';
+        if ((unsigned char) text[i] >= 0x20)
+            out += text[i];
+    }
+    return out + "\"";
+}
+
+/**
+\brief Write one timing's summary as a JSON member.
+
+*/
+
+static void writeSummary(FILE* file, const char* name, const TimingSummary& s, bool last)
+{
+    fprintf(file, "  \"%s\": {\"mean\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f}%s\n",
+            name, s.mean, s.p50, s.p95, s.p99, s.max, last ? "" : ",");
+}
+
+/**
+\brief Benchmark entry point.
+
+\return EXIT_SUCCESS, or EXIT_FAILURE if GL or the track could not be set up.
+
+*/
+
+int main(int argc, char** argv)
+{
+    int frameCount = 2000;
+    int warmup = 120;
+    int segmentFrames = 240;
+    int width = 700;
+    int height = 500;
+    double seconds = 120;
+    std::string trackPath = "";
+    std::string outPath = "frame_times.json";
+
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "--frames") == 0)
+            frameCount = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--warmup") == 0)
+            warmup = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--segment") == 0)
+            segmentFrames = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--width") == 0)
+            width = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--height") == 0)
+            height = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--seconds") == 0)
+            seconds = atof(argv[i + 1]);
+        else if (strcmp(argv[i], "--track") == 0)
+            trackPath = argv[i + 1];
+        else if (strcmp(argv[i], "--out") == 0)
+            outPath = argv[i + 1];
+    }
+    frameCount = (frameCount < 1) ? 1 : frameCount;
+    segmentFrames = (segmentFrames < 1) ? 1 : segmentFrames;
+
+    if (trackPath.empty())
+    {
+        trackPath = "./framebench.wav";
+        if (!writeTestTrack(trackPath, 44100, seconds))
+        {
+            fprintf(stderr, "cannot write %s\n", trackPath.c_str());
+            return EXIT_FAILURE;
+        }
+    }
+
+    // A throwaway context to start GLEW and read the version, as main does.
+    sf::RenderWindow setup(sf::VideoMode(width, height), "OpenGL Setup", sf::Style::Default,
+                           sf::ContextSettings(24, 8, 4, 10, 10, sf::ContextSettings::Core));
+    setup.setVisible(false);
+#ifndef __APPLE__
+    glewExperimental = true;
+    if (glewInit())
+    {
+        fprintf(stderr, "Unable to initialize GLEW\n");
+        return EXIT_FAILURE;
+    }
+#endif // __APPLE__
+    GLint major = 0;
+    GLint minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    if (major < 3 || (major == 3 && minor < 3))
+    {
+        fprintf(stderr, "OpenGL %d.%d found, 3.3 is needed\n", major, minor);
+        return EXIT_FAILURE;
+    }
+    std::string renderer = (const char*) glGetString(GL_RENDERER);
+    std::string version = (const char*) glGetString(GL_VERSION);
+    setup.close();
+
+    GraphicsEngine ge("Frame benchmark", major, minor, width, height, InputFile, std::vector<std::string>(1, trackPath), false);
+
+    // Let the analysis finish so only the render thread is busy while frames are timed.
+    sf::Event event;
+    for (int f = 0; ge.isOpen() && (f < warmup || !ge.isAnalysisComplete()); f++)
+    {
+        ge.display();
+        while (ge.pollEvent(event))
+            if (event.type == sf::Event::Closed)
+                ge.close();
+    }
+
+    std::vector<double> display, submit, swap;
+    display.reserve(frameCount);
+    submit.reserve(frameCount);
+    swap.reserve(frameCount);
+
+    ge.startAudio();
+    sf::Clock wall;
+    for (int f = 0; ge.isOpen() && f < frameCount; f++)
+    {
+        stepCamera(ge, f, segmentFrames);
+        ge.display();
+        FrameTiming timing = ge.getFrameTiming();
+        display.push_back(timing.display);
+        submit.push_back(timing.submit);
+        swap.push_back(timing.swap);
+
+        while (ge.pollEvent(event))
+            if (event.type == sf::Event::Closed)
+                ge.close();
+    }
+    double elapsed = wall.getElapsedTime().asSeconds();
+    ge.pauseAudio();
+
+    TimingSummary displaySummary = summarise(display);
+    TimingSummary submitSummary = summarise(submit);
+    TimingSummary swapSummary = summarise(swap);
+
+    FILE* file = fopen(outPath.c_str(), "w");
+    if (file == NULL)
+    {
+        fprintf(stderr, "cannot write %s\n", outPath.c_str());
+        return EXIT_FAILURE;
+    }
+    fprintf(file, "{\n");
+    fprintf(file, "  \"renderer\": %s,\n", jsonString(renderer).c_str());
+    fprintf(file, "  \"gl_version\": %s,\n", jsonString(version).c_str());
+    fprintf(file, "  \"track\": %s,\n", jsonString(trackPath).c_str());
+    fprintf(file, "  \"width\": %d,\n  \"height\": %d,\n", width, height);
+    fprintf(file, "  \"frames\": %d,\n", (int) display.size());
+    fprintf(file, "  \"fps\": %.2f,\n", (elapsed > 0) ? display.size() / elapsed : 0.0);
+    fprintf(file, "  \"unit\": \"ms\",\n");
+    writeSummary(file, "display", displaySummary, false);
+    writeSummary(file, "submit", submitSummary, false);
+    writeSummary(file, "swap", swapSummary, true);
+    fprintf(file, "}\n");
+    fclose(file);
+
+    printf("%s, OpenGL %s\n", renderer.c_str(), version.c_str());
+    printf("%d frames at %dx%d, %.1f fps\n", (int) display.size(), width, height,
+           (elapsed > 0) ? display.size() / elapsed : 0.0);
+    printf("           p50       p95       p99  (ms)\n");
+    printf("display %8.3f  %8.3f  %8.3f\n", displaySummary.p50, displaySummary.p95, displaySummary.p99);
+    printf("submit  %8.3f  %8.3f  %8.3f\n", submitSummary.p50, submitSummary.p95, submitSummary.p99);
+    printf("swap    %8.3f  %8.3f  %8.3f\n", swapSummary.p50, swapSummary.p95, swapSummary.p99);
+    printf("written to %s\n", outPath.c_str());
+
+    return EXIT_SUCCESS;
+}
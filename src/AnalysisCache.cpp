@@ -0,0 +1,363 @@
+#include "AnalysisCache.h"
+
+#include "FileUtil.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/**
+\file AnalysisCache.cpp
+\brief On-disk cache of finished analyses.
+
+*/
+
+//  xxHash64 primes.  The hash reads the samples once at memory speed, far quicker than the FFT.
+
+static const std::uint64_t Prime1 = 11400714785074694791ULL;
+static const std::uint64_t Prime2 = 14029467366897019727ULL;
+static const std::uint64_t Prime3 = 1609587929392839161ULL;
+static const std::uint64_t Prime4 = 9650029242287828579ULL;
+static const std::uint64_t Prime5 = 2870177450012600261ULL;
+
+static std::uint64_t rotl64(std::uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+static std::uint64_t read64(const unsigned char* p)
+{
+    std::uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static std::uint32_t read32(const unsigned char* p)
+{
+    std::uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static std::uint64_t hashRound(std::uint64_t acc, std::uint64_t input)
+{
+    acc += input * Prime2;
+    acc = rotl64(acc, 31);
+    return acc * Prime1;
+}
+
+static std::uint64_t hashMerge(std::uint64_t acc, std::uint64_t val)
+{
+    acc ^= hashRound(0, val);
+    return acc * Prime1 + Prime4;
+}
+
+/**
+\brief Constructor, the cache is off until a directory is set.
+
+*/
+
+AnalysisCache::AnalysisCache()
+{
+    writeKey = 0;
+}
+
+/**
+\brief Destructor, unmaps the result and removes one created and never committed.
+
+*/
+
+AnalysisCache::~AnalysisCache()
+{
+    close();
+}
+
+/**
+\brief Sets the folder for the cache files and creates it if needed.
+
+\param dir --- the folder, empty to turn the cache off.
+
+*/
+
+void AnalysisCache::setDirectory(const std::string& dir)
+{
+    directory = dir;
+    if (!directory.empty())
+        makeDirectory(directory); // fails harmlessly if it is already there
+}
+
+/**
+\brief Returns true if a cache directory is set.
+
+*/
+
+bool AnalysisCache::isEnabled() const
+{
+    return !directory.empty();
+}
+
+/**
+\brief Returns the file name for a key.
+
+*/
+
+std::string AnalysisCache::pathFor(std::uint64_t key) const
+{
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long) key);
+    return directory + "/" + name;
+}
+
+/**
+\brief Maps the cached result for a key.
+
+\param key --- hash of the samples and settings.
+\param frames --- number of frames the result must have.
+\param peakRows --- rows of band peaks the result must have.
+\param bands --- bands per frame the result must have.
+
+\return False if there is no valid file for the key.  Files of another version or size are ignored.
+
+*/
+
+bool AnalysisCache::open(std::uint64_t key, int frames, int peakRows, int bands)
+{
+    close();
+    if (!isEnabled() || !file.open(pathFor(key)))
+        return false;
+
+    std::size_t expected = sizeof(Header) + ((std::size_t) peakRows + 1) * bands * sizeof(double);
+    Header header;
+    if (file.size() != expected)
+    {
+        close();
+        return false;
+    }
+    memcpy(&header, file.data(), sizeof(header));
+
+    if (memcmp(header.magic, "FFTVPEAK", 8) != 0 || header.version != FormatVersion || header.key != key ||
+        header.bands != (std::uint32_t) bands || header.frames != (std::uint64_t) frames ||
+        header.peakRows != (std::uint64_t) peakRows)
+    {
+        close();
+        return false;
+    }
+    return true;
+}
+
+/**
+\brief Unmaps the result last opened or created.
+
+A file made by create and not committed is removed, it is either incomplete or a temporary file
+of a cache that is off.
+
+*/
+
+void AnalysisCache::close()
+{
+    file.close();
+    if (!writePath.empty())
+        remove(writePath.c_str());
+    writePath.clear();
+}
+
+/**
+\brief Returns the overall band peaks of the open result.
+
+*/
+
+const double* AnalysisCache::getOverallPeaks() const
+{
+    return file.isOpen() ? (const double*) (file.data() + sizeof(Header)) : NULL;
+}
+
+/**
+\brief Returns the per frame band peaks of the open result.
+
+*/
+
+const double* AnalysisCache::getPeaks() const
+{
+    if (!file.isOpen())
+        return NULL;
+    const double* overall = getOverallPeaks();
+    std::uint32_t bands;
+    memcpy(&bands, file.data() + offsetof(Header, bands), sizeof(bands));
+    return overall + bands;
+}
+
+/**
+\brief Writes a result, replacing any older file for the key.
+
+\param key --- hash of the samples and settings.
+\param frames --- number of frames.
+\param peakRows --- rows of band peaks in peaks.
+\param bands --- bands per frame.
+\param peaks --- peakRows * bands band peaks.
+\param overallPeaks --- bands overall band peaks.
+
+\return False if the file could not be written, the cache is then left as it was.
+
+*/
+
+bool AnalysisCache::save(std::uint64_t key, int frames, int peakRows, int bands, const double* peaks, const double* overallPeaks)
+{
+    if (!isEnabled())
+        return false;
+
+    Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "FFTVPEAK", 8);
+    header.version = FormatVersion;
+    header.bands = bands;
+    header.key = key;
+    header.frames = frames;
+    header.peakRows = peakRows;
+
+    const void* parts[3] = {&header, overallPeaks, peaks};
+    std::size_t sizes[3] = {sizeof(header), bands * sizeof(double), (std::size_t) peakRows * bands * sizeof(double)};
+    return writeFileAtomically(pathFor(key), parts, sizes, 3);
+}
+
+/**
+\brief Creates a result to be written in place, frame by frame.
+
+\param key --- hash of the samples and settings.
+\param frames --- number of frames.
+\param peakRows --- rows of band peaks.
+\param bands --- bands per frame.
+
+The file is mapped under a temporary name, in the cache folder or the system's temporary folder
+when the cache is off, and starts out as zeros.  The pages are written back by the system, so
+the result takes no memory beyond the pages being touched.  Finish with commit.
+
+\return peakRows * bands band peaks to fill, valid until close, or NULL if the file could not be made.
+
+*/
+
+double* AnalysisCache::create(std::uint64_t key, int frames, int peakRows, int bands)
+{
+    close();
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long) key);
+    std::string path = isEnabled() ? temporaryPath(pathFor(key)) : scratchPath(name);
+
+    std::size_t size = sizeof(Header) + ((std::size_t) peakRows + 1) * bands * sizeof(double);
+    if (!file.create(path, size))
+    {
+        remove(path.c_str());
+        return NULL;
+    }
+    writePath = path;
+    writeKey = key;
+
+    Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "FFTVPEAK", 8);
+    header.version = FormatVersion;
+    header.bands = bands;
+    header.key = key;
+    header.frames = frames;
+    header.peakRows = peakRows;
+    memcpy(file.writableData(), &header, sizeof(header));
+    return (double*) (file.writableData() + sizeof(Header)) + bands;
+}
+
+/**
+\brief Finishes a result made by create and renames it into the cache.
+
+\param overallPeaks --- bands overall band peaks.
+
+The mapping stays open, so the band peaks can still be read where they were written.  With the
+cache off the file stays where it is until close removes it.
+
+\return False if nothing was created or the file could not be put in place, close then removes it.
+
+*/
+
+bool AnalysisCache::commit(const double* overallPeaks)
+{
+    if (writePath.empty() || file.writableData() == NULL)
+        return false;
+
+    std::uint32_t bands;
+    memcpy(&bands, file.data() + offsetof(Header, bands), sizeof(bands));
+    memcpy(file.writableData() + sizeof(Header), overallPeaks, bands * sizeof(double));
+    if (!isEnabled())
+        return true;
+
+    // The pages are on disk before the rename makes the file visible under its key.
+    if (!file.flush() || !replaceFile(writePath, pathFor(writeKey)))
+        return false;
+    writePath.clear();
+    return true;
+}
+
+/**
+\brief xxHash64 of a block of memory.
+
+\param data --- the bytes to hash.
+\param bytes --- number of bytes.
+\param seed --- starting value, pass an earlier hash to chain blocks together.
+
+*/
+
+std::uint64_t AnalysisCache::hash(const void* data, std::size_t bytes, std::uint64_t seed)
+{
+    const unsigned char* p = (const unsigned char*) data;
+    const unsigned char* end = p + bytes;
+    std::uint64_t h;
+
+    if (bytes >= 32)
+    {
+        std::uint64_t v1 = seed + Prime1 + Prime2;
+        std::uint64_t v2 = seed + Prime2;
+        std::uint64_t v3 = seed;
+        std::uint64_t v4 = seed - Prime1;
+        const unsigned char* limit = end - 32;
+        do
+        {
+            v1 = hashRound(v1, read64(p));
+            v2 = hashRound(v2, read64(p + 8));
+            v3 = hashRound(v3, read64(p + 16));
+            v4 = hashRound(v4, read64(p + 24));
+            p += 32;
+        }
+        while (p <= limit);
+
+        h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+        h = hashMerge(h, v1);
+        h = hashMerge(h, v2);
+        h = hashMerge(h, v3);
+        h = hashMerge(h, v4);
+    }
+    else
+    {
+        h = seed + Prime5;
+    }
+
+    h += bytes;
+
+    for (; p + 8 <= end; p += 8)
+    {
+        h ^= hashRound(0, read64(p));
+        h = rotl64(h, 27) * Prime1 + Prime4;
+    }
+    if (p + 4 <= end)
+    {
+        h ^= (std::uint64_t) read32(p) * Prime1;
+        h = rotl64(h, 23) * Prime2 + Prime3;
+        p += 4;
+    }
+    for (; p < end; p++)
+    {
+        h ^= (*p) * Prime5;
+        h = rotl64(h, 11) * Prime1;
+    }
+
+    h ^= h >> 33;
+    h *= Prime2;
+    h ^= h >> 29;
+    h *= Prime3;
+    h ^= h >> 32;
+    return h;
+}
@@ -0,0 +1,79 @@
+#ifndef ANALYSISCACHE_H_INCLUDED
+#define ANALYSISCACHE_H_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "MappedFile.h"
+
+/**
+\file AnalysisCache.h
+\brief Header file for AnalysisCache.cpp
+
+*/
+
+/**
+\class AnalysisCache
+
+\brief Keeps finished analyses on disk, named by a hash of the samples and the settings.
+
+Each result is one file, a header followed by the overall band peaks and then the band peaks of
+every frame.  A file is written under a temporary name and renamed into place, so a crash never
+leaves a partial file behind.  Loading maps the file and the peaks are read where they lie.
+
+A result too long to hold in memory is written in place instead: create maps a new file to fill
+frame by frame and commit renames it into place once it is complete.  With the cache off the
+file goes to the system's temporary folder and is removed on close.
+
+*/
+
+class AnalysisCache
+{
+private:
+    /**
+    \brief Start of every cache file, padded so the peaks that follow are 8 byte aligned.
+    */
+    struct Header
+    {
+        char magic[8];          ///< "FFTVPEAK"
+        std::uint32_t version;  ///< Format version, files from another version are ignored.
+        std::uint32_t bands;    ///< Bands per frame.
+        std::uint64_t key;      ///< Hash of the samples and analysis settings.
+        std::uint64_t frames;   ///< Number of frames.
+        std::uint64_t peakRows; ///< Rows of band peaks stored, frames plus a spare row.
+        std::uint64_t reserved[3];
+    };
+
+    std::string directory;      ///< Folder holding the cache files, empty to turn the cache off.
+    MappedFile file;            ///< Mapping of the result last opened or created.
+    std::string writePath;      ///< Name of the file create made until it is committed, removed on close.
+    std::uint64_t writeKey;     ///< Key of the file create made.
+
+    std::string pathFor(std::uint64_t key) const;
+
+    AnalysisCache(const AnalysisCache&);
+    AnalysisCache& operator=(const AnalysisCache&);
+
+public:
+    static const std::uint32_t FormatVersion = 2;
+
+    AnalysisCache();
+    ~AnalysisCache();
+
+    void setDirectory(const std::string& dir);
+    bool isEnabled() const;
+
+    bool open(std::uint64_t key, int frames, int peakRows, int bands);
+    void close();
+    const double* getOverallPeaks() const;
+    const double* getPeaks() const;
+
+    bool save(std::uint64_t key, int frames, int peakRows, int bands, const double* peaks, const double* overallPeaks);
+    double* create(std::uint64_t key, int frames, int peakRows, int bands);
+    bool commit(const double* overallPeaks);
+
+    static std::uint64_t hash(const void* data, std::size_t bytes, std::uint64_t seed = 0);
+};
+
+#endif // ANALYSISCACHE_H_INCLUDED
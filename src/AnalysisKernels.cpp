@@ -0,0 +1,1215 @@
+#include "AnalysisKernels.h"
+
+#include <math.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ANALYSIS_KERNELS_X86
+#include <immintrin.h>
+#endif
+
+/**
+\file AnalysisKernels.cpp
+\brief Vectorised kernels for the spectral analysis.
+
+The SIMD versions do the same multiplies, adds and square roots as the scalar loops, just
+several at a time, so every version gives the same result.
+
+*/
+
+enum KernelLevel
+{
+    KernelScalar,
+    KernelSSE,
+    KernelAVX2
+};
+
+/**
+\brief Returns the widest instruction set this CPU supports.
+
+*/
+
+static KernelLevel detectKernelLevel()
+{
+#ifdef ANALYSIS_KERNELS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return KernelAVX2;
+    if (__builtin_cpu_supports("sse2"))
+        return KernelSSE;
+#endif
+    return KernelScalar;
+}
+
+/**
+\brief Returns the kernel level, detected once.
+
+*/
+
+static KernelLevel kernelLevel()
+{
+    static const KernelLevel level = detectKernelLevel();
+    return level;
+}
+
+//  Scalar versions, also used for the last few entries the SIMD loops leave over.
+
+static void magnitudesScalar(const fftw_complex* spectrum, double* mags, int start, int count)
+{
+    for (int i = start; i < count; i++)
+        mags[i] = sqrt(spectrum[i][0] * spectrum[i][0] + spectrum[i][1] * spectrum[i][1]);
+}
+
+static void magnitudesScalar(const fftwf_complex* spectrum, float* mags, int start, int count)
+{
+    for (int i = start; i < count; i++)
+        mags[i] = sqrtf(spectrum[i][0] * spectrum[i][0] + spectrum[i][1] * spectrum[i][1]);
+}
+
+template <typename In, typename Out>
+static void windowScalar(const In* in, const Out* window, Out* out, int start, int count)
+{
+    for (int i = start; i < count; i++)
+        out[i] = (Out) in[i] * window[i];
+}
+
+//  24 bit and float samples are brought to the 16 bit scale, 1/256 and 32768, so the bars and
+//  thresholds do not depend on the file format.  Both scales are powers of two, so they are exact.
+
+template <typename Out>
+static void windowInt24Scalar(const unsigned char* in, const Out* window, Out* out, int start, int count)
+{
+    for (int i = start; i < count; i++)
+    {
+        const unsigned char* p = in + 3 * i;
+        std::int32_t v = (std::int32_t) ((std::uint32_t) p[0] << 8 | (std::uint32_t) p[1] << 16 | (std::uint32_t) p[2] << 24) >> 8;
+        out[i] = (Out) v * (Out) (1.0 / 256) * window[i];
+    }
+}
+
+template <typename Out>
+static void windowFloat32Scalar(const float* in, const Out* window, Out* out, int start, int count)
+{
+    for (int i = start; i < count; i++)
+        out[i] = (Out) in[i] * (Out) 32768 * window[i];
+}
+
+//  Channel front end.  Every format is brought to float on the 16 bit scale, which is exact for
+//  all three, so the split channels carry the same values the mono path would window.
+
+static float loadSample(const unsigned char* in, SampleFormat format, std::size_t index)
+{
+    if (format == SampleInt16)
+    {
+        std::int16_t v;
+        memcpy(&v, in + 2 * index, sizeof(v));
+        return v;
+    }
+    if (format == SampleFloat32)
+    {
+        float v;
+        memcpy(&v, in + 4 * index, sizeof(v));
+        return v * 32768.0f;
+    }
+    const unsigned char* p = in + 3 * index;
+    std::int32_t v = (std::int32_t) ((std::uint32_t) p[0] << 8 | (std::uint32_t) p[1] << 16 | (std::uint32_t) p[2] << 24) >> 8;
+    return (float) v * (1.0f / 256);
+}
+
+//  Stereo frames from start to count.  With right NULL the mean of the two goes to left.
+
+static void splitStereoScalar(const unsigned char* in, SampleFormat format, float* left, float* right, int start, int count)
+{
+    for (int i = start; i < count; i++)
+    {
+        float l = loadSample(in, format, 2 * (std::size_t) i);
+        float r = loadSample(in, format, 2 * (std::size_t) i + 1);
+        if (right != NULL)
+        {
+            left[i] = l;
+            right[i] = r;
+        }
+        else
+            left[i] = (l + r) * 0.5f;
+    }
+}
+
+static void midSideScalar(const float* left, const float* right, float* mid, float* side, int start, int count)
+{
+    for (int i = start; i < count; i++)
+    {
+        float l = left[i];
+        float r = right[i];
+        mid[i] = (l + r) * 0.5f;
+        side[i] = (l - r) * 0.5f;
+    }
+}
+
+static void normaliseScalar(const double* mags, const double* peaks, float* out, int start, int count)
+{
+    for (int i = start; i < count; i++)
+        out[i] = (peaks[i] > 0) ? (float) (mags[i] / peaks[i]) : 0.0f;
+}
+
+// Polynomial log2, within 1e-4 of the real thing, which is far finer than a bar can show.  The
+// vector versions do the same bit moves and the same multiplies and adds.
+static float fastLog2(float x)
+{
+    std::uint32_t bits;
+    memcpy(&bits, &x, sizeof(bits));
+    float exponent = (float) ((int) (bits >> 23) - 127);
+    bits = (bits & 0x007fffff) | 0x3f800000;
+    float m;
+    memcpy(&m, &bits, sizeof(m));
+    return exponent + (-2.5056147f + (4.0496169f + (-2.0994023f + (0.63551112f - 0.080010877f * m) * m) * m) * m);
+}
+
+static void decibelsScalar(float* values, float scale, int start, int count)
+{
+    for (int i = start; i < count; i++)
+    {
+        float v = (values[i] > 1e-12f) ? values[i] : 1e-12f;
+        float h = 1.0f - fastLog2(v) * scale;
+        h = (h > 0.0f) ? h : 0.0f;
+        values[i] = (h < 1.0f) ? h : 1.0f;
+    }
+}
+
+static void envelopeScalar(const float* target, float* level, float* peak, float* hold, const EnvelopeStep& step,
+                           int start, int count)
+{
+    for (int i = start; i < count; i++)
+    {
+        float diff = target[i] - level[i];
+        float l = level[i] + diff * ((diff > 0.0f) ? step.attackGain : step.releaseGain);
+        float h = hold[i] - step.elapsed;
+        float fallen = (h > 0.0f) ? peak[i] : peak[i] - step.peakDrop;
+        bool rising = l >= fallen;
+
+        level[i] = l;
+        peak[i] = rising ? l : fallen;
+        hold[i] = rising ? step.holdTime : h;
+    }
+}
+
+#ifdef ANALYSIS_KERNELS_X86
+
+__attribute__((target("sse2")))
+static void magnitudesSSE(const fftw_complex* spectrum, double* mags, int count)
+{
+    const double* in = &spectrum[0][0];
+    int i = 0;
+    for (; i + 2 <= count; i += 2)
+    {
+        __m128d a = _mm_loadu_pd(in + 2 * i);
+        __m128d b = _mm_loadu_pd(in + 2 * i + 2);
+        __m128d re = _mm_unpacklo_pd(a, b);
+        __m128d im = _mm_unpackhi_pd(a, b);
+        __m128d sum = _mm_add_pd(_mm_mul_pd(re, re), _mm_mul_pd(im, im));
+        _mm_storeu_pd(mags + i, _mm_sqrt_pd(sum));
+    }
+    magnitudesScalar(spectrum, mags, i, count);
+}
+
+__attribute__((target("sse2")))
+static void magnitudesSSE(const fftwf_complex* spectrum, float* mags, int count)
+{
+    const float* in = &spectrum[0][0];
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 a = _mm_loadu_ps(in + 2 * i);
+        __m128 b = _mm_loadu_ps(in + 2 * i + 4);
+        __m128 re = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 im = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+        __m128 sum = _mm_add_ps(_mm_mul_ps(re, re), _mm_mul_ps(im, im));
+        _mm_storeu_ps(mags + i, _mm_sqrt_ps(sum));
+    }
+    magnitudesScalar(spectrum, mags, i, count);
+}
+
+__attribute__((target("avx2")))
+static void magnitudesAVX2(const fftw_complex* spectrum, double* mags, int count)
+{
+    const double* in = &spectrum[0][0];
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m256d a = _mm256_loadu_pd(in + 2 * i);
+        __m256d b = _mm256_loadu_pd(in + 2 * i + 4);
+        // Unpacking works per 128 bit lane, leaving the entries in the order 0, 2, 1, 3.
+        __m256d re = _mm256_permute4x64_pd(_mm256_unpacklo_pd(a, b), _MM_SHUFFLE(3, 1, 2, 0));
+        __m256d im = _mm256_permute4x64_pd(_mm256_unpackhi_pd(a, b), _MM_SHUFFLE(3, 1, 2, 0));
+        __m256d sum = _mm256_add_pd(_mm256_mul_pd(re, re), _mm256_mul_pd(im, im));
+        _mm256_storeu_pd(mags + i, _mm256_sqrt_pd(sum));
+    }
+    magnitudesScalar(spectrum, mags, i, count);
+}
+
+__attribute__((target("avx2")))
+static void magnitudesAVX2(const fftwf_complex* spectrum, float* mags, int count)
+{
+    const float* in = &spectrum[0][0];
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 a = _mm256_loadu_ps(in + 2 * i);
+        __m256 b = _mm256_loadu_ps(in + 2 * i + 8);
+        __m256 sqa = _mm256_mul_ps(a, a);
+        __m256 sqb = _mm256_mul_ps(b, b);
+        // Pairwise adds give re*re + im*im per lane in the order 0, 1, 4, 5 | 2, 3, 6, 7.
+        __m256 sum = _mm256_hadd_ps(sqa, sqb);
+        sum = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(sum), _MM_SHUFFLE(3, 1, 2, 0)));
+        _mm256_storeu_ps(mags + i, _mm256_sqrt_ps(sum));
+    }
+    magnitudesScalar(spectrum, mags, i, count);
+}
+
+//  Window kernels.  Converting a 16 bit sample to float or double is exact, so each output is
+//  one rounded multiply in every version.
+
+__attribute__((target("sse2")))
+static void windowSSE(const double* in, const double* window, double* out, int count)
+{
+    int i = 0;
+    for (; i + 2 <= count; i += 2)
+        _mm_storeu_pd(out + i, _mm_mul_pd(_mm_loadu_pd(in + i), _mm_loadu_pd(window + i)));
+    windowScalar(in, window, out, i, count);
+}
+
+__attribute__((target("sse2")))
+static void windowSSE(const float* in, const float* window, float* out, int count)
+{
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_loadu_ps(in + i), _mm_loadu_ps(window + i)));
+    windowScalar(in, window, out, i, count);
+}
+
+__attribute__((target("sse2")))
+static void windowSSE(const std::int16_t* in, const double* window, double* out, int count)
+{
+    int i = 0;
+    for (; i + 2 <= count; i += 2)
+    {
+        int pair;
+        memcpy(&pair, in + i, sizeof(pair));
+        __m128i s = _mm_cvtsi32_si128(pair);
+        s = _mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16); // sign extend to 32 bits
+        _mm_storeu_pd(out + i, _mm_mul_pd(_mm_cvtepi32_pd(s), _mm_loadu_pd(window + i)));
+    }
+    windowScalar(in, window, out, i, count);
+}
+
+__attribute__((target("sse2")))
+static void windowSSE(const std::int16_t* in, const float* window, float* out, int count)
+{
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i s = _mm_loadl_epi64((const __m128i*) (in + i));
+        s = _mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16);
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(s), _mm_loadu_ps(window + i)));
+    }
+    windowScalar(in, window, out, i, count);
+}
+
+__attribute__((target("avx2")))
+static void windowAVX2(const double* in, const double* window, double* out, int count)
+{
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+        _mm256_storeu_pd(out + i, _mm256_mul_pd(_mm256_loadu_pd(in + i), _mm256_loadu_pd(window + i)));
+    windowScalar(in, window, out, i, count);
+}
+
+__attribute__((target("avx2")))
+static void windowAVX2(const float* in, const float* window, float* out, int count)
+{
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+        _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_loadu_ps(in + i), _mm256_loadu_ps(window + i)));
+    windowScalar(in, window, out, i, count);
+}
+
+__attribute__((target("avx2")))
+static void windowAVX2(const std::int16_t* in, const double* window, double* out, int count)
+{
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i s = _mm_cvtepi16_epi32(_mm_loadl_epi64((const __m128i*) (in + i)));
+        _mm256_storeu_pd(out + i, _mm256_mul_pd(_mm256_cvtepi32_pd(s), _mm256_loadu_pd(window + i)));
+    }
+    windowScalar(in, window, out, i, count);
+}
+
+__attribute__((target("avx2")))
+static void windowAVX2(const std::int16_t* in, const float* window, float* out, int count)
+{
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256i s = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*) (in + i)));
+        _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_cvtepi32_ps(s), _mm256_loadu_ps(window + i)));
+    }
+    windowScalar(in, window, out, i, count);
+}
+
+__attribute__((target("sse2")))
+static void windowFloat32SSE(const float* in, const double* window, double* out, int count)
+{
+    const __m128d scale = _mm_set1_pd(32768);
+    int i = 0;
+    for (; i + 2 <= count; i += 2)
+    {
+        __m128d s = _mm_cvtps_pd(_mm_castsi128_ps(_mm_loadl_epi64((const __m128i*) (in + i))));
+        _mm_storeu_pd(out + i, _mm_mul_pd(_mm_mul_pd(s, scale), _mm_loadu_pd(window + i)));
+    }
+    windowFloat32Scalar(in, window, out, i, count);
+}
+
+__attribute__((target("sse2")))
+static void windowFloat32SSE(const float* in, const float* window, float* out, int count)
+{
+    const __m128 scale = _mm_set1_ps(32768);
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_mul_ps(_mm_loadu_ps(in + i), scale), _mm_loadu_ps(window + i)));
+    windowFloat32Scalar(in, window, out, i, count);
+}
+
+__attribute__((target("avx2")))
+static void windowFloat32AVX2(const float* in, const double* window, double* out, int count)
+{
+    const __m256d scale = _mm256_set1_pd(32768);
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m256d s = _mm256_cvtps_pd(_mm_loadu_ps(in + i));
+        _mm256_storeu_pd(out + i, _mm256_mul_pd(_mm256_mul_pd(s, scale), _mm256_loadu_pd(window + i)));
+    }
+    windowFloat32Scalar(in, window, out, i, count);
+}
+
+__attribute__((target("avx2")))
+static void windowFloat32AVX2(const float* in, const float* window, float* out, int count)
+{
+    const __m256 scale = _mm256_set1_ps(32768);
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+        _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_mul_ps(_mm256_loadu_ps(in + i), scale), _mm256_loadu_ps(window + i)));
+    windowFloat32Scalar(in, window, out, i, count);
+}
+
+//  Four packed 24 bit samples are 12 bytes.  The shuffle puts each one in the top three bytes of
+//  a 32 bit lane and the arithmetic shift sign extends it.  The 16 byte load reads 4 bytes past
+//  the samples it uses, so the loop stops while that is still inside the frame.
+
+__attribute__((target("avx2")))
+static __m128i loadInt24x4(const unsigned char* in)
+{
+    const __m128i spread = _mm_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+    return _mm_srai_epi32(_mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) in), spread), 8);
+}
+
+__attribute__((target("avx2")))
+static void windowInt24AVX2(const unsigned char* in, const double* window, double* out, int count)
+{
+    const __m256d scale = _mm256_set1_pd(1.0 / 256);
+    int i = 0;
+    for (; 3 * i + 16 <= 3 * count; i += 4)
+    {
+        __m256d s = _mm256_cvtepi32_pd(loadInt24x4(in + 3 * i));
+        _mm256_storeu_pd(out + i, _mm256_mul_pd(_mm256_mul_pd(s, scale), _mm256_loadu_pd(window + i)));
+    }
+    windowInt24Scalar(in, window, out, i, count);
+}
+
+__attribute__((target("avx2")))
+static void windowInt24AVX2(const unsigned char* in, const float* window, float* out, int count)
+{
+    const __m128 scale = _mm_set1_ps(1.0f / 256);
+    int i = 0;
+    for (; 3 * i + 16 <= 3 * count; i += 4)
+    {
+        __m128 s = _mm_cvtepi32_ps(loadInt24x4(in + 3 * i));
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_mul_ps(s, scale), _mm_loadu_ps(window + i)));
+    }
+    windowInt24Scalar(in, window, out, i, count);
+}
+
+__attribute__((target("sse2")))
+static void windowSSE(const float* in, const double* window, double* out, int count)
+{
+    int i = 0;
+    for (; i + 2 <= count; i += 2)
+    {
+        __m128d s = _mm_cvtps_pd(_mm_castsi128_ps(_mm_loadl_epi64((const __m128i*) (in + i))));
+        _mm_storeu_pd(out + i, _mm_mul_pd(s, _mm_loadu_pd(window + i)));
+    }
+    windowScalar(in, window, out, i, count);
+}
+
+__attribute__((target("avx2")))
+static void windowAVX2(const float* in, const double* window, double* out, int count)
+{
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+        _mm256_storeu_pd(out + i, _mm256_mul_pd(_mm256_cvtps_pd(_mm_loadu_ps(in + i)), _mm256_loadu_pd(window + i)));
+    windowScalar(in, window, out, i, count);
+}
+
+//  Stereo deinterleave.  A 32 bit lane holds one 16 bit frame, shifting it left then right
+//  sign extends the left sample and shifting right alone gives the right one.  Float frames are
+//  split with shuffles, the AVX2 version then puts the 64 bit pairs back in order across lanes.
+
+__attribute__((target("sse2")))
+static void splitStereoInt16SSE(const std::int16_t* in, float* left, float* right, int count)
+{
+    const __m128 half = _mm_set1_ps(0.5f);
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*) (in + 2 * i));
+        __m128 l = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_slli_epi32(v, 16), 16));
+        __m128 r = _mm_cvtepi32_ps(_mm_srai_epi32(v, 16));
+        if (right != NULL)
+        {
+            _mm_storeu_ps(left + i, l);
+            _mm_storeu_ps(right + i, r);
+        }
+        else
+            _mm_storeu_ps(left + i, _mm_mul_ps(_mm_add_ps(l, r), half));
+    }
+    splitStereoScalar((const unsigned char*) in, SampleInt16, left, right, i, count);
+}
+
+__attribute__((target("avx2")))
+static void splitStereoInt16AVX2(const std::int16_t* in, float* left, float* right, int count)
+{
+    const __m256 half = _mm256_set1_ps(0.5f);
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i*) (in + 2 * i));
+        __m256 l = _mm256_cvtepi32_ps(_mm256_srai_epi32(_mm256_slli_epi32(v, 16), 16));
+        __m256 r = _mm256_cvtepi32_ps(_mm256_srai_epi32(v, 16));
+        if (right != NULL)
+        {
+            _mm256_storeu_ps(left + i, l);
+            _mm256_storeu_ps(right + i, r);
+        }
+        else
+            _mm256_storeu_ps(left + i, _mm256_mul_ps(_mm256_add_ps(l, r), half));
+    }
+    splitStereoScalar((const unsigned char*) in, SampleInt16, left, right, i, count);
+}
+
+__attribute__((target("sse2")))
+static void splitStereoFloat32SSE(const float* in, float* left, float* right, int count)
+{
+    const __m128 scale = _mm_set1_ps(32768);
+    const __m128 half = _mm_set1_ps(0.5f);
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 a = _mm_loadu_ps(in + 2 * i);
+        __m128 b = _mm_loadu_ps(in + 2 * i + 4);
+        __m128 l = _mm_mul_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)), scale);
+        __m128 r = _mm_mul_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)), scale);
+        if (right != NULL)
+        {
+            _mm_storeu_ps(left + i, l);
+            _mm_storeu_ps(right + i, r);
+        }
+        else
+            _mm_storeu_ps(left + i, _mm_mul_ps(_mm_add_ps(l, r), half));
+    }
+    splitStereoScalar((const unsigned char*) in, SampleFloat32, left, right, i, count);
+}
+
+__attribute__((target("avx2")))
+static void splitStereoFloat32AVX2(const float* in, float* left, float* right, int count)
+{
+    const __m256 scale = _mm256_set1_ps(32768);
+    const __m256 half = _mm256_set1_ps(0.5f);
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 a = _mm256_loadu_ps(in + 2 * i);
+        __m256 b = _mm256_loadu_ps(in + 2 * i + 8);
+        __m256 l = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+        __m256 r = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+        l = _mm256_mul_ps(_mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(l), _MM_SHUFFLE(3, 1, 2, 0))), scale);
+        r = _mm256_mul_ps(_mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(r), _MM_SHUFFLE(3, 1, 2, 0))), scale);
+        if (right != NULL)
+        {
+            _mm256_storeu_ps(left + i, l);
+            _mm256_storeu_ps(right + i, r);
+        }
+        else
+            _mm256_storeu_ps(left + i, _mm256_mul_ps(_mm256_add_ps(l, r), half));
+    }
+    splitStereoScalar((const unsigned char*) in, SampleFloat32, left, right, i, count);
+}
+
+__attribute__((target("sse2")))
+static void midSideSSE(const float* left, const float* right, float* mid, float* side, int count)
+{
+    const __m128 half = _mm_set1_ps(0.5f);
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 l = _mm_loadu_ps(left + i);
+        __m128 r = _mm_loadu_ps(right + i);
+        _mm_storeu_ps(mid + i, _mm_mul_ps(_mm_add_ps(l, r), half));
+        _mm_storeu_ps(side + i, _mm_mul_ps(_mm_sub_ps(l, r), half));
+    }
+    midSideScalar(left, right, mid, side, i, count);
+}
+
+__attribute__((target("avx2")))
+static void midSideAVX2(const float* left, const float* right, float* mid, float* side, int count)
+{
+    const __m256 half = _mm256_set1_ps(0.5f);
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 l = _mm256_loadu_ps(left + i);
+        __m256 r = _mm256_loadu_ps(right + i);
+        _mm256_storeu_ps(mid + i, _mm256_mul_ps(_mm256_add_ps(l, r), half));
+        _mm256_storeu_ps(side + i, _mm256_mul_ps(_mm256_sub_ps(l, r), half));
+    }
+    midSideScalar(left, right, mid, side, i, count);
+}
+
+__attribute__((target("sse2")))
+static void normaliseSSE(const double* mags, const double* peaks, float* out, int count)
+{
+    const __m128d zero = _mm_setzero_pd();
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128d p0 = _mm_loadu_pd(peaks + i);
+        __m128d p1 = _mm_loadu_pd(peaks + i + 2);
+        __m128d r0 = _mm_and_pd(_mm_div_pd(_mm_loadu_pd(mags + i), p0), _mm_cmpgt_pd(p0, zero));
+        __m128d r1 = _mm_and_pd(_mm_div_pd(_mm_loadu_pd(mags + i + 2), p1), _mm_cmpgt_pd(p1, zero));
+        _mm_storeu_ps(out + i, _mm_movelh_ps(_mm_cvtpd_ps(r0), _mm_cvtpd_ps(r1)));
+    }
+    normaliseScalar(mags, peaks, out, i, count);
+}
+
+__attribute__((target("avx2")))
+static void normaliseAVX2(const double* mags, const double* peaks, float* out, int count)
+{
+    const __m256d zero = _mm256_setzero_pd();
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256d p0 = _mm256_loadu_pd(peaks + i);
+        __m256d p1 = _mm256_loadu_pd(peaks + i + 4);
+        __m256d r0 = _mm256_and_pd(_mm256_div_pd(_mm256_loadu_pd(mags + i), p0), _mm256_cmp_pd(p0, zero, _CMP_GT_OQ));
+        __m256d r1 = _mm256_and_pd(_mm256_div_pd(_mm256_loadu_pd(mags + i + 4), p1), _mm256_cmp_pd(p1, zero, _CMP_GT_OQ));
+        _mm256_storeu_ps(out + i, _mm256_set_m128(_mm256_cvtpd_ps(r1), _mm256_cvtpd_ps(r0)));
+    }
+    normaliseScalar(mags, peaks, out, i, count);
+}
+
+__attribute__((target("sse2")))
+static __m128 fastLog2SSE(__m128 x)
+{
+    __m128i bits = _mm_castps_si128(x);
+    __m128 exponent = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127)));
+    __m128 m = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007fffff)), _mm_set1_epi32(0x3f800000)));
+    __m128 p = _mm_sub_ps(_mm_set1_ps(0.63551112f), _mm_mul_ps(_mm_set1_ps(0.080010877f), m));
+    p = _mm_add_ps(_mm_set1_ps(-2.0994023f), _mm_mul_ps(p, m));
+    p = _mm_add_ps(_mm_set1_ps(4.0496169f), _mm_mul_ps(p, m));
+    p = _mm_add_ps(_mm_set1_ps(-2.5056147f), _mm_mul_ps(p, m));
+    return _mm_add_ps(exponent, p);
+}
+
+__attribute__((target("avx2")))
+static __m256 fastLog2AVX2(__m256 x)
+{
+    __m256i bits = _mm256_castps_si256(x);
+    __m256 exponent = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(127)));
+    __m256 m = _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x007fffff)), _mm256_set1_epi32(0x3f800000)));
+    __m256 p = _mm256_sub_ps(_mm256_set1_ps(0.63551112f), _mm256_mul_ps(_mm256_set1_ps(0.080010877f), m));
+    p = _mm256_add_ps(_mm256_set1_ps(-2.0994023f), _mm256_mul_ps(p, m));
+    p = _mm256_add_ps(_mm256_set1_ps(4.0496169f), _mm256_mul_ps(p, m));
+    p = _mm256_add_ps(_mm256_set1_ps(-2.5056147f), _mm256_mul_ps(p, m));
+    return _mm256_add_ps(exponent, p);
+}
+
+__attribute__((target("sse2")))
+static void decibelsSSE(float* values, float scale, int count)
+{
+    const __m128 tiny = _mm_set1_ps(1e-12f);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 s = _mm_set1_ps(scale);
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 v = _mm_max_ps(_mm_loadu_ps(values + i), tiny);
+        __m128 h = _mm_sub_ps(one, _mm_mul_ps(fastLog2SSE(v), s));
+        _mm_storeu_ps(values + i, _mm_min_ps(_mm_max_ps(h, _mm_setzero_ps()), one));
+    }
+    decibelsScalar(values, scale, i, count);
+}
+
+__attribute__((target("avx2")))
+static void decibelsAVX2(float* values, float scale, int count)
+{
+    const __m256 tiny = _mm256_set1_ps(1e-12f);
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 s = _mm256_set1_ps(scale);
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 v = _mm256_max_ps(_mm256_loadu_ps(values + i), tiny);
+        __m256 h = _mm256_sub_ps(one, _mm256_mul_ps(fastLog2AVX2(v), s));
+        _mm256_storeu_ps(values + i, _mm256_min_ps(_mm256_max_ps(h, _mm256_setzero_ps()), one));
+    }
+    decibelsScalar(values, scale, i, count);
+}
+
+// SSE2 has no blend, the selects are and / andnot / or.
+__attribute__((target("sse2")))
+static __m128 selectSSE(__m128 mask, __m128 a, __m128 b)
+{
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+__attribute__((target("sse2")))
+static void envelopeSSE(const float* target, float* level, float* peak, float* hold, const EnvelopeStep& step, int count)
+{
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 attack = _mm_set1_ps(step.attackGain);
+    const __m128 release = _mm_set1_ps(step.releaseGain);
+    const __m128 elapsed = _mm_set1_ps(step.elapsed);
+    const __m128 holdTime = _mm_set1_ps(step.holdTime);
+    const __m128 drop = _mm_set1_ps(step.peakDrop);
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 l = _mm_loadu_ps(level + i);
+        __m128 p = _mm_loadu_ps(peak + i);
+        __m128 diff = _mm_sub_ps(_mm_loadu_ps(target + i), l);
+        l = _mm_add_ps(l, _mm_mul_ps(diff, selectSSE(_mm_cmpgt_ps(diff, zero), attack, release)));
+        __m128 h = _mm_sub_ps(_mm_loadu_ps(hold + i), elapsed);
+        __m128 fallen = selectSSE(_mm_cmpgt_ps(h, zero), p, _mm_sub_ps(p, drop));
+        __m128 rising = _mm_cmpge_ps(l, fallen);
+
+        _mm_storeu_ps(level + i, l);
+        _mm_storeu_ps(peak + i, selectSSE(rising, l, fallen));
+        _mm_storeu_ps(hold + i, selectSSE(rising, holdTime, h));
+    }
+    envelopeScalar(target, level, peak, hold, step, i, count);
+}
+
+__attribute__((target("avx2")))
+static void envelopeAVX2(const float* target, float* level, float* peak, float* hold, const EnvelopeStep& step, int count)
+{
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 attack = _mm256_set1_ps(step.attackGain);
+    const __m256 release = _mm256_set1_ps(step.releaseGain);
+    const __m256 elapsed = _mm256_set1_ps(step.elapsed);
+    const __m256 holdTime = _mm256_set1_ps(step.holdTime);
+    const __m256 drop = _mm256_set1_ps(step.peakDrop);
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 l = _mm256_loadu_ps(level + i);
+        __m256 p = _mm256_loadu_ps(peak + i);
+        __m256 diff = _mm256_sub_ps(_mm256_loadu_ps(target + i), l);
+        l = _mm256_add_ps(l, _mm256_mul_ps(diff, _mm256_blendv_ps(release, attack, _mm256_cmp_ps(diff, zero, _CMP_GT_OQ))));
+        __m256 h = _mm256_sub_ps(_mm256_loadu_ps(hold + i), elapsed);
+        __m256 fallen = _mm256_blendv_ps(_mm256_sub_ps(p, drop), p, _mm256_cmp_ps(h, zero, _CMP_GT_OQ));
+        __m256 rising = _mm256_cmp_ps(l, fallen, _CMP_GE_OQ);
+
+        _mm256_storeu_ps(level + i, l);
+        _mm256_storeu_ps(peak + i, _mm256_blendv_ps(fallen, l, rising));
+        _mm256_storeu_ps(hold + i, _mm256_blendv_ps(h, holdTime, rising));
+    }
+    envelopeScalar(target, level, peak, hold, step, i, count);
+}
+
+#endif // ANALYSIS_KERNELS_X86
+
+/**
+\brief Computes sqrt(re*re + im*im) for each entry of a spectrum.
+
+\param spectrum --- the complex FFT output.
+\param mags --- output, count entries.
+\param count --- number of entries.
+
+*/
+
+void computeMagnitudes(const fftw_complex* spectrum, double* mags, int count)
+{
+#ifdef ANALYSIS_KERNELS_X86
+    switch (kernelLevel())
+    {
+    case KernelAVX2:
+        magnitudesAVX2(spectrum, mags, count);
+        return;
+    case KernelSSE:
+        magnitudesSSE(spectrum, mags, count);
+        return;
+    default:
+        break;
+    }
+#endif
+    magnitudesScalar(spectrum, mags, 0, count);
+}
+
+/**
+\brief Single precision version of computeMagnitudes.
+
+\param spectrum --- the complex FFT output.
+\param mags --- output, count entries.
+\param count --- number of entries.
+
+*/
+
+void computeMagnitudes(const fftwf_complex* spectrum, float* mags, int count)
+{
+#ifdef ANALYSIS_KERNELS_X86
+    switch (kernelLevel())
+    {
+    case KernelAVX2:
+        magnitudesAVX2(spectrum, mags, count);
+        return;
+    case KernelSSE:
+        magnitudesSSE(spectrum, mags, count);
+        return;
+    default:
+        break;
+    }
+#endif
+    magnitudesScalar(spectrum, mags, 0, count);
+}
+
+/**
+\brief Multiplies a frame of samples by the window and writes the FFT input.
+
+\param in --- count samples.
+\param window --- count window coefficients.
+\param out --- output, count entries, usually the FFT input buffer.
+\param count --- number of samples.
+
+Converting the samples and applying the window in one pass means each sample is read once and
+the FFT input is written once, however much the frames overlap.
+
+*/
+
+template <typename In, typename Out>
+static void windowDispatch(const In* in, const Out* window, Out* out, int count)
+{
+#ifdef ANALYSIS_KERNELS_X86
+    switch (kernelLevel())
+    {
+    case KernelAVX2:
+        windowAVX2(in, window, out, count);
+        return;
+    case KernelSSE:
+        windowSSE(in, window, out, count);
+        return;
+    default:
+        break;
+    }
+#endif
+    windowScalar(in, window, out, 0, count);
+}
+
+void windowFrame(const double* in, const double* window, double* out, int count)
+{
+    windowDispatch(in, window, out, count);
+}
+
+void windowFrame(const float* in, const float* window, float* out, int count)
+{
+    windowDispatch(in, window, out, count);
+}
+
+void windowFrame(const float* in, const double* window, double* out, int count)
+{
+    windowDispatch(in, window, out, count);
+}
+
+void windowFrame(const std::int16_t* in, const double* window, double* out, int count)
+{
+    windowDispatch(in, window, out, count);
+}
+
+void windowFrame(const std::int16_t* in, const float* window, float* out, int count)
+{
+    windowDispatch(in, window, out, count);
+}
+
+/**
+\brief Windows a frame of samples in any SampleFormat into the FFT input.
+
+\param in --- the first sample of the whole span.
+\param format --- how the samples are stored.
+\param start --- index of the frame's first sample.
+\param window --- count window coefficients.
+\param out --- output, count entries.
+\param count --- number of samples.
+
+24 bit and float samples come out on the 16 bit scale.  24 bit samples need byte shuffles, so
+only the AVX2 level has a vector version of them.
+
+*/
+
+template <typename Out>
+static void windowDispatchSamples(const void* in, SampleFormat format, std::uint64_t start, const Out* window, Out* out, int count)
+{
+    if (format == SampleInt16)
+    {
+        windowDispatch((const std::int16_t*) in + start, window, out, count);
+        return;
+    }
+
+    const unsigned char* bytes = (const unsigned char*) in + start * sampleBytes(format);
+#ifdef ANALYSIS_KERNELS_X86
+    KernelLevel level = kernelLevel();
+    if (format == SampleFloat32 && level == KernelAVX2)
+    {
+        windowFloat32AVX2((const float*) bytes, window, out, count);
+        return;
+    }
+    if (format == SampleFloat32 && level == KernelSSE)
+    {
+        windowFloat32SSE((const float*) bytes, window, out, count);
+        return;
+    }
+    if (format == SampleInt24 && level == KernelAVX2)
+    {
+        windowInt24AVX2(bytes, window, out, count);
+        return;
+    }
+#endif
+    if (format == SampleFloat32)
+        windowFloat32Scalar((const float*) bytes, window, out, 0, count);
+    else
+        windowInt24Scalar(bytes, window, out, 0, count);
+}
+
+void windowSamples(const void* in, SampleFormat format, std::uint64_t start, const double* window, double* out, int count)
+{
+    windowDispatchSamples(in, format, start, window, out, count);
+}
+
+void windowSamples(const void* in, SampleFormat format, std::uint64_t start, const float* window, float* out, int count)
+{
+    windowDispatchSamples(in, format, start, window, out, count);
+}
+
+/**
+\brief Splits stereo frames into two channels, or their mean when right is NULL.
+
+*/
+
+static void splitStereo(const unsigned char* in, SampleFormat format, float* left, float* right, int count)
+{
+#ifdef ANALYSIS_KERNELS_X86
+    KernelLevel level = kernelLevel();
+    if (format == SampleInt16 && level == KernelAVX2)
+    {
+        splitStereoInt16AVX2((const std::int16_t*) in, left, right, count);
+        return;
+    }
+    if (format == SampleInt16 && level == KernelSSE)
+    {
+        splitStereoInt16SSE((const std::int16_t*) in, left, right, count);
+        return;
+    }
+    if (format == SampleFloat32 && level == KernelAVX2)
+    {
+        splitStereoFloat32AVX2((const float*) in, left, right, count);
+        return;
+    }
+    if (format == SampleFloat32 && level == KernelSSE)
+    {
+        splitStereoFloat32SSE((const float*) in, left, right, count);
+        return;
+    }
+#endif
+    splitStereoScalar(in, format, left, right, 0, count);
+}
+
+/**
+\brief Splits interleaved frames into one float array per channel.
+
+\param in --- the first sample of the whole span.
+\param format --- how the samples are stored.
+\param channels --- samples per frame.
+\param frame --- index of the first frame to split.
+\param out --- channels arrays of count floats.
+\param count --- number of frames.
+
+The samples come out on the 16 bit scale.  Stereo 16 bit and float samples have vector versions,
+the other layouts are split one sample at a time.
+
+*/
+
+void deinterleave(const void* in, SampleFormat format, unsigned channels, std::uint64_t frame, float* const* out, int count)
+{
+    const unsigned char* bytes = (const unsigned char*) in + frame * channels * sampleBytes(format);
+    if (channels == 2)
+    {
+        splitStereo(bytes, format, out[0], out[1], count);
+        return;
+    }
+
+    for (int i = 0; i < count; i++)
+        for (unsigned c = 0; c < channels; c++)
+            out[c][i] = loadSample(bytes, format, (std::size_t) i * channels + c);
+}
+
+/**
+\brief Mixes interleaved frames down to the mean of their channels.
+
+\param in --- the first sample of the whole span.
+\param format --- how the samples are stored.
+\param channels --- samples per frame.
+\param frame --- index of the first frame to mix.
+\param out --- output, count floats on the 16 bit scale.
+\param count --- number of frames.
+
+*/
+
+void downmix(const void* in, SampleFormat format, unsigned channels, std::uint64_t frame, float* out, int count)
+{
+    const unsigned char* bytes = (const unsigned char*) in + frame * channels * sampleBytes(format);
+    if (channels == 2)
+    {
+        splitStereo(bytes, format, out, NULL, count);
+        return;
+    }
+
+    float scale = 1.0f / channels;
+    for (int i = 0; i < count; i++)
+    {
+        float sum = 0;
+        for (unsigned c = 0; c < channels; c++)
+            sum += loadSample(bytes, format, (std::size_t) i * channels + c);
+        out[i] = sum * scale;
+    }
+}
+
+/**
+\brief Turns a left and right channel into mid, (L+R)/2, and side, (L-R)/2.
+
+\param left --- count samples.
+\param right --- count samples.
+\param mid --- output, may be left.
+\param side --- output, may be right.
+\param count --- number of samples.
+
+Mid is exactly what downmix gives for the same two channels.
+
+*/
+
+void midSide(const float* left, const float* right, float* mid, float* side, int count)
+{
+#ifdef ANALYSIS_KERNELS_X86
+    switch (kernelLevel())
+    {
+    case KernelAVX2:
+        midSideAVX2(left, right, mid, side, count);
+        return;
+    case KernelSSE:
+        midSideSSE(left, right, mid, side, count);
+        return;
+    default:
+        break;
+    }
+#endif
+    midSideScalar(left, right, mid, side, 0, count);
+}
+
+/**
+\brief Returns the name of the kernel version in use, for logs and benchmarks.
+
+*/
+
+const char* magnitudeKernelName()
+{
+    switch (kernelLevel())
+    {
+    case KernelAVX2:
+        return "avx2";
+    case KernelSSE:
+        return "sse2";
+    default:
+        return "scalar";
+    }
+}
+
+/**
+\brief Sum of the rises in magnitude from one spectrum to the next, the half-wave rectified flux.
+
+\param mags --- count magnitudes of this frame.
+\param previous --- count magnitudes of the frame before.
+\param count --- number of bins.
+
+Written with a select so the loop has no branch.
+
+*/
+
+double spectralFlux(const double* mags, const double* previous, int count)
+{
+    double sum = 0;
+    for (int i = 0; i < count; i++)
+    {
+        double rise = mags[i] - previous[i];
+        sum += (rise > 0) ? rise : 0;
+    }
+    return sum;
+}
+
+/**
+\brief Single precision version of spectralFlux, summed in double.
+
+*/
+
+double spectralFlux(const float* mags, const float* previous, int count)
+{
+    double sum = 0;
+    for (int i = 0; i < count; i++)
+    {
+        float rise = mags[i] - previous[i];
+        sum += (rise > 0) ? rise : 0;
+    }
+    return sum;
+}
+
+/**
+\brief Takes the max of each value into the slot its index points at.
+
+\param values --- count values.
+\param index --- count slot numbers.
+\param count --- number of values.
+\param out --- the slots, updated in place.
+
+Written as a select rather than a test so it compiles to a max instruction with no branch.
+
+*/
+
+void gatherMax(const double* values, const int* index, int count, double* out)
+{
+    for (int i = 0; i < count; i++)
+    {
+        double v = values[i];
+        double o = out[index[i]];
+        out[index[i]] = (v > o) ? v : o;
+    }
+}
+
+/**
+\brief Single precision version of gatherMax, the slots stay double.
+
+*/
+
+void gatherMax(const float* values, const int* index, int count, double* out)
+{
+    for (int i = 0; i < count; i++)
+    {
+        double v = values[i];
+        double o = out[index[i]];
+        out[index[i]] = (v > o) ? v : o;
+    }
+}
+
+/**
+\brief Scales each band by its peak, giving bar heights from 0 to 1.
+
+\param mags --- count band magnitudes.
+\param peaks --- count band peaks, a band with no peak yet reads 0.
+\param out --- output, count heights.
+\param count --- number of bands.
+
+*/
+
+void normaliseBands(const double* mags, const double* peaks, float* out, int count)
+{
+#ifdef ANALYSIS_KERNELS_X86
+    switch (kernelLevel())
+    {
+    case KernelAVX2:
+        normaliseAVX2(mags, peaks, out, count);
+        return;
+    case KernelSSE:
+        normaliseSSE(mags, peaks, out, count);
+        return;
+    default:
+        break;
+    }
+#endif
+    normaliseScalar(mags, peaks, out, 0, count);
+}
+
+/**
+\brief Maps heights from 0 to 1 onto a decibel scale in place.
+
+\param values --- count heights, the band's peak is 1.
+\param count --- number of values.
+\param floorDb --- level that maps to 0, such as -60.  The peak maps to 1.
+
+*/
+
+void mapDecibels(float* values, int count, float floorDb)
+{
+    float scale = 6.0205999f / floorDb; // 20 log10(v) = 6.02 log2(v)
+#ifdef ANALYSIS_KERNELS_X86
+    switch (kernelLevel())
+    {
+    case KernelAVX2:
+        decibelsAVX2(values, scale, count);
+        return;
+    case KernelSSE:
+        decibelsSSE(values, scale, count);
+        return;
+    default:
+        break;
+    }
+#endif
+    decibelsScalar(values, scale, 0, count);
+}
+
+/**
+\brief Moves each level toward its target and updates the held peaks.
+
+\param target --- count heights to move toward.
+\param level --- count smoothed heights, updated in place.
+\param peak --- count held peaks, updated in place.
+\param hold --- count seconds left before each peak falls, updated in place.
+\param count --- number of bands.
+\param step --- the gains and times for this step.
+
+A level follows a rise by attackGain of the difference and a fall by releaseGain.  A peak
+is pushed up by its level and held for holdTime, then falls by peakDrop a step until it
+rests on the level again.
+
+*/
+
+void smoothEnvelope(const float* target, float* level, float* peak, float* hold, int count, const EnvelopeStep& step)
+{
+#ifdef ANALYSIS_KERNELS_X86
+    switch (kernelLevel())
+    {
+    case KernelAVX2:
+        envelopeAVX2(target, level, peak, hold, step, count);
+        return;
+    case KernelSSE:
+        envelopeSSE(target, level, peak, hold, step, count);
+        return;
+    default:
+        break;
+    }
+#endif
+    envelopeScalar(target, level, peak, hold, step, 0, count);
+}
@@ -0,0 +1,57 @@
+#ifndef ANALYSISKERNELS_H_INCLUDED
+#define ANALYSISKERNELS_H_INCLUDED
+
+#include <fftw3.h>
+#include <cstdint>
+
+#include "SampleFormat.h"
+
+/**
+\file AnalysisKernels.h
+\brief Header file for AnalysisKernels.cpp
+
+Inner loops of the spectral analysis and of the bar smoothing.  The streaming kernels have AVX2,
+SSE and scalar versions; the best one the CPU supports is picked on first use.
+
+*/
+
+void computeMagnitudes(const fftw_complex* spectrum, double* mags, int count);
+void computeMagnitudes(const fftwf_complex* spectrum, float* mags, int count);
+const char* magnitudeKernelName();
+
+void windowFrame(const double* in, const double* window, double* out, int count);
+void windowFrame(const float* in, const float* window, float* out, int count);
+void windowFrame(const float* in, const double* window, double* out, int count);
+void windowFrame(const std::int16_t* in, const double* window, double* out, int count);
+void windowFrame(const std::int16_t* in, const float* window, float* out, int count);
+void windowSamples(const void* in, SampleFormat format, std::uint64_t start, const double* window, double* out, int count);
+void windowSamples(const void* in, SampleFormat format, std::uint64_t start, const float* window, float* out, int count);
+
+void deinterleave(const void* in, SampleFormat format, unsigned channels, std::uint64_t frame, float* const* out, int count);
+void downmix(const void* in, SampleFormat format, unsigned channels, std::uint64_t frame, float* out, int count);
+void midSide(const float* left, const float* right, float* mid, float* side, int count);
+
+double spectralFlux(const double* mags, const double* previous, int count);
+double spectralFlux(const float* mags, const float* previous, int count);
+
+void gatherMax(const double* values, const int* index, int count, double* out);
+void gatherMax(const float* values, const int* index, int count, double* out);
+
+/**
+\brief One time step of smoothEnvelope, the same for every band.
+*/
+
+struct EnvelopeStep
+{
+    float attackGain;   ///< Fraction of a rise followed this step.
+    float releaseGain;  ///< Fraction of a fall followed this step.
+    float elapsed;      ///< Seconds since the last step.
+    float holdTime;     ///< Seconds a peak is held before it falls.
+    float peakDrop;     ///< How far a peak past its hold falls this step.
+};
+
+void normaliseBands(const double* mags, const double* peaks, float* out, int count);
+void mapDecibels(float* values, int count, float floorDb);
+void smoothEnvelope(const float* target, float* level, float* peak, float* hold, int count, const EnvelopeStep& step);
+
+#endif // ANALYSISKERNELS_H_INCLUDED
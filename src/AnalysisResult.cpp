@@ -0,0 +1,318 @@
+#include "AnalysisResult.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+\file AnalysisResult.cpp
+\brief Storage for the band peaks and onset strengths of an analysis.
+
+*/
+
+//  Owned values start on a cache line, so a band's history or a frame's bands load without a split.
+
+static const std::size_t CacheLine = 64;
+
+/**
+\brief Constructor, holds no values.
+
+*/
+
+AnalysisResult::AnalysisResult()
+{
+    storage = NULL;
+    block = NULL;
+    values = NULL;
+    layout = ResultFrameMajor;
+    rows = 0;
+    bandCount = 0;
+    viewCount = 1;
+}
+
+/**
+\brief Destructor, frees owned values, a mapping belongs to its owner.
+
+*/
+
+AnalysisResult::~AnalysisResult()
+{
+    release();
+}
+
+/**
+\brief Makes zeroed room for an analysis.
+
+\param order --- frame major or band major.
+\param frames --- frames to make room for.
+\param bands --- bands per view.
+\param views --- band sets per frame.
+
+\return False if the allocation failed, the result is then empty.
+
+*/
+
+bool AnalysisResult::allocate(ResultLayout order, int frames, int bands, int views)
+{
+    release();
+    layout = order;
+    rows = frames;
+    bandCount = bands;
+    viewCount = views;
+
+    block = calloc(size() * sizeof(double) + CacheLine, 1);
+    if (block == NULL)
+    {
+        rows = 0;
+        return false;
+    }
+    uintptr_t start = ((uintptr_t) block + CacheLine - 1) & ~(uintptr_t) (CacheLine - 1);
+    storage = (double*) start;
+    values = storage;
+    return true;
+}
+
+/**
+\brief Reads the values of an analysis from memory owned elsewhere.
+
+\param mapped --- frames * (bands * views + 1) values in order, must outlive the result or a release.
+
+Mapped values are read only, the writers must not be called until the next allocate.
+
+*/
+
+void AnalysisResult::map(const double* mapped, ResultLayout order, int frames, int bands, int views)
+{
+    release();
+    layout = order;
+    rows = frames;
+    bandCount = bands;
+    viewCount = views;
+    values = mapped;
+}
+
+/**
+\brief Writes the values of an analysis to memory owned elsewhere.
+
+\param mapped --- room for frames * (bands * views + 1) values, zeroed, must outlive the result or a release.
+
+For a result written in place, such as a file mapping too long to hold in memory.  The writers
+work as they do on owned values.
+
+*/
+
+void AnalysisResult::attach(double* mapped, ResultLayout order, int frames, int bands, int views)
+{
+    release();
+    layout = order;
+    rows = frames;
+    bandCount = bands;
+    viewCount = views;
+    storage = mapped;
+    values = storage;
+}
+
+/**
+\brief Frees owned values and forgets mapped ones.
+
+*/
+
+void AnalysisResult::release()
+{
+    free(block);
+    block = NULL;
+    storage = NULL;
+    values = NULL;
+    rows = 0;
+}
+
+/**
+\brief Returns true if the values are mapped read-only.
+
+*/
+
+bool AnalysisResult::isMapped() const
+{
+    return values != NULL && storage == NULL;
+}
+
+/**
+\brief Returns how the values are laid out.
+
+*/
+
+ResultLayout AnalysisResult::getLayout() const
+{
+    return layout;
+}
+
+/**
+\brief Returns the number of frames there is room for.
+
+*/
+
+int AnalysisResult::getRows() const
+{
+    return rows;
+}
+
+/**
+\brief Returns the values per frame, the bands of every view and the onset strength.
+
+*/
+
+int AnalysisResult::getStride() const
+{
+    return bandCount * viewCount + 1;
+}
+
+/**
+\brief Returns the number of values held.
+
+*/
+
+std::size_t AnalysisResult::size() const
+{
+    return (std::size_t) rows * getStride();
+}
+
+/**
+\brief Returns every value in order, size() of them, or NULL if there are none.
+
+*/
+
+const double* AnalysisResult::data() const
+{
+    return values;
+}
+
+/**
+\brief Returns where a value of a frame is kept.
+
+\param frame --- the frame.
+\param value --- the value of the frame, view * bandCount + band, or getStride() - 1 for the onset strength.
+
+*/
+
+std::size_t AnalysisResult::indexOf(int frame, int value) const
+{
+    if (layout == ResultBandMajor)
+        return (std::size_t) value * rows + frame;
+    return (std::size_t) frame * getStride() + value;
+}
+
+/**
+\brief Returns a value of a frame to write, the values must be owned.
+
+*/
+
+double* AnalysisResult::slot(int frame, int value)
+{
+    return &storage[indexOf(frame, value)];
+}
+
+/**
+\brief Returns where to write the bands of a frame.
+
+\param frame --- the frame.
+\param view --- which view.
+\param scratch --- bandCount doubles to use when the bands are not contiguous.
+
+The bands of a frame are written in place when frame major and to scratch when band major, storeFrame
+then puts them where they belong.
+
+*/
+
+double* AnalysisResult::frameOutput(int frame, int view, double* scratch)
+{
+    if (layout == ResultBandMajor)
+        return scratch;
+    return slot(frame, view * bandCount);
+}
+
+/**
+\brief Stores the bands of a frame written to frameOutput.
+
+\param frame --- the frame.
+\param view --- which view.
+\param mags --- what frameOutput returned, already in place when frame major.
+
+*/
+
+void AnalysisResult::storeFrame(int frame, int view, const double* mags)
+{
+    double* to = slot(frame, view * bandCount);
+    if (to == mags)
+        return;
+    for (int b = 0; b < bandCount; b++)
+        to[(std::size_t) b * rows] = mags[b]; // only band major scatters
+}
+
+/**
+\brief Returns a value of a frame.
+
+\param frame --- the frame.
+\param value --- view * bandCount + band, or getStride() - 1 for the onset strength.
+
+*/
+
+double AnalysisResult::value(int frame, int value) const
+{
+    return values[indexOf(frame, value)];
+}
+
+/**
+\brief Returns the bands of one frame of a view.
+
+*/
+
+ValueSpan AnalysisResult::frame(int frame, int view) const
+{
+    ValueSpan span = {&values[indexOf(frame, view * bandCount)], (std::size_t) bandCount,
+                      layout == ResultBandMajor ? (std::size_t) rows : 1};
+    return span;
+}
+
+/**
+\brief Returns the history of one band of a view.
+
+\param band --- the band.
+\param view --- which view.
+\param first --- the first frame.
+\param count --- the number of frames.
+
+Contiguous when band major.
+
+*/
+
+ValueSpan AnalysisResult::band(int band, int view, int first, int count) const
+{
+    ValueSpan span = {&values[indexOf(first, view * bandCount + band)], (std::size_t) count,
+                      layout == ResultBandMajor ? 1 : (std::size_t) getStride()};
+    return span;
+}
+
+/**
+\brief Returns the onset strengths of a run of frames.
+
+*/
+
+ValueSpan AnalysisResult::onsetStrengths(int first, int count) const
+{
+    ValueSpan span = {&values[indexOf(first, getStride() - 1)], (std::size_t) count,
+                      layout == ResultBandMajor ? 1 : (std::size_t) getStride()};
+    return span;
+}
+
+/**
+\brief Returns the bands of a run of frames of a view.
+
+*/
+
+FrameSpan AnalysisResult::frames(int first, int count, int view) const
+{
+    bool bandMajor = layout == ResultBandMajor;
+    FrameSpan span = {&values[indexOf(first, view * bandCount)], (std::size_t) count, (std::size_t) bandCount,
+                      bandMajor ? 1 : (std::size_t) getStride(), bandMajor ? (std::size_t) rows : 1};
+    return span;
+}
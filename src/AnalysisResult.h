@@ -0,0 +1,128 @@
+#ifndef ANALYSISRESULT_H_INCLUDED
+#define ANALYSISRESULT_H_INCLUDED
+
+#include <cstddef>
+
+/**
+\file AnalysisResult.h
+\brief Header file for AnalysisResult.cpp
+
+*/
+
+/**
+\brief How the values of an analysis are laid out in memory.
+
+*/
+
+enum ResultLayout
+{
+    ResultFrameMajor,   ///< Every value of a frame together, the bands of each view and then its onset strength.
+    ResultBandMajor     ///< The history of each value together, one row of every frame per band and one for the onset strengths.
+};
+
+/**
+\brief Read-only values spaced stride doubles apart, usually a frame's bands or a band's history.
+
+The span does not own the values.  A span of contiguous values has a stride of 1.
+
+*/
+
+struct ValueSpan
+{
+    const double* data;     ///< First value, NULL for an empty span.
+    std::size_t count;      ///< Number of values.
+    std::size_t stride;     ///< Doubles from one value to the next.
+
+    double operator[](std::size_t i) const
+    {
+        return data[i * stride];
+    }
+};
+
+/**
+\brief Read-only band values of a run of frames of one view.
+
+*/
+
+struct FrameSpan
+{
+    const double* data;         ///< First band of the first frame, NULL for an empty span.
+    std::size_t frames;         ///< Number of frames.
+    std::size_t bands;          ///< Bands per frame.
+    std::size_t frameStride;    ///< Doubles from a band of one frame to the same band of the next.
+    std::size_t bandStride;     ///< Doubles from one band of a frame to the next.
+
+    double at(std::size_t frame, std::size_t band) const
+    {
+        return data[frame * frameStride + band * bandStride];
+    }
+
+    ValueSpan frame(std::size_t frame) const
+    {
+        ValueSpan span = {data + frame * frameStride, bands, bandStride};
+        return span;
+    }
+
+    ValueSpan band(std::size_t band) const
+    {
+        ValueSpan span = {data + band * bandStride, frames, frameStride};
+        return span;
+    }
+};
+
+/**
+\class AnalysisResult
+
+\brief The band peaks and onset strength of every frame of an analysis.
+
+Each frame has getStride() values, bandCount per view and then the onset strength, laid out frame
+major or band major.  The values are either owned, zeroed and aligned to a 64 byte cache line, a
+read-only mapping such as a cached result, or a writable mapping the analysis fills in place.  The
+spans read the values where they lie, the owner keeps readers to the frames that are complete.
+
+*/
+
+class AnalysisResult
+{
+private:
+    double* storage;        ///< Values that can be written, owned or attached, NULL when mapped.
+    void* block;            ///< The allocation storage was aligned within.
+    const double* values;   ///< storage, or the mapped values.
+    ResultLayout layout;    ///< How values are laid out.
+    int rows;               ///< Frames there is room for.
+    int bandCount;          ///< Bands per view.
+    int viewCount;          ///< Band sets per frame.
+
+    std::size_t indexOf(int frame, int value) const;
+
+    AnalysisResult(const AnalysisResult&);
+    AnalysisResult& operator=(const AnalysisResult&);
+
+public:
+    AnalysisResult();
+    ~AnalysisResult();
+
+    bool allocate(ResultLayout order, int frames, int bands, int views);
+    void map(const double* mapped, ResultLayout order, int frames, int bands, int views);
+    void attach(double* mapped, ResultLayout order, int frames, int bands, int views);
+    void release();
+
+    bool isMapped() const;
+    ResultLayout getLayout() const;
+    int getRows() const;
+    int getStride() const;
+    std::size_t size() const;
+    const double* data() const;
+
+    double* slot(int frame, int value);
+    double* frameOutput(int frame, int view, double* scratch);
+    void storeFrame(int frame, int view, const double* mags);
+
+    double value(int frame, int value) const;
+    ValueSpan frame(int frame, int view) const;
+    ValueSpan band(int band, int view, int first, int count) const;
+    ValueSpan onsetStrengths(int first, int count) const;
+    FrameSpan frames(int first, int count, int view) const;
+};
+
+#endif // ANALYSISRESULT_H_INCLUDED
@@ -0,0 +1,468 @@
+#include "AudioStream.h"
+
+#include <chrono>
+
+/**
+\file AudioStream.cpp
+\brief Streams playback from samples held in memory or in a file mapping.
+
+*/
+
+/**
+\brief Converts samples to the 16 bit samples SFML plays.
+
+\param span --- the source samples.
+\param start --- first sample to convert.
+\param count --- number of samples.
+\param out --- output, count samples.
+
+*/
+
+static void toInt16(const SampleSpan& span, std::uint64_t start, std::size_t count, sf::Int16* out)
+{
+    if (span.format == SampleInt24)
+    {
+        const unsigned char* in = (const unsigned char*) span.data + start * 3;
+        for (std::size_t i = 0; i < count; i++)
+            out[i] = (sf::Int16) (in[3 * i + 1] | (in[3 * i + 2] << 8)); // keep the top 16 bits
+    }
+    else
+    {
+        const float* in = (const float*) span.data + start;
+        for (std::size_t i = 0; i < count; i++)
+        {
+            float v = in[i] * 32768.0f;
+            v = (v > 32767.0f) ? 32767.0f : (v < -32768.0f ? -32768.0f : v);
+            out[i] = (sf::Int16) (v < 0 ? v - 0.5f : v + 0.5f);
+        }
+    }
+}
+
+/**
+\brief Constructor, nothing to play until setSource is called.
+
+*/
+
+AudioStream::AudioStream()
+{
+    source.data = NULL;
+    source.format = SampleInt16;
+    source.count = 0;
+    source.channels = 0;
+    pipeline = NULL;
+    held = NULL;
+    sampleRate = 0;
+    channels = 0;
+    position = 0;
+    queued = 0;
+    chunkSamples = 0;
+
+    nextSource = source;
+    nextPipeline = NULL;
+    nextQueued = false;
+
+    clockSequence = 0;
+    clockSample = 0;
+    clockTime = 0;
+    clockRunning = false;
+    clockBase = 0;
+    clockPrevious = 0;
+    clockSource = 0;
+}
+
+/**
+\brief Destructor, stops the streaming thread before the object goes away.
+
+*/
+
+AudioStream::~AudioStream()
+{
+    sf::SoundStream::stop();
+}
+
+/**
+\brief Sets the samples to play from the start.
+
+\param span --- the samples, must outlive the stream.
+\param rate --- frames per second.
+
+Any queued source is dropped.
+
+*/
+
+void AudioStream::setSource(const SampleSpan& span, unsigned int rate)
+{
+    stop();
+    if (pipeline != NULL)
+        pipeline->release(held); // the last block of a source that played to its end
+    held = NULL;
+    source = span;
+    pipeline = NULL;
+    sampleRate = rate;
+    channels = span.channels;
+    position = 0;
+    queued = 0;
+    {
+        std::lock_guard<std::mutex> lock(nextMutex);
+        nextQueued = false;
+        nextPipeline = NULL;
+    }
+    publishSource(0, 0, 0);
+    publishClock(0, false);
+    chunkSamples = (std::size_t) (rate / 10 + 1) * span.channels;
+    converted.resize(chunkSamples); // a queued source may not be 16 bit either
+
+    if (span.channels > 0 && rate > 0)
+        initialize(span.channels, rate);
+}
+
+/**
+\brief Sets a file decoded ahead of playback to play from the start.
+
+\param decoder --- the open pipeline, must outlive the stream.  The stream is its only reader.
+
+Seeks move the pipeline, blocks still in its pool are played again without decoding.
+
+*/
+
+void AudioStream::setSource(DecodePipeline& decoder)
+{
+    SampleSpan span;
+    span.data = NULL;
+    span.format = SampleInt16;
+    span.count = decoder.getSampleCount();
+    span.channels = decoder.getChannelCount();
+    setSource(span, decoder.getSampleRate());
+    pipeline = &decoder;
+    pipeline->seek(0);
+}
+
+/**
+\brief Stops playback and lets go of the source and any queued one, so they can go away.
+
+*/
+
+void AudioStream::clearSource()
+{
+    SampleSpan none;
+    none.data = NULL;
+    none.format = SampleInt16;
+    none.count = 0;
+    none.channels = 0;
+    setSource(none, 0);
+}
+
+/**
+\brief Queues samples to play straight after the current source, without a gap.
+
+\param span --- the samples, must outlive the stream.
+\param rate --- frames per second.
+
+Replaces a source queued earlier that has not been moved on to yet.
+
+\return False if the samples differ in rate or channels from the current source, or are empty.
+They then have to be played with setSource once the current source has stopped.
+
+*/
+
+bool AudioStream::queueSource(const SampleSpan& span, unsigned int rate)
+{
+    return queue(span, rate, NULL);
+}
+
+/**
+\brief Queues a file decoded ahead of playback to play straight after the current source.
+
+\param decoder --- the open pipeline at its start, must outlive the stream.  The stream becomes its only reader.
+
+\return False if the file differs in rate or channels from the current source, see queueSource.
+
+*/
+
+bool AudioStream::queueSource(DecodePipeline& decoder)
+{
+    SampleSpan span;
+    span.data = NULL;
+    span.format = SampleInt16;
+    span.count = decoder.getSampleCount();
+    span.channels = decoder.getChannelCount();
+    return queue(span, decoder.getSampleRate(), &decoder);
+}
+
+/**
+\brief Queues a source, see queueSource.
+
+*/
+
+bool AudioStream::queue(const SampleSpan& span, unsigned int rate, DecodePipeline* decoder)
+{
+    if (span.channels != channels || rate != sampleRate || span.count == 0)
+        return false;
+
+    std::lock_guard<std::mutex> lock(nextMutex);
+    nextSource = span;
+    nextPipeline = decoder;
+    nextQueued = true;
+    return true;
+}
+
+/**
+\brief Moves on to the queued source once the current one has been handed to SFML, on the audio thread.
+
+\return False if nothing is queued.
+
+*/
+
+bool AudioStream::takeNext()
+{
+    std::lock_guard<std::mutex> lock(nextMutex);
+    if (!nextQueued)
+        return false;
+
+    if (pipeline != NULL)
+        pipeline->release(held);
+    held = NULL;
+
+    std::uint64_t base = clockBase.load(std::memory_order_relaxed);
+    publishSource(base + source.count, base, clockSource.load(std::memory_order_relaxed) + 1);
+    source = nextSource;
+    pipeline = nextPipeline;
+    position = 0;
+    nextQueued = false;
+    return true;
+}
+
+/**
+\brief Hands SFML the next chunk of samples.
+
+\param data --- filled with the chunk.
+
+\return False at the end of the samples with nothing queued, which stops the stream.
+
+*/
+
+bool AudioStream::onGetData(Chunk& data)
+{
+    if (position >= source.count && !takeNext())
+        return false;
+
+    std::uint64_t left = source.count - position;
+    std::size_t count = (left < chunkSamples) ? (std::size_t) left : chunkSamples;
+
+    if (pipeline != NULL)
+    {
+        // SFML has copied the last block into its buffer by now, so it can go back to the pool.
+        pipeline->release(held);
+        held = pipeline->acquire();
+        while (held != NULL && held->first + held->count <= position)
+        {
+            pipeline->release(held);
+            held = pipeline->acquire();
+        }
+        if (held == NULL)
+            return false;
+
+        std::size_t skip = (std::size_t) (position - held->first);
+        count = held->count - skip;
+        data.samples = held->samples + skip; // straight from the block
+    }
+    else if (source.format == SampleInt16)
+    {
+        data.samples = (const sf::Int16*) source.data + position; // straight from the mapping
+    }
+    else
+    {
+        toInt16(source, position, count, &converted[0]);
+        data.samples = &converted[0];
+    }
+    data.sampleCount = count;
+    position += count;
+    queued.store(clockBase.load(std::memory_order_relaxed) + position, std::memory_order_relaxed);
+
+    // The offset OpenAL reports is where the device is now, so it anchors the clock exactly.
+    std::uint64_t playing = (std::uint64_t) getPlayingOffset().asMicroseconds() * sampleRate / 1000000;
+    publishClock(playing * channels, true);
+
+    return true;
+}
+
+/**
+\brief Moves playback to a new offset.
+
+\param timeOffset --- the new playing offset in the current source.
+
+SFML counts its offset from the seek on, so the current source starts at 0 again.
+
+*/
+
+void AudioStream::onSeek(sf::Time timeOffset)
+{
+    std::uint64_t frame = (std::uint64_t) timeOffset.asMicroseconds() * sampleRate / 1000000;
+    std::uint64_t sample = frame * channels;
+    position = (sample > source.count) ? source.count : sample;
+    queued = position.load();
+    if (pipeline != NULL)
+    {
+        pipeline->release(held);
+        held = NULL;
+        pipeline->seek(position);
+    }
+    publishSource(0, 0, clockSource.load(std::memory_order_relaxed));
+    publishClock(position, getStatus() == Playing);
+}
+
+/**
+\brief Starts or resumes playback, the clock runs on from where it stopped.
+
+*/
+
+void AudioStream::play()
+{
+    std::uint64_t base, previous;
+    unsigned number;
+    publishClock(readClock(&base, &previous, &number), true);
+    sf::SoundStream::play();
+}
+
+/**
+\brief Pauses playback and holds the clock at the sample being heard.
+
+*/
+
+void AudioStream::pause()
+{
+    sf::SoundStream::pause();
+    std::uint64_t base, previous;
+    unsigned number;
+    publishClock(readClock(&base, &previous, &number), false);
+}
+
+/**
+\brief Stops playback and rewinds to the start.
+
+*/
+
+void AudioStream::stop()
+{
+    sf::SoundStream::stop();
+    publishClock(0, false);
+}
+
+/**
+\brief Returns the steady clock time in microseconds.
+
+*/
+
+std::int64_t AudioStream::nowMicros()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+\brief Sets the clock's anchor to a sample at the current time.
+
+\param sample --- the sample being heard now.
+\param running --- false to hold the clock at sample.
+
+*/
+
+void AudioStream::publishClock(std::uint64_t sample, bool running)
+{
+    std::lock_guard<std::mutex> lock(clockWriteMutex);
+    unsigned seq = clockSequence.load(std::memory_order_relaxed);
+    clockSequence.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    clockSample.store(sample, std::memory_order_relaxed);
+    clockTime.store(nowMicros(), std::memory_order_relaxed);
+    clockRunning.store(running, std::memory_order_relaxed);
+    clockSequence.store(seq + 2, std::memory_order_release);
+}
+
+/**
+\brief Sets where the current source and the one before it start, as the clock counts.
+
+\param base --- sample the current source starts at.
+\param previous --- sample the source before it started at.
+\param number --- sources moved on to since setSource.
+
+*/
+
+void AudioStream::publishSource(std::uint64_t base, std::uint64_t previous, unsigned number)
+{
+    std::lock_guard<std::mutex> lock(clockWriteMutex);
+    unsigned seq = clockSequence.load(std::memory_order_relaxed);
+    clockSequence.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    clockBase.store(base, std::memory_order_relaxed);
+    clockPrevious.store(previous, std::memory_order_relaxed);
+    clockSource.store(number, std::memory_order_relaxed);
+    clockSequence.store(seq + 2, std::memory_order_release);
+}
+
+/**
+\brief Reads the anchor and adds the time since it, capped at the samples SFML has been given.
+
+\param base --- output, sample the current source starts at.
+\param previous --- output, sample the source before it started at.
+\param number --- output, the current source's number.
+
+\return The sample being heard, counted since playback started over every source.
+
+*/
+
+std::uint64_t AudioStream::readClock(std::uint64_t* base, std::uint64_t* previous, unsigned* number) const
+{
+    unsigned before, after;
+    std::uint64_t sample;
+    std::int64_t time;
+    bool running;
+    do
+    {
+        before = clockSequence.load(std::memory_order_acquire);
+        sample = clockSample.load(std::memory_order_relaxed);
+        time = clockTime.load(std::memory_order_relaxed);
+        running = clockRunning.load(std::memory_order_relaxed);
+        *base = clockBase.load(std::memory_order_relaxed);
+        *previous = clockPrevious.load(std::memory_order_relaxed);
+        *number = clockSource.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        after = clockSequence.load(std::memory_order_relaxed);
+    }
+    while ((before & 1) != 0 || before != after);
+
+    if (running && channels > 0)
+    {
+        std::int64_t elapsed = nowMicros() - time;
+        if (elapsed > 0)
+            sample += (std::uint64_t) elapsed * sampleRate / 1000000 * channels;
+        std::uint64_t handed = queued.load(std::memory_order_relaxed);
+        sample = (sample > handed) ? handed : sample;
+    }
+    return sample;
+}
+
+/**
+\brief Returns the sample being heard in its source, over all channels.
+
+\param number --- output if not NULL, which source is being heard, 0 for the one given to
+setSource and one more for each queued source moved on to.
+
+Just after the stream has moved on to a queued source the buffers still play the end of the one
+before, which is the source then reported.  Safe to call from any thread, typically once per
+rendered frame.
+
+*/
+
+std::uint64_t AudioStream::getPlaybackSample(unsigned* number) const
+{
+    std::uint64_t base, previous;
+    unsigned current;
+    std::uint64_t sample = readClock(&base, &previous, &current);
+
+    bool before = sample < base && current > 0;
+    if (number != NULL)
+        *number = before ? current - 1 : current;
+    if (before)
+        return (sample > previous) ? sample - previous : 0; // a source shorter than the buffers, already gone
+    return sample - base;
+}
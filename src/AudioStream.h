@@ -0,0 +1,96 @@
+#ifndef AUDIOSTREAM_H_INCLUDED
+#define AUDIOSTREAM_H_INCLUDED
+
+#include <SFML/Audio.hpp>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "SampleFormat.h"
+#include "DecodePipeline.h"
+
+/**
+\file AudioStream.h
+\brief Header file for AudioStream.cpp
+
+*/
+
+/**
+\class AudioStream
+
+\brief Plays samples that live elsewhere, such as a WavFile mapping, without loading them.
+
+16 bit samples are handed to SFML in place.  24 bit and float samples are converted one chunk
+at a time into a small buffer.  A DecodePipeline's blocks are handed to SFML in place too, each
+block is held until SFML asks for the next one.
+
+A second source can be queued to follow the first.  When the first runs out, the audio thread
+moves straight on to the queued one in the same call, so SFML sees one unbroken stream and the
+two play without a gap.  Both must have the same sample rate and channels, SFML's format is set
+once per stream.
+
+Every time SFML asks for a chunk the stream reads the device's playing offset and publishes it
+with a timestamp.  getPlaybackSample extends that anchor by the time since, so any thread can
+find the sample being heard without a call into OpenAL.  The anchor counts samples since playback
+started, over every source, and carries where the current source and the one before it started,
+so the sample heard is placed in the right source for the buffers still playing the one before.
+The anchor is a seqlock, the reader never blocks the audio thread.
+
+*/
+
+class AudioStream : public sf::SoundStream
+{
+private:
+    SampleSpan source;                  ///< The samples being played, no data when they come from pipeline.
+    DecodePipeline* pipeline;           ///< The decoder of the file being played when it is not held in memory, or NULL.
+    const PcmBlock* held;               ///< The pipeline's block SFML is playing from, or NULL.
+    unsigned int sampleRate;            ///< Frames per second.
+    unsigned int channels;              ///< Samples per frame, the same for every source until setSource.
+    std::atomic<std::uint64_t> position; ///< Next sample of source to hand to SFML.
+    std::atomic<std::uint64_t> queued;  ///< Samples handed to SFML since playback started, over every source.
+    std::size_t chunkSamples;           ///< Samples per chunk, about a tenth of a second.
+    std::vector<sf::Int16> converted;   ///< Chunk buffer for samples that are not 16 bit.
+
+    std::mutex nextMutex;               ///< Guards the queued source, the audio thread takes it at the end of source.
+    SampleSpan nextSource;              ///< Samples to play once source runs out.
+    DecodePipeline* nextPipeline;       ///< The decoder of nextSource, or NULL.
+    bool nextQueued;                    ///< nextSource is set and not yet taken.
+
+    std::mutex clockWriteMutex;             ///< Orders the writers of the anchor, the audio thread and play/pause.
+    std::atomic<unsigned> clockSequence;    ///< Odd while the anchor is being written.
+    std::atomic<std::uint64_t> clockSample; ///< Sample playing at clockTime, counted since playback started.
+    std::atomic<std::int64_t> clockTime;    ///< Steady clock time of the anchor in microseconds.
+    std::atomic<bool> clockRunning;         ///< False while paused or stopped, the anchor then stays put.
+    std::atomic<std::uint64_t> clockBase;   ///< Sample the current source started at, counted as clockSample is.
+    std::atomic<std::uint64_t> clockPrevious; ///< Sample the source before it started at.
+    std::atomic<unsigned> clockSource;      ///< Sources moved on to since setSource, the current one's number.
+
+    bool queue(const SampleSpan& span, unsigned int rate, DecodePipeline* decoder);
+    bool takeNext();
+    std::uint64_t readClock(std::uint64_t* base, std::uint64_t* previous, unsigned* number) const;
+    void publishClock(std::uint64_t sample, bool running);
+    void publishSource(std::uint64_t base, std::uint64_t previous, unsigned number);
+    static std::int64_t nowMicros();
+
+    virtual bool onGetData(Chunk& data);
+    virtual void onSeek(sf::Time timeOffset);
+
+public:
+    AudioStream();
+    ~AudioStream();
+
+    void setSource(const SampleSpan& span, unsigned int rate);
+    void setSource(DecodePipeline& decoder);
+    void clearSource();
+    bool queueSource(const SampleSpan& span, unsigned int rate);
+    bool queueSource(DecodePipeline& decoder);
+
+    void play();
+    void pause();
+    void stop();
+
+    std::uint64_t getPlaybackSample(unsigned* number = NULL) const;
+};
+
+#endif // AUDIOSTREAM_H_INCLUDED
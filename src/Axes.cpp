@@ -1,4 +1,5 @@
 #include "Axes.h"
+#include "Tracer.h"
 
 /**
 \file Axes.cpp
@@ -43,6 +44,7 @@ Axes::~Axes()
 
 void Axes::LoadDataToGraphicsCard()
 {
+    TRACE_SCOPE("Axes upload");
     GLint vPosition = 0;
     GLint vColor = 1;
 
@@ -0,0 +1,223 @@
+#include "BandLayout.h"
+
+/**
+\file BandLayout.cpp
+\brief Band edge layouts and the bin to band lookup table.
+
+*/
+
+/**
+\brief Frequency in Hz to mels.
+
+*/
+
+static double hzToMel(double f)
+{
+    return 2595 * log10(1 + f / 700);
+}
+
+/**
+\brief Mels to frequency in Hz.
+
+*/
+
+static double melToHz(double m)
+{
+    return 700 * (pow(10, m / 2595) - 1);
+}
+
+/**
+\brief Frequency in Hz to Bark, Traunmuller's formula.
+
+*/
+
+static double hzToBark(double f)
+{
+    return 26.81 * f / (1960 + f) - 0.53;
+}
+
+/**
+\brief Bark to frequency in Hz, the inverse of hzToBark.
+
+*/
+
+static double barkToHz(double z)
+{
+    return 1960 * (z + 0.53) / (26.28 - z);
+}
+
+/**
+\brief Constructor
+
+\param s --- the band spacing.
+\param count --- number of bands, ignored for BandClassic which always has 5.  Bins per octave
+for BandConstantQ.
+\param low --- lower edge of the first band in Hz, the centre of the first bin for BandConstantQ.
+\param high --- upper edge of the last band in Hz, not used by the octave layouts.
+
+*/
+
+BandLayout::BandLayout(BandScale s, int count, double low, double high)
+{
+    scale = s;
+    bandCount = (scale == BandClassic) ? 5 : (count > 0 ? count : 1);
+    minFreq = (low > 0) ? low : 1;
+    maxFreq = (high > minFreq) ? high : minFreq * 2;
+
+    binsPerOctave = 0;
+    if (scale == BandConstantQ)
+    {
+        binsPerOctave = bandCount;
+        bandCount = (int) floor(binsPerOctave * log2(maxFreq / minFreq)) + 1; // every centre up to maxFreq
+    }
+    buildEdges();
+}
+
+/**
+\brief Works out the band edges for the current scale.
+
+*/
+
+void BandLayout::buildEdges()
+{
+    edges.resize(bandCount + 1);
+
+    for (int k = 0; k <= bandCount; k++)
+    {
+        double t = (double) k / bandCount;
+
+        switch (scale)
+        {
+        case BandLinear:
+            edges[k] = minFreq + (maxFreq - minFreq) * t;
+            break;
+        case BandLogarithmic:
+            edges[k] = minFreq * pow(maxFreq / minFreq, t);
+            break;
+        case BandOctave:
+            edges[k] = minFreq * pow(2.0, k);
+            break;
+        case BandThirdOctave:
+            edges[k] = minFreq * pow(2.0, k / 3.0);
+            break;
+        case BandMel:
+            edges[k] = melToHz(hzToMel(minFreq) + (hzToMel(maxFreq) - hzToMel(minFreq)) * t);
+            break;
+        case BandBark:
+            edges[k] = barkToHz(hzToBark(minFreq) + (hzToBark(maxFreq) - hzToBark(minFreq)) * t);
+            break;
+        case BandConstantQ:
+            edges[k] = minFreq * pow(2.0, (k - 0.5) / binsPerOctave); // half a bin either side of each centre
+            break;
+        default:
+            break;
+        }
+    }
+
+    if (scale == BandClassic)
+    {
+        edges[0] = 19;
+        edges[1] = 140;
+        edges[2] = 400;
+        edges[3] = 2600;
+        edges[4] = 5200;
+        edges[5] = HUGE_VAL;
+    }
+}
+
+/**
+\brief Returns the band spacing.
+
+*/
+
+BandScale BandLayout::getScale() const
+{
+    return scale;
+}
+
+/**
+\brief Returns the number of bands.
+
+*/
+
+int BandLayout::getBandCount() const
+{
+    return bandCount;
+}
+
+/**
+\brief Returns the bins per octave of a BandConstantQ layout, 0 for the other scales.
+
+*/
+
+int BandLayout::getBinsPerOctave() const
+{
+    return binsPerOctave;
+}
+
+/**
+\brief Returns the centre frequency of a band in Hz, geometric between its edges.
+
+*/
+
+double BandLayout::getCentre(int band) const
+{
+    if (scale == BandConstantQ)
+        return minFreq * pow(2.0, (double) band / binsPerOctave);
+    if (edges[band + 1] == HUGE_VAL)
+        return edges[band];
+    return sqrt(edges[band] * edges[band + 1]);
+}
+
+/**
+\brief Returns the bandCount + 1 band edges in Hz.
+
+*/
+
+const std::vector<double>& BandLayout::getEdges() const
+{
+    return edges;
+}
+
+/**
+\brief Builds the bin to band table for one sample rate and FFT size.
+
+\param sampleRate --- sample rate in samples per second.
+\param fftSize --- number of samples per FFT frame.
+\param table --- output, fftSize/2 band indices.  Bins in no band get getBandCount().
+
+The classic layout keeps the original integer frequency test, freq > lower edge and
+freq <= upper edge, so its bars match what they always were.  The other layouts put a bin
+in the band whose edges surround its centre frequency.
+
+*/
+
+void BandLayout::buildBinTable(unsigned int sampleRate, int fftSize, std::vector<int>& table) const
+{
+    int bins = fftSize / 2;
+    table.assign(bins, bandCount);
+
+    for (int i = 0; i < bins; i++)
+    {
+        for (int k = 0; k < bandCount; k++)
+        {
+            bool inBand;
+            if (scale == BandClassic)
+            {
+                int freq = (i * sampleRate / fftSize);
+                inBand = freq > edges[k] && freq <= edges[k + 1];
+            }
+            else
+            {
+                double freq = (double) i * sampleRate / fftSize;
+                inBand = freq >= edges[k] && freq < edges[k + 1];
+            }
+
+            if (inBand)
+            {
+                table[i] = k;
+                break;
+            }
+        }
+    }
+}
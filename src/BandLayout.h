@@ -0,0 +1,69 @@
+#ifndef BANDLAYOUT_H_INCLUDED
+#define BANDLAYOUT_H_INCLUDED
+
+#include <vector>
+#include <math.h>
+
+/**
+\file BandLayout.h
+\brief Header file for BandLayout.cpp
+
+*/
+
+/**
+\brief Ways of spacing the band edges over the spectrum.
+
+*/
+
+enum BandScale
+{
+    BandClassic,        ///< The original five bands, 19/140/400/2600/5200 Hz and up.
+    BandLinear,         ///< Equal width in Hz.
+    BandLogarithmic,    ///< Equal width in log frequency.
+    BandOctave,         ///< One octave per band.
+    BandThirdOctave,    ///< One third of an octave per band.
+    BandMel,            ///< Equal width on the mel scale.
+    BandBark,           ///< Equal width on the Bark scale.
+    BandConstantQ       ///< Constant-Q bins, count of them per octave, see ConstantQKernel.
+};
+
+/**
+\class BandLayout
+
+\brief Splits the spectrum into bands and maps each FFT bin to its band.
+
+The table built by buildBinTable holds one band index per bin, with bins outside every band
+pointing at an extra slot numbered getBandCount().  The reduction can then take a max through
+the table for every bin without testing which band it is in.
+
+BandConstantQ is the exception, its count is bins per octave and the band count follows from
+the range.  SpectrumAnalyzer measures those bins with a ConstantQKernel instead of the table,
+the table only groups FFT bins between the same edges.
+
+*/
+
+class BandLayout
+{
+private:
+    BandScale scale;            ///< How the edges are spaced.
+    int bandCount;              ///< Number of bands.
+    int binsPerOctave;          ///< Bands per octave of BandConstantQ, 0 for the other scales.
+    double minFreq;             ///< Lower edge of the first band in Hz.
+    double maxFreq;             ///< Upper edge of the last band in Hz.
+    std::vector<double> edges;  ///< bandCount + 1 band edges in Hz.
+
+    void buildEdges();
+
+public:
+    BandLayout(BandScale s = BandClassic, int count = 5, double low = 20, double high = 20000);
+
+    BandScale getScale() const;
+    int getBandCount() const;
+    int getBinsPerOctave() const;
+    double getCentre(int band) const;
+    const std::vector<double>& getEdges() const;
+
+    void buildBinTable(unsigned int sampleRate, int fftSize, std::vector<int>& table) const;
+};
+
+#endif // BANDLAYOUT_H_INCLUDED
@@ -0,0 +1,162 @@
+#include "BandSmoother.h"
+
+#include <math.h>
+
+#include "ProgramDefines.h"
+#include "AnalysisKernels.h"
+
+/**
+\file BandSmoother.cpp
+\brief Attack, release and peak hold for the bar heights.
+
+*/
+
+/**
+\brief Constructor
+
+No bands until setBandCount, the times and scale come from ProgramDefines.h.
+
+*/
+
+BandSmoother::BandSmoother()
+{
+    bandCount = 0;
+    stride = 0;
+    setTimes(BarAttackSeconds, BarReleaseSeconds, BarPeakHoldSeconds, BarPeakFallPerSecond);
+    setDecibelFloor(BarDecibelFloor);
+}
+
+/**
+\brief Sizes the state for a number of bands and resets it.
+
+*/
+
+void BandSmoother::setBandCount(int count)
+{
+    bandCount = (count > 0) ? count : 0;
+    stride = (bandCount + 15) / 16 * 16; // 16 floats, 64 bytes, so each array starts a cache line apart
+    state.assign((std::size_t) stride * 4, 0.0f);
+}
+
+/**
+\brief Sets how fast the bars move.
+
+\param attack --- time constant of a rise in seconds, 0 to jump straight up.
+\param release --- time constant of a fall in seconds, 0 to drop straight down.
+\param hold --- seconds a peak is held before it falls.
+\param fall --- bar heights per second a peak falls after its hold.
+
+*/
+
+void BandSmoother::setTimes(float attack, float release, float hold, float fall)
+{
+    attackTime = (attack > 0) ? attack : 0;
+    releaseTime = (release > 0) ? release : 0;
+    holdTime = (hold > 0) ? hold : 0;
+    peakFall = (fall > 0) ? fall : 0;
+}
+
+/**
+\brief Draws the bars in decibels down to a floor, or linearly.
+
+\param db --- level of an empty bar, such as -60, relative to the band's peak.  0 or above for linear bars.
+
+*/
+
+void BandSmoother::setDecibelFloor(float db)
+{
+    floorDb = (db < 0) ? db : 0;
+}
+
+/**
+\brief Drops every bar and peak to 0.
+
+*/
+
+void BandSmoother::reset()
+{
+    state.assign(state.size(), 0.0f);
+}
+
+/**
+\brief Moves the bars toward a new set of band magnitudes.
+
+\param mags --- getBandCount() band magnitudes, zeros while nothing plays so the bars sink.
+\param peaks --- getBandCount() band peaks the magnitudes are scaled by.
+\param elapsed --- seconds since the last update.
+
+*/
+
+void BandSmoother::update(const double* mags, const double* peaks, double elapsed)
+{
+    if (bandCount == 0)
+        return;
+
+    float dt = (elapsed > 0) ? (float) elapsed : 0;
+    EnvelopeStep step;
+    step.attackGain = (attackTime > 0) ? (float) (1 - exp(-dt / attackTime)) : 1.0f;
+    step.releaseGain = (releaseTime > 0) ? (float) (1 - exp(-dt / releaseTime)) : 1.0f;
+    step.elapsed = dt;
+    step.holdTime = holdTime;
+    step.peakDrop = peakFall * dt;
+
+    normaliseBands(mags, peaks, target(), bandCount);
+    if (floorDb < 0)
+        mapDecibels(target(), bandCount, floorDb);
+    smoothEnvelope(target(), level(), peak(), hold(), bandCount, step);
+}
+
+/**
+\brief Returns the number of bands.
+
+*/
+
+int BandSmoother::getBandCount() const
+{
+    return bandCount;
+}
+
+/**
+\brief Returns the smoothed bar heights, 0 to 1.
+
+*/
+
+const float* BandSmoother::getLevels() const
+{
+    return state.empty() ? NULL : &state[stride];
+}
+
+/**
+\brief Returns the held peak of each bar, 0 to 1.
+
+*/
+
+const float* BandSmoother::getPeaks() const
+{
+    return state.empty() ? NULL : &state[(std::size_t) stride * 2];
+}
+
+/**
+\brief The arrays of the state block.
+
+*/
+
+float* BandSmoother::target()
+{
+    return &state[0];
+}
+
+float* BandSmoother::level()
+{
+    return &state[stride];
+}
+
+float* BandSmoother::peak()
+{
+    return &state[(std::size_t) stride * 2];
+}
+
+float* BandSmoother::hold()
+{
+    return &state[(std::size_t) stride * 3];
+}
@@ -0,0 +1,64 @@
+#ifndef BANDSMOOTHER_H_INCLUDED
+#define BANDSMOOTHER_H_INCLUDED
+
+#include <vector>
+
+/**
+\file BandSmoother.h
+\brief Header file for BandSmoother.cpp
+
+*/
+
+/**
+\class BandSmoother
+
+\brief Turns band magnitudes into steady bar heights, with attack and release smoothing and held peaks.
+
+Each update scales the bands by their peaks, optionally maps them to decibels, and moves the
+smoothed levels toward them.  A rise is followed with the attack time constant and a fall with
+the slower release one, so bars jump up and sink back instead of flickering.  Each bar's peak
+is held for a while and then falls at a fixed rate.
+
+The gains come from the real time since the last update, so the bars move at the same speed
+whatever the frame rate.  The state is a structure of arrays, targets, levels, peaks and hold
+times each contiguous, so every step runs over all bands at once in the vector kernels of
+AnalysisKernels.  Nothing is allocated after setBandCount.
+
+It only needs band magnitudes and their peaks, so it serves a track, a timeline and live input alike.
+
+*/
+
+class BandSmoother
+{
+private:
+    int bandCount;              ///< Number of bands.
+    int stride;                 ///< Floats between the arrays, a whole number of cache lines.
+    std::vector<float> state;   ///< Targets, levels, peaks and hold times, stride floats each.
+
+    float attackTime;           ///< Seconds to follow about 63% of a rise.
+    float releaseTime;          ///< Seconds to follow about 63% of a fall.
+    float holdTime;             ///< Seconds a peak is held.
+    float peakFall;             ///< Bar heights per second a peak falls after its hold.
+    float floorDb;              ///< Level drawn as an empty bar in decibels, 0 for a linear scale.
+
+    float* target();
+    float* level();
+    float* peak();
+    float* hold();
+
+public:
+    BandSmoother();
+
+    void setBandCount(int count);
+    void setTimes(float attack, float release, float hold, float fall);
+    void setDecibelFloor(float db);
+    void reset();
+
+    void update(const double* mags, const double* peaks, double elapsed);
+
+    int getBandCount() const;
+    const float* getLevels() const;
+    const float* getPeaks() const;
+};
+
+#endif // BANDSMOOTHER_H_INCLUDED
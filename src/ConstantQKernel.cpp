@@ -0,0 +1,261 @@
+#include "ConstantQKernel.h"
+
+#include <cstring>
+#include <map>
+#include <math.h>
+#include <mutex>
+
+#include "ProgramDefines.h"
+#include "FftPlanCache.h"
+#include "WindowFunction.h"
+
+/**
+\file ConstantQKernel.cpp
+\brief Builds and applies the sparse spectral kernel of a constant-Q transform.
+
+*/
+
+// Kernel values below this fraction of their row's peak are dropped.
+static const double SparseThreshold = 0.005;
+
+/**
+\brief Ordering for the kernel cache.
+
+*/
+
+bool ConstantQKernel::CacheKey::operator<(const CacheKey& other) const
+{
+    if (sampleRate != other.sampleRate)
+        return sampleRate < other.sampleRate;
+    if (binsPerOctave != other.binsPerOctave)
+        return binsPerOctave < other.binsPerOctave;
+    if (bins != other.bins)
+        return bins < other.bins;
+    return minFreq < other.minFreq;
+}
+
+/**
+\brief Constructor, an empty kernel with no bins.
+
+*/
+
+ConstantQKernel::ConstantQKernel()
+{
+    fftSize = 0;
+    binCount = 0;
+    rowStart.assign(1, 0);
+}
+
+/**
+\brief Returns the shared kernel for a sample rate and layout, building it the first time.
+
+\param sampleRate --- sample rate in samples per second.
+\param layout --- a BandConstantQ layout.
+
+Safe to call from several threads, the kernel is only built once.
+
+*/
+
+const ConstantQKernel& ConstantQKernel::get(unsigned int sampleRate, const BandLayout& layout)
+{
+    static std::map<CacheKey, ConstantQKernel> kernels;
+    static std::mutex kernelMutex;
+
+    CacheKey key;
+    key.sampleRate = sampleRate;
+    key.binsPerOctave = layout.getBinsPerOctave();
+    key.bins = layout.getBandCount();
+    key.minFreq = layout.getCentre(0);
+
+    std::lock_guard<std::mutex> lock(kernelMutex);
+    std::map<CacheKey, ConstantQKernel>::iterator found = kernels.find(key);
+    if (found != kernels.end())
+        return found->second;
+
+    ConstantQKernel& kernel = kernels[key]; // map entries stay put, the reference outlives the lock
+    kernel.build(sampleRate, layout);
+    return kernel;
+}
+
+/**
+\brief Returns the frame length a layout needs at a sample rate, without building the kernel.
+
+The power of two that holds the lowest bin's kernel, at most ConstantQMaxFrame.
+
+*/
+
+int ConstantQKernel::fftSizeFor(unsigned int sampleRate, const BandLayout& layout)
+{
+    if (layout.getBinsPerOctave() <= 0 || sampleRate == 0)
+        return 0;
+
+    double q = 1 / (pow(2.0, 1.0 / layout.getBinsPerOctave()) - 1);
+    double longest = ceil(q * sampleRate / layout.getCentre(0));
+
+    int size = 1;
+    while (size < longest && size < ConstantQMaxFrame)
+        size *= 2;
+    return size;
+}
+
+/**
+\brief Works out the kernel of every bin and keeps its significant spectral values.
+
+Bin k's kernel is a Hann window of Q * sampleRate / f_k samples times exp(2 pi i f_k n / sampleRate),
+divided by its length so every bin reads a sine of the same amplitude the same.  Only the half
+spectrum of the real FFT input is ever multiplied, which is all a positive frequency kernel has.
+Bins at or above the Nyquist frequency get an empty row and always read 0.
+
+*/
+
+void ConstantQKernel::build(unsigned int sampleRate, const BandLayout& layout)
+{
+    fftSize = fftSizeFor(sampleRate, layout);
+    binCount = layout.getBandCount();
+    rowStart.assign(1, 0);
+    fftBin.clear();
+    weights.clear();
+    if (fftSize == 0)
+    {
+        rowStart.assign(binCount + 1, 0);
+        return;
+    }
+
+    int half = fftSize / 2 + 1;
+    double q = 1 / (pow(2.0, 1.0 / layout.getBinsPerOctave()) - 1);
+
+    double* in = fftw_alloc_real(fftSize);
+    fftw_complex* realPart = fftw_alloc_complex(half);
+    fftw_complex* imagPart = fftw_alloc_complex(half);
+    fftw_plan plan = FftPlanCache::instance().getR2C(fftSize, in, realPart, FFTW_ESTIMATE); // each size is built once
+    std::vector<double> window;
+    std::vector<double> magnitude(half);
+
+    for (int k = 0; k < binCount; k++)
+    {
+        double freq = layout.getCentre(k);
+        if (freq >= sampleRate / 2.0)
+        {
+            rowStart.push_back((int) fftBin.size());
+            continue;
+        }
+
+        int length = (int) ceil(q * sampleRate / freq);
+        length = (length < fftSize) ? length : fftSize;
+        int start = (fftSize - length) / 2; // centred, so every bin describes the same moment
+        buildWindow(WindowHann, length, window);
+
+        // The real and imaginary parts go through the real FFT one after the other.
+        memset(in, 0, fftSize * sizeof(double));
+        for (int n = 0; n < length; n++)
+            in[start + n] = window[n] / length * cos(2 * PI * freq * n / sampleRate);
+        fftw_execute_dft_r2c(plan, in, realPart);
+
+        memset(in, 0, fftSize * sizeof(double));
+        for (int n = 0; n < length; n++)
+            in[start + n] = window[n] / length * sin(2 * PI * freq * n / sampleRate);
+        fftw_execute_dft_r2c(plan, in, imagPart);
+
+        // Kernel spectrum K = R + iI, kept as conj(K) / fftSize so apply is a plain dot product.
+        double peak = 0;
+        for (int j = 0; j < half; j++)
+        {
+            double re = realPart[j][0] - imagPart[j][1];
+            double im = realPart[j][1] + imagPart[j][0];
+            magnitude[j] = re * re + im * im;
+            peak = (magnitude[j] > peak) ? magnitude[j] : peak;
+        }
+        for (int j = 0; j < half; j++)
+        {
+            if (magnitude[j] < peak * SparseThreshold * SparseThreshold)
+                continue;
+            fftBin.push_back(j);
+            weights.push_back((realPart[j][0] - imagPart[j][1]) / fftSize);
+            weights.push_back(-(realPart[j][1] + imagPart[j][0]) / fftSize);
+        }
+        rowStart.push_back((int) fftBin.size());
+    }
+
+    fftw_free(in);
+    fftw_free(realPart);
+    fftw_free(imagPart);
+}
+
+/**
+\brief Returns the frame length the kernel is for, 0 if the layout is not constant-Q.
+
+*/
+
+int ConstantQKernel::getFftSize() const
+{
+    return fftSize;
+}
+
+/**
+\brief Returns the number of constant-Q bins.
+
+*/
+
+int ConstantQKernel::getBinCount() const
+{
+    return binCount;
+}
+
+/**
+\brief Returns the number of kernel values kept, the multiply-adds per frame.
+
+*/
+
+int ConstantQKernel::getNonZeroCount() const
+{
+    return (int) fftBin.size();
+}
+
+/**
+\brief Measures every constant-Q bin of one frame.
+
+\param spectrum --- the getFftSize() / 2 + 1 bins of the frame's real FFT.
+\param out --- getBinCount() magnitudes.
+
+*/
+
+void ConstantQKernel::apply(const fftw_complex* spectrum, double* out) const
+{
+    const double* w = weights.empty() ? NULL : &weights[0];
+    for (int k = 0; k < binCount; k++)
+    {
+        double re = 0;
+        double im = 0;
+        for (int i = rowStart[k]; i < rowStart[k + 1]; i++)
+        {
+            const double* x = spectrum[fftBin[i]];
+            re += x[0] * w[2 * i] - x[1] * w[2 * i + 1];
+            im += x[0] * w[2 * i + 1] + x[1] * w[2 * i];
+        }
+        out[k] = sqrt(re * re + im * im);
+    }
+}
+
+/**
+\brief Measures every constant-Q bin of one frame from a single precision spectrum.
+
+The sums are kept in double, the kernel rows of the high bins are long.
+
+*/
+
+void ConstantQKernel::apply(const fftwf_complex* spectrum, double* out) const
+{
+    const double* w = weights.empty() ? NULL : &weights[0];
+    for (int k = 0; k < binCount; k++)
+    {
+        double re = 0;
+        double im = 0;
+        for (int i = rowStart[k]; i < rowStart[k + 1]; i++)
+        {
+            const float* x = spectrum[fftBin[i]];
+            re += x[0] * w[2 * i] - x[1] * w[2 * i + 1];
+            im += x[0] * w[2 * i + 1] + x[1] * w[2 * i];
+        }
+        out[k] = sqrt(re * re + im * im);
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef CONSTANTQKERNEL_H_INCLUDED
+#define CONSTANTQKERNEL_H_INCLUDED
+
+#include <fftw3.h>
+#include <vector>
+
+#include "BandLayout.h"
+
+/**
+\file ConstantQKernel.h
+\brief Header file for ConstantQKernel.cpp
+
+*/
+
+/**
+\class ConstantQKernel
+
+\brief The sparse spectral kernel of a constant-Q transform, Brown and Puckette's method.
+
+Each constant-Q bin is a windowed complex exponential at the bin's centre frequency, as long as
+the bin's Q needs, so low bins are long and high bins short.  The kernels are centred in one frame
+of getFftSize() samples and transformed once.  Their spectra are almost all near zero, so only the
+values above a small fraction of each row's peak are kept, as a compressed sparse row matrix.
+
+A frame is then measured with one FFT of getFftSize() samples and apply, a sparse matrix times the
+spectrum, instead of one long transform per bin.
+
+Kernels are built once per sample rate and layout and shared, get returns the cached one.
+
+*/
+
+class ConstantQKernel
+{
+private:
+    int fftSize;                    ///< Frame length the kernel is for, a power of two.
+    int binCount;                   ///< Constant-Q bins, the layout's band count.
+    std::vector<int> rowStart;      ///< binCount + 1 offsets into the arrays below.
+    std::vector<int> fftBin;        ///< FFT bin of each kept value.
+    std::vector<double> weights;    ///< Conjugated kernel value of each kept bin, real then imaginary.
+
+    /**
+    \brief What a cached kernel was built for.
+    */
+    struct CacheKey
+    {
+        unsigned int sampleRate;    ///< Samples per second.
+        int binsPerOctave;          ///< Bins per octave.
+        int bins;                   ///< Number of bins.
+        double minFreq;             ///< Centre of the first bin in Hz.
+
+        bool operator<(const CacheKey& other) const;
+    };
+
+    void build(unsigned int sampleRate, const BandLayout& layout);
+
+public:
+    ConstantQKernel();
+
+    static const ConstantQKernel& get(unsigned int sampleRate, const BandLayout& layout);
+    static int fftSizeFor(unsigned int sampleRate, const BandLayout& layout);
+
+    int getFftSize() const;
+    int getBinCount() const;
+    int getNonZeroCount() const;
+
+    void apply(const fftw_complex* spectrum, double* out) const;
+    void apply(const fftwf_complex* spectrum, double* out) const;
+};
+
+#endif // CONSTANTQKERNEL_H_INCLUDED
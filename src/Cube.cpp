@@ -1,4 +1,5 @@
 #include "Cube.h"
+#include "Tracer.h"
 
 /**
 \file Cube.cpp
@@ -131,6 +132,7 @@ void Cube::setColorCube(GLboolean b)
 
 void Cube::LoadDataToGraphicsCard()
 {
+    TRACE_SCOPE("Cube upload");
     GLuint vPosition = 0;
     GLuint vColor = 1;
 
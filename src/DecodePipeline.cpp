@@ -0,0 +1,501 @@
+#include "DecodePipeline.h"
+
+#include <string.h>
+
+#include "Tracer.h"
+
+/**
+\file DecodePipeline.cpp
+\brief Read-ahead decoding of a sound file into a pool of reusable blocks.
+
+*/
+
+/**
+\brief Constructor, nothing is open.
+
+*/
+
+DecodePipeline::DecodePipeline()
+{
+    sampleCount = 0;
+    channels = 0;
+    sampleRate = 0;
+    blockSamples = 0;
+    blockTotal = 0;
+    playbackSlots = 0;
+    playbackLimit = 0;
+    filePosition = 0;
+    decodeIndex = 0;
+    readIndex = 0;
+    analysisIndex = 0;
+    analysisSlot = NULL;
+    analysisOn = false;
+    generation = 0;
+    quit = false;
+    hits = 0;
+    misses = 0;
+}
+
+/**
+\brief Destructor, stops the decode thread.
+
+*/
+
+DecodePipeline::~DecodePipeline()
+{
+    close();
+}
+
+/**
+\brief Opens a sound file in any format SFML reads and starts decoding it from the start.
+
+\param path --- the file to open.
+\param blockFrames --- frames per block.
+\param blockCount --- blocks in the pool, at least 4, which bounds the read-ahead to two less.
+
+\return False if the file could not be opened or has no samples.
+
+*/
+
+bool DecodePipeline::open(const std::string& path, std::size_t blockFrames, std::size_t blockCount)
+{
+    close();
+    if (!file.openFromFile(path) || file.getChannelCount() == 0 || file.getSampleCount() == 0)
+        return false;
+
+    blockFrames = (blockFrames > 0) ? blockFrames : 1;
+    blockCount = (blockCount > 4) ? blockCount : 4;
+
+    sampleCount = file.getSampleCount();
+    channels = file.getChannelCount();
+    sampleRate = file.getSampleRate();
+    blockSamples = blockFrames * channels;
+    blockTotal = (sampleCount + blockSamples - 1) / blockSamples;
+
+    // Every allocation the pipeline makes, the decoder and readers only move pointers between the lists.
+    pool.assign(blockCount * blockSamples, 0);
+    slots.resize(blockCount);
+    freeSlots.clear();
+    freeSlots.reserve(blockCount);
+    readySlots.clear();
+    readySlots.reserve(blockCount);
+    for (std::size_t i = 0; i < blockCount; i++)
+    {
+        slots[i].storage = &pool[i * blockSamples];
+        slots[i].block.samples = slots[i].storage;
+        slots[i].block.first = 0;
+        slots[i].block.count = 0;
+        slots[i].block.index = 0;
+        slots[i].valid = false;
+        slots[i].playback = false;
+        slots[i].analysis = false;
+        freeSlots.push_back(&slots[i]);
+    }
+    playbackSlots = 0;
+    playbackLimit = blockCount - 2; // one for the analysis to hold and one to decode behind the reader
+    filePosition = 0;
+
+    decodeIndex = 0;
+    readIndex = 0;
+    analysisIndex = 0;
+    analysisSlot = NULL;
+    analysisOn = false;
+    generation = 0;
+    quit = false;
+    hits = 0;
+    misses = 0;
+    thread = std::thread(&DecodePipeline::decodeLoop, this);
+    return true;
+}
+
+/**
+\brief Stops the decode thread and forgets the file.
+
+Blocks still held by the reader or the analysis are invalid afterwards.  The decoder keeps the file open until
+it is opened again or destroyed, sf::InputSoundFile has no close of its own.
+
+*/
+
+void DecodePipeline::close()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    blockReady.notify_all();
+    slotFreed.notify_all();
+    if (thread.joinable())
+        thread.join();
+
+    sampleCount = 0;
+    channels = 0;
+    sampleRate = 0;
+    blockTotal = 0;
+    analysisSlot = NULL;
+    analysisOn = false;
+}
+
+/**
+\brief Returns true if a file is open.
+
+*/
+
+bool DecodePipeline::isOpen() const
+{
+    return sampleCount > 0;
+}
+
+/**
+\brief Returns the number of samples over all channels.
+
+*/
+
+std::uint64_t DecodePipeline::getSampleCount() const
+{
+    return sampleCount;
+}
+
+/**
+\brief Returns the number of interleaved channels.
+
+*/
+
+unsigned int DecodePipeline::getChannelCount() const
+{
+    return channels;
+}
+
+/**
+\brief Returns the frames per second.
+
+*/
+
+unsigned int DecodePipeline::getSampleRate() const
+{
+    return sampleRate;
+}
+
+/**
+\brief Returns how many blocks were served from the pool and how many were decoded.
+
+*/
+
+void DecodePipeline::getCacheStats(std::uint64_t* hitCount, std::uint64_t* missCount)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    *hitCount = hits;
+    *missCount = misses;
+}
+
+/**
+\brief The decode thread, queues the blocks from decodeIndex on and decodes the ones the analysis lacks.
+
+The reader comes first.  A block still in the pool is queued again without decoding, otherwise
+the least recently freed slot is decoded into with the mutex released, so neither cursor is held
+up by the decoder.  When the reader has all it may and the analysis is behind it, the next block
+the analysis takes is decoded for it unless the pool has it already.
+
+*/
+
+void DecodePipeline::decodeLoop()
+{
+    TRACE_THREAD_NAME("decode");
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;)
+    {
+        bool forPlayback = false;
+        bool forAnalysis = false;
+        while (!quit && !forPlayback && !forAnalysis)
+        {
+            forPlayback = decodeIndex < blockTotal && playbackSlots < playbackLimit &&
+                          (!freeSlots.empty() || find(decodeIndex, true) != NULL);
+            forAnalysis = !forPlayback && analysisOn && analysisIndex < readIndex && analysisIndex < blockTotal &&
+                          !freeSlots.empty() && find(analysisIndex, false) == NULL;
+            if (!forPlayback && !forAnalysis)
+                slotFreed.wait(lock);
+        }
+        if (quit)
+            return;
+
+        std::uint64_t index = forPlayback ? decodeIndex : analysisIndex;
+        unsigned int decodeGeneration = generation;
+
+        Slot* slot = forPlayback ? find(index, true) : NULL;
+        if (slot != NULL)
+        {
+            takeFree(slot); // decoded for the analysis or freed, either way not the reader's
+            hits++;
+        }
+        else
+        {
+            slot = freeSlots.front();
+            freeSlots.erase(freeSlots.begin());
+            slot->valid = false;
+            slot->analysis = forAnalysis;
+            misses++;
+
+            lock.unlock();
+            decode(*slot, index);
+            lock.lock();
+            slot->valid = true;
+        }
+
+        if (forAnalysis)
+        {
+            if (!analysisOn)
+            {
+                slot->analysis = false; // closed meanwhile
+                settle(slot);
+            }
+            blockReady.notify_all();
+            continue;
+        }
+        if (decodeGeneration != generation)
+        {
+            settle(slot); // a seek came in meanwhile, the block stays in the pool in case it is wanted
+            continue;
+        }
+        slot->playback = true;
+        playbackSlots++;
+        readySlots.push_back(slot);
+        decodeIndex = index + 1;
+        blockReady.notify_all();
+    }
+}
+
+/**
+\brief Decodes one block into a slot, on the decode thread with the mutex released.
+
+\param slot --- the slot, held by the decoder.
+\param index --- the block.
+
+A read short of the file's stated length is filled with silence.
+
+*/
+
+void DecodePipeline::decode(Slot& slot, std::uint64_t index)
+{
+    TRACE_SCOPE("decode block");
+    std::uint64_t start = index * blockSamples;
+    std::size_t wanted = (sampleCount - start < blockSamples) ? (std::size_t) (sampleCount - start) : blockSamples;
+
+    if (filePosition != start)
+        file.seek(start);
+    std::uint64_t got = file.read(slot.storage, wanted);
+    if (got < wanted)
+        memset(slot.storage + got, 0, (wanted - (std::size_t) got) * sizeof(sf::Int16));
+    filePosition = start + got;
+
+    slot.block.samples = slot.storage;
+    slot.block.first = start;
+    slot.block.count = wanted;
+    slot.block.index = index;
+}
+
+/**
+\brief Finds a slot holding a block, call with the mutex held.
+
+\param index --- the block.
+\param shared --- true to skip the slots the reader has, to queue the block for it again.
+
+\return The slot, or NULL if the block is not in the pool.
+
+*/
+
+DecodePipeline::Slot* DecodePipeline::find(std::uint64_t index, bool shared)
+{
+    for (std::size_t i = 0; i < slots.size(); i++)
+    {
+        if (slots[i].valid && slots[i].block.index == index && !(shared && slots[i].playback))
+            return &slots[i];
+    }
+    return NULL;
+}
+
+/**
+\brief Takes a slot off the free list if it is on it, call with the mutex held.
+
+*/
+
+void DecodePipeline::takeFree(Slot* slot)
+{
+    for (std::size_t i = 0; i < freeSlots.size(); i++)
+    {
+        if (freeSlots[i] == slot)
+        {
+            freeSlots.erase(freeSlots.begin() + i);
+            return;
+        }
+    }
+}
+
+/**
+\brief Puts a slot neither cursor wants on the free list, call with the mutex held.
+
+*/
+
+void DecodePipeline::settle(Slot* slot)
+{
+    if (slot->playback || slot->analysis)
+        return;
+    freeSlots.push_back(slot);
+    slotFreed.notify_one();
+}
+
+/**
+\brief Takes the next block, waiting for the decoder if it is not ready yet.
+
+\return The block, valid until it is released, or NULL at the end of the file or once closed.
+
+*/
+
+const PcmBlock* DecodePipeline::acquire()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!quit && readIndex < blockTotal && readySlots.empty())
+        blockReady.wait(lock);
+    if (quit || readySlots.empty())
+        return NULL;
+
+    Slot* slot = readySlots.front();
+    readySlots.erase(readySlots.begin());
+    readIndex++;
+    slotFreed.notify_one(); // the analysis may be behind the reader now
+    return &slot->block;
+}
+
+/**
+\brief Gives a block back to the pool, its samples stay there to be served again.
+
+*/
+
+void DecodePipeline::release(const PcmBlock* block)
+{
+    if (block == NULL)
+        return;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for (std::size_t i = 0; i < slots.size(); i++)
+    {
+        if (&slots[i].block == block)
+        {
+            slots[i].playback = false;
+            playbackSlots--;
+            settle(&slots[i]);
+        }
+    }
+}
+
+/**
+\brief Moves the reader to another place in the file.
+
+\param sample --- a sample over all channels, the next block acquired holds it.
+
+The blocks that were queued go back to the pool, so seeking to them again needs no decoding.
+The analysis carries on from where it was.
+
+*/
+
+void DecodePipeline::seek(std::uint64_t sample)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::uint64_t index = (blockSamples > 0) ? sample / blockSamples : 0;
+    generation++;
+    for (std::size_t i = 0; i < readySlots.size(); i++)
+    {
+        readySlots[i]->playback = false;
+        playbackSlots--;
+        settle(readySlots[i]);
+    }
+    readySlots.clear();
+    decodeIndex = (index < blockTotal) ? index : blockTotal;
+    readIndex = decodeIndex;
+    slotFreed.notify_one();
+}
+
+/**
+\brief Opens the analysis cursor at the start of the file.
+
+*/
+
+void DecodePipeline::openAnalysis()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    analysisIndex = 0;
+    analysisOn = true;
+    slotFreed.notify_one();
+}
+
+/**
+\brief Closes the analysis cursor, an acquireAnalysis waiting on another thread returns NULL.
+
+The block the analysis holds stays valid until releaseAnalysis, those decoded for it go back to
+the pool.
+
+*/
+
+void DecodePipeline::closeAnalysis()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        analysisOn = false;
+        for (std::size_t i = 0; i < slots.size(); i++)
+        {
+            if (slots[i].analysis && slots[i].valid && &slots[i] != analysisSlot)
+            {
+                slots[i].analysis = false;
+                settle(&slots[i]);
+            }
+        }
+    }
+    blockReady.notify_all();
+}
+
+/**
+\brief Takes the analysis cursor's next block, waiting for the decoder if it is not ready yet.
+
+Blocks come in order from the start of the file, whatever the reader does.  Release one before
+taking the next.
+
+\return The block, valid until releaseAnalysis, or NULL at the end of the file or once closed.
+
+*/
+
+const PcmBlock* DecodePipeline::acquireAnalysis()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    Slot* slot = NULL;
+    while (!quit && analysisOn && analysisIndex < blockTotal && (slot = find(analysisIndex, false)) == NULL)
+        blockReady.wait(lock);
+    if (quit || !analysisOn || slot == NULL)
+        return NULL;
+
+    takeFree(slot);
+    slot->analysis = true;
+    analysisSlot = slot;
+    analysisIndex++;
+    slotFreed.notify_one(); // the next one can be decoded while this one is analysed
+    return &slot->block;
+}
+
+/**
+\brief Gives the analysis cursor's block back, it stays in the pool for the reader.
+
+*/
+
+void DecodePipeline::releaseAnalysis(const PcmBlock* block)
+{
+    if (block == NULL)
+        return;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for (std::size_t i = 0; i < slots.size(); i++)
+    {
+        if (&slots[i].block == block)
+        {
+            slots[i].analysis = false;
+            analysisSlot = NULL;
+            settle(&slots[i]);
+        }
+    }
+}
@@ -0,0 +1,134 @@
+#ifndef DECODEPIPELINE_H_INCLUDED
+#define DECODEPIPELINE_H_INCLUDED
+
+#include <SFML/Audio.hpp>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+\file DecodePipeline.h
+\brief Header file for DecodePipeline.cpp
+
+*/
+
+/**
+\brief One block of decoded samples, owned by a DecodePipeline.
+
+Block i holds the samples from i * blockFrames frames on.
+
+*/
+
+struct PcmBlock
+{
+    const sf::Int16* samples;   ///< First sample.
+    std::uint64_t first;        ///< Sample of the file samples[0] is, over all channels.
+    std::size_t count;          ///< Samples in the block.
+    std::uint64_t index;        ///< Block number on the pipeline's grid.
+};
+
+/**
+\class DecodePipeline
+
+\brief Decodes a sound file ahead of its reader into a fixed pool of blocks.
+
+A read-ahead thread decodes the file with sf::InputSoundFile straight into free blocks of the
+pool and queues them in order.  The reader takes each block with acquire, reads the samples where
+they lie and gives the block back with release.  The pool and the queue are allocated by open,
+decoding and reading allocate nothing after that.
+
+Freed blocks keep their samples and are reused least recently freed first, so the pool doubles
+as a cache: a seek to somewhere still in the pool is served without decoding again.
+
+A second cursor, opened with openAnalysis, takes every block of the file in order with
+acquireAnalysis, sharing the blocks decoded for the reader, so the analysis of a track never
+decodes it again.  It runs ahead of the reader only as far as the read-ahead, and decodes
+blocks of its own only while it is behind the reader, from the start of the track or after a
+seek forward.  Two of the blocks are kept back from the read-ahead for it.
+
+One thread reads, any thread may seek while it holds no block, one other thread may take the
+analysis cursor, the decoder has its own thread.
+
+*/
+
+class DecodePipeline
+{
+private:
+    /**
+    \brief A block and where it is.
+    */
+    struct Slot
+    {
+        PcmBlock block;             ///< What the reader sees.
+        sf::Int16* storage;         ///< Start of the slot's samples in the pool.
+        bool valid;                 ///< The samples are block.index's, so the slot can be served again.
+        bool playback;              ///< Queued for or held by the reader.
+        bool analysis;              ///< Held by the analysis, or decoded for it and not taken yet.
+    };
+
+    sf::InputSoundFile file;        ///< The decoder, only touched by the decode thread once open returns.
+    std::uint64_t sampleCount;      ///< Samples over all channels.
+    unsigned int channels;          ///< Samples per frame.
+    unsigned int sampleRate;        ///< Frames per second.
+    std::size_t blockSamples;       ///< Samples per block, a whole number of frames.
+    std::uint64_t blockTotal;       ///< Blocks in the file.
+
+    std::vector<sf::Int16> pool;    ///< Every slot's samples.
+    std::vector<Slot> slots;        ///< The blocks.
+    std::vector<Slot*> freeSlots;   ///< Slots nobody holds, least recently freed first.
+    std::vector<Slot*> readySlots;  ///< Decoded blocks waiting for the reader, in order.
+    std::size_t playbackSlots;      ///< Slots queued for or held by the reader.
+    std::size_t playbackLimit;      ///< Most slots the reader may have, the rest are the analysis's.
+    std::uint64_t filePosition;     ///< Sample the decoder reads next.
+
+    std::uint64_t decodeIndex;      ///< Next block to decode.
+    std::uint64_t readIndex;        ///< Next block the reader takes.
+    std::uint64_t analysisIndex;    ///< Next block the analysis takes.
+    Slot* analysisSlot;             ///< The block the analysis holds, or NULL.
+    bool analysisOn;                ///< The analysis cursor is open.
+    unsigned int generation;        ///< Counts seeks, a block decoded before the last seek is not queued.
+    bool quit;                      ///< Asks the decode thread to finish.
+    std::uint64_t hits;             ///< Blocks served from the pool without decoding.
+    std::uint64_t misses;           ///< Blocks decoded.
+
+    std::mutex mutex;                       ///< Guards everything from slots on.
+    std::condition_variable blockReady;     ///< Signalled when a block is queued or decoded, and on close.
+    std::condition_variable slotFreed;      ///< Signalled when the decoder has work, and on close.
+    std::thread thread;                     ///< The decode thread.
+
+    void decodeLoop();
+    void decode(Slot& slot, std::uint64_t index);
+    Slot* find(std::uint64_t index, bool shared);
+    void takeFree(Slot* slot);
+    void settle(Slot* slot);
+
+    DecodePipeline(const DecodePipeline&);
+    DecodePipeline& operator=(const DecodePipeline&);
+
+public:
+    DecodePipeline();
+    ~DecodePipeline();
+
+    bool open(const std::string& path, std::size_t blockFrames, std::size_t blockCount);
+    void close();
+
+    bool isOpen() const;
+    std::uint64_t getSampleCount() const;
+    unsigned int getChannelCount() const;
+    unsigned int getSampleRate() const;
+    void getCacheStats(std::uint64_t* hitCount, std::uint64_t* missCount);
+
+    const PcmBlock* acquire();
+    void release(const PcmBlock* block);
+    void seek(std::uint64_t sample);
+
+    void openAnalysis();
+    void closeAnalysis();
+    const PcmBlock* acquireAnalysis();
+    void releaseAnalysis(const PcmBlock* block);
+};
+
+#endif // DECODEPIPELINE_H_INCLUDED
@@ -0,0 +1,289 @@
+#include "FftPlanCache.h"
+
+/**
+\file FftPlanCache.cpp
+\brief Caches FFTW plans and persists FFTW wisdom between runs.
+
+*/
+
+/**
+\brief Ordering for the plan map.
+
+*/
+
+bool FftPlanCache::PlanKey::operator<(const PlanKey& other) const
+{
+    if (size != other.size)
+        return size < other.size;
+    if (howmany != other.howmany)
+        return howmany < other.howmany;
+    if (direction != other.direction)
+        return direction < other.direction;
+    if (alignment != other.alignment)
+        return alignment < other.alignment;
+    return flags < other.flags;
+}
+
+/**
+\brief Constructor
+
+Sets the default wisdom path and imports any wisdom saved by an earlier run.
+
+*/
+
+FftPlanCache::FftPlanCache()
+{
+    wisdomPath = fftWisdomPath;
+    floatWisdomPath = fftwfWisdomPath;
+    wisdomDirty = false;
+    floatWisdomDirty = false;
+    loadWisdom();
+}
+
+/**
+\brief Destructor
+
+Saves any new wisdom and destroys every cached plan.
+
+*/
+
+FftPlanCache::~FftPlanCache()
+{
+    saveWisdom();
+    clear();
+}
+
+/**
+\brief Returns the process wide plan cache.
+
+*/
+
+FftPlanCache& FftPlanCache::instance()
+{
+    static FftPlanCache cache;
+    return cache;
+}
+
+/**
+\brief Builds the map key for a forward real to complex plan.
+
+*/
+
+FftPlanCache::PlanKey FftPlanCache::makeKey(int size, int howmany, int inAlign, int outAlign, unsigned flags)
+{
+    PlanKey key;
+    key.size = size;
+    key.howmany = howmany;
+    key.direction = FFTW_FORWARD;
+    key.alignment = (inAlign << 8) | outAlign;
+    key.flags = flags;
+    return key;
+}
+
+/**
+\brief Returns a real to complex plan for the given size, building it on first use.
+
+\param size --- Transform length.
+\param in --- Input buffer the plan will be executed on.
+\param out --- Output buffer the plan will be executed on, at least size/2 + 1 entries.
+\param flags --- FFTW planner flags, FFTW_MEASURE by default.
+
+The plan is made on scratch buffers with the same alignment as in and out, so measuring
+never touches the caller's data.  Execute it with fftw_execute_dft_r2c on any buffers with
+the same alignment.  Safe to call from several threads.
+
+*/
+
+fftw_plan FftPlanCache::getR2C(int size, double* in, fftw_complex* out, unsigned flags)
+{
+    return getManyR2C(size, 1, in, out, flags);
+}
+
+/**
+\brief Returns a plan that does howmany real to complex transforms in one execution.
+
+\param size --- Transform length.
+\param howmany --- Number of transforms.
+\param in --- Input buffer of howmany consecutive frames of size samples.
+\param out --- Output matrix, howmany rows of size/2 + 1 entries.
+\param flags --- FFTW planner flags, FFTW_MEASURE by default.
+
+\return The plan, or NULL if FFTW could not make one with these flags.  A NULL plan is not cached.
+
+Lets FFTW use its multi-transform codelets instead of paying the call overhead per frame.
+Buffers follow the same alignment rule as getR2C.
+
+*/
+
+fftw_plan FftPlanCache::getManyR2C(int size, int howmany, double* in, fftw_complex* out, unsigned flags)
+{
+    int inAlign = fftw_alignment_of(in);
+    int outAlign = fftw_alignment_of((double*) out);
+
+    PlanKey key = makeKey(size, howmany, inAlign, outAlign, flags);
+
+    std::lock_guard<std::mutex> lock(planMutex);
+
+    std::map<PlanKey, fftw_plan>::iterator it = plans.find(key);
+    if (it != plans.end())
+        return it->second;
+
+    // fftw_malloc memory is aligned for SIMD, so offsetting it reproduces the caller's alignment.
+    char* inBase = (char*) fftw_malloc((size_t) howmany * size * sizeof(double) + 64);
+    char* outBase = (char*) fftw_malloc((size_t) howmany * (size / 2 + 1) * sizeof(fftw_complex) + 64);
+    double* scratchIn = (double*) (inBase + inAlign);
+    fftw_complex* scratchOut = (fftw_complex*) (outBase + outAlign);
+
+    fftw_plan plan;
+    if (howmany == 1)
+        plan = fftw_plan_dft_r2c_1d(size, scratchIn, scratchOut, flags);
+    else
+        plan = fftw_plan_many_dft_r2c(1, &size, howmany, scratchIn, NULL, 1, size,
+                                      scratchOut, NULL, 1, size / 2 + 1, flags);
+
+    fftw_free(inBase);
+    fftw_free(outBase);
+
+    if (plan == NULL)
+        return NULL; // FFTW_WISDOM_ONLY without wisdom, or the planner failed, the caller may ask again with other flags
+
+    plans[key] = plan;
+    if (!(flags & FFTW_ESTIMATE))
+        wisdomDirty = true; // estimated plans add no wisdom
+    return plan;
+}
+
+/**
+\brief Single precision version of getR2C.
+
+*/
+
+fftwf_plan FftPlanCache::getR2C(int size, float* in, fftwf_complex* out, unsigned flags)
+{
+    return getManyR2C(size, 1, in, out, flags);
+}
+
+/**
+\brief Single precision version of getManyR2C.
+
+*/
+
+fftwf_plan FftPlanCache::getManyR2C(int size, int howmany, float* in, fftwf_complex* out, unsigned flags)
+{
+    int inAlign = fftwf_alignment_of(in);
+    int outAlign = fftwf_alignment_of((float*) out);
+
+    PlanKey key = makeKey(size, howmany, inAlign, outAlign, flags);
+
+    std::lock_guard<std::mutex> lock(planMutex);
+
+    std::map<PlanKey, fftwf_plan>::iterator it = floatPlans.find(key);
+    if (it != floatPlans.end())
+        return it->second;
+
+    char* inBase = (char*) fftwf_malloc((size_t) howmany * size * sizeof(float) + 64);
+    char* outBase = (char*) fftwf_malloc((size_t) howmany * (size / 2 + 1) * sizeof(fftwf_complex) + 64);
+    float* scratchIn = (float*) (inBase + inAlign);
+    fftwf_complex* scratchOut = (fftwf_complex*) (outBase + outAlign);
+
+    fftwf_plan plan;
+    if (howmany == 1)
+        plan = fftwf_plan_dft_r2c_1d(size, scratchIn, scratchOut, flags);
+    else
+        plan = fftwf_plan_many_dft_r2c(1, &size, howmany, scratchIn, NULL, 1, size,
+                                       scratchOut, NULL, 1, size / 2 + 1, flags);
+
+    fftwf_free(inBase);
+    fftwf_free(outBase);
+
+    if (plan == NULL)
+        return NULL; // FFTW_WISDOM_ONLY without wisdom, or the planner failed, the caller may ask again with other flags
+
+    floatPlans[key] = plan;
+    if (!(flags & FFTW_ESTIMATE))
+        floatWisdomDirty = true; // estimated plans add no wisdom
+    return plan;
+}
+
+/**
+\brief Sets the wisdom files used by loadWisdom and saveWisdom.
+
+\param path --- Path to the double precision wisdom file.
+\param floatPath --- Path to the single precision wisdom file.
+
+*/
+
+void FftPlanCache::setWisdomPath(std::string path, std::string floatPath)
+{
+    std::lock_guard<std::mutex> lock(planMutex);
+    wisdomPath = path;
+    floatWisdomPath = floatPath;
+}
+
+/**
+\brief Imports the wisdom files.
+
+\return True if the double precision file was read, false if it is missing or unreadable.
+
+*/
+
+bool FftPlanCache::loadWisdom()
+{
+    std::lock_guard<std::mutex> lock(planMutex);
+    fftwf_import_wisdom_from_filename(floatWisdomPath.c_str());
+    return fftw_import_wisdom_from_filename(wisdomPath.c_str()) != 0;
+}
+
+/**
+\brief Exports the accumulated wisdom if any new plans were made.
+
+\return True if the wisdom is on disk.
+
+*/
+
+bool FftPlanCache::saveWisdom()
+{
+    std::lock_guard<std::mutex> lock(planMutex);
+    bool saved = true;
+
+    if (wisdomDirty)
+    {
+        if (fftw_export_wisdom_to_filename(wisdomPath.c_str()))
+            wisdomDirty = false;
+        else
+        {
+            std::cerr << "Could not save FFTW wisdom to " << wisdomPath << std::endl;
+            saved = false;
+        }
+    }
+
+    if (floatWisdomDirty)
+    {
+        if (fftwf_export_wisdom_to_filename(floatWisdomPath.c_str()))
+            floatWisdomDirty = false;
+        else
+        {
+            std::cerr << "Could not save FFTW wisdom to " << floatWisdomPath << std::endl;
+            saved = false;
+        }
+    }
+
+    return saved;
+}
+
+/**
+\brief Destroys every cached plan.
+
+*/
+
+void FftPlanCache::clear()
+{
+    std::lock_guard<std::mutex> lock(planMutex);
+    for (std::map<PlanKey, fftw_plan>::iterator it = plans.begin(); it != plans.end(); ++it)
+        fftw_destroy_plan(it->second);
+    plans.clear();
+
+    for (std::map<PlanKey, fftwf_plan>::iterator it = floatPlans.begin(); it != floatPlans.end(); ++it)
+        fftwf_destroy_plan(it->second);
+    floatPlans.clear();
+}
@@ -0,0 +1,74 @@
+#ifndef FFTPLANCACHE_H_INCLUDED
+#define FFTPLANCACHE_H_INCLUDED
+
+#include <fftw3.h>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "ProgramDefines.h"
+
+/**
+\file FftPlanCache.h
+\brief Header file for FftPlanCache.cpp
+
+*/
+
+/**
+\class FftPlanCache
+
+\brief Builds each FFTW plan once and hands it back on every later request.
+
+Plans are keyed by transform size, batch count, direction, buffer alignment and planner flags.  A cached
+plan is run on new buffers with fftw_execute_dft_r2c, which FFTW allows as long as the
+buffers have the same alignment as the ones the plan was made for.  The cache also loads
+and saves the FFTW wisdom file so measured plans are cheap after the first launch.
+
+*/
+
+class FftPlanCache
+{
+private:
+    struct PlanKey
+    {
+        int size;           ///< Transform length.
+        int howmany;        ///< Number of transforms done by one execution.
+        int direction;      ///< FFTW_FORWARD or FFTW_BACKWARD.
+        int alignment;      ///< Combined fftw_alignment_of for the input and output buffers.
+        unsigned flags;     ///< Planner flags.
+
+        bool operator<(const PlanKey& other) const;
+    };
+
+    std::map<PlanKey, fftw_plan> plans;         ///< Plans built so far.
+    std::map<PlanKey, fftwf_plan> floatPlans;   ///< Single precision plans built so far.
+    std::mutex planMutex;                       ///< The FFTW planner is not thread safe.
+    std::string wisdomPath;                     ///< Wisdom file location.
+    std::string floatWisdomPath;                ///< Single precision wisdom file location.
+    bool wisdomDirty;                           ///< True if new plans were made since the last save.
+    bool floatWisdomDirty;                      ///< True if new single precision plans were made since the last save.
+
+    static PlanKey makeKey(int size, int howmany, int inAlign, int outAlign, unsigned flags);
+
+    FftPlanCache();
+    FftPlanCache(const FftPlanCache&);
+    FftPlanCache& operator=(const FftPlanCache&);
+
+public:
+    ~FftPlanCache();
+
+    static FftPlanCache& instance();
+
+    fftw_plan getR2C(int size, double* in, fftw_complex* out, unsigned flags = FFTW_MEASURE);
+    fftw_plan getManyR2C(int size, int howmany, double* in, fftw_complex* out, unsigned flags = FFTW_MEASURE);
+    fftwf_plan getR2C(int size, float* in, fftwf_complex* out, unsigned flags = FFTW_MEASURE);
+    fftwf_plan getManyR2C(int size, int howmany, float* in, fftwf_complex* out, unsigned flags = FFTW_MEASURE);
+
+    void setWisdomPath(std::string path, std::string floatPath);
+    bool loadWisdom();
+    bool saveWisdom();
+    void clear();
+};
+
+#endif // FFTPLANCACHE_H_INCLUDED
@@ -0,0 +1,290 @@
+#include "FileUtil.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <direct.h>
+#include <io.h>
+#include <process.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/**
+\file FileUtil.cpp
+\brief Small file system helpers shared by the cache and timeline writers.
+
+*/
+
+static std::atomic<unsigned> temporaryNames(0); ///< Counts the names made unique per process.
+
+/**
+\brief Returns a suffix unique to this process and call.
+
+*/
+
+static std::string uniqueSuffix()
+{
+    char suffix[48];
+#ifdef _WIN32
+    snprintf(suffix, sizeof(suffix), ".tmp%d.%u", _getpid(), temporaryNames.fetch_add(1));
+#else
+    snprintf(suffix, sizeof(suffix), ".tmp%d.%u", (int) getpid(), temporaryNames.fetch_add(1));
+#endif
+    return suffix;
+}
+
+/**
+\brief Creates a folder.
+
+\param path --- the folder to create.
+
+\return False if it could not be created, including when it is already there.
+
+*/
+
+bool makeDirectory(const std::string& path)
+{
+#ifdef _WIN32
+    return _mkdir(path.c_str()) == 0;
+#else
+    return mkdir(path.c_str(), 0755) == 0;
+#endif
+}
+
+/**
+\brief Returns true if the path is a folder.
+
+*/
+
+bool isDirectory(const std::string& path)
+{
+#ifdef _WIN32
+    DWORD attributes = GetFileAttributesA(path.c_str());
+    return attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+#else
+    struct stat info;
+    return stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+#endif
+}
+
+/**
+\brief Lists the names in a folder, without "." and "..".
+
+\param path --- the folder.
+\param names --- output, the names in no particular order, not full paths.
+
+\return False if the folder could not be read.
+
+*/
+
+bool listDirectory(const std::string& path, std::vector<std::string>& names)
+{
+    names.clear();
+#ifdef _WIN32
+    WIN32_FIND_DATAA entry;
+    HANDLE find = FindFirstFileA((path + "\\*").c_str(), &entry);
+    if (find == INVALID_HANDLE_VALUE)
+        return false;
+    do
+    {
+        std::string name = entry.cFileName;
+        if (name != "." && name != "..")
+            names.push_back(name);
+    } while (FindNextFileA(find, &entry));
+    FindClose(find);
+#else
+    DIR* dir = opendir(path.c_str());
+    if (dir == NULL)
+        return false;
+    for (struct dirent* entry = readdir(dir); entry != NULL; entry = readdir(dir))
+    {
+        std::string name = entry->d_name;
+        if (name != "." && name != "..")
+            names.push_back(name);
+    }
+    closedir(dir);
+#endif
+    return true;
+}
+
+/**
+\brief Reads the size and last modification time of a file.
+
+\param path --- the file.
+\param size --- output, its size in bytes.
+\param modified --- output, when it was last written, in the system's own units.
+
+Together they tell an edited or replaced file from the one an earlier run saw, without reading it.
+
+\return False if the file could not be found.
+
+*/
+
+bool getFileStamp(const std::string& path, std::uint64_t* size, std::int64_t* modified)
+{
+#ifdef _WIN32
+    WIN32_FILE_ATTRIBUTE_DATA info;
+    if (!GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &info))
+        return false;
+    *size = ((std::uint64_t) info.nFileSizeHigh << 32) | info.nFileSizeLow;
+    *modified = (std::int64_t) (((std::uint64_t) info.ftLastWriteTime.dwHighDateTime << 32) | info.ftLastWriteTime.dwLowDateTime);
+#else
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0)
+        return false;
+    *size = (std::uint64_t) info.st_size;
+    *modified = (std::int64_t) info.st_mtime;
+#endif
+    return true;
+}
+
+/**
+\brief Returns a path in the system's temporary folder for a file only this run uses.
+
+\param name --- the name of the file, made unique per process and call.
+
+The caller removes the file once it is done with it.
+
+*/
+
+std::string scratchPath(const std::string& name)
+{
+#ifdef _WIN32
+    char folder[MAX_PATH + 1];
+    DWORD length = GetTempPathA(sizeof(folder), folder);
+    std::string dir = (length > 0 && length < sizeof(folder)) ? std::string(folder, length) : std::string(".\\");
+#else
+    const char* env = getenv("TMPDIR");
+    std::string dir = (env != NULL && env[0] != '\0') ? env : "/tmp";
+    if (dir[dir.size() - 1] != '/')
+        dir += '/';
+#endif
+    return dir + name + uniqueSuffix();
+}
+
+/**
+\brief Returns a name next to path for a file to be renamed over it once it is written.
+
+The name is unique per process and call, threads writing the same path never share one.
+
+*/
+
+std::string temporaryPath(const std::string& path)
+{
+    return path + uniqueSuffix();
+}
+
+/**
+\brief Renames a file over another, replacing it in one step.
+
+\param from --- the file to rename.
+\param to --- its new name, replaced if it is already there.
+
+\return False if the file could not be renamed, both are then left as they were.
+
+*/
+
+bool replaceFile(const std::string& from, const std::string& to)
+{
+#ifdef _WIN32
+    return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    return rename(from.c_str(), to.c_str()) == 0;
+#endif
+}
+
+/**
+\brief Opens a temporary file to be renamed over path once it is written.
+
+\param path --- the file that will be replaced.
+\param tempPath --- output, the name of the temporary file.
+
+The name is unique per process and write, threads writing the same path never share a temporary
+file.  Finish with commitTemporaryFile, or discardTemporaryFile to give up.
+
+\return The open file, or NULL if it could not be created.
+
+*/
+
+FILE* openTemporaryFile(const std::string& path, std::string& tempPath)
+{
+    tempPath = temporaryPath(path);
+    return fopen(tempPath.c_str(), "wb");
+}
+
+/**
+\brief Flushes a temporary file to disk, closes it and renames it over path.
+
+\param out --- the file from openTemporaryFile, closed either way.
+\param tempPath --- its name.
+\param path --- the file to replace.
+
+\return False if any step failed, the temporary file is then removed and path left as it was.
+
+*/
+
+bool commitTemporaryFile(FILE* out, const std::string& tempPath, const std::string& path)
+{
+    bool ok = fflush(out) == 0;
+#ifdef _WIN32
+    ok = ok && _commit(_fileno(out)) == 0;
+#else
+    ok = ok && fsync(fileno(out)) == 0; // the data is on disk before the rename makes it visible
+#endif
+    ok = (fclose(out) == 0) && ok;
+
+    ok = ok && replaceFile(tempPath, path);
+    if (!ok)
+        remove(tempPath.c_str());
+    return ok;
+}
+
+/**
+\brief Closes and removes a temporary file that will not be committed.
+
+*/
+
+void discardTemporaryFile(FILE* out, const std::string& tempPath)
+{
+    fclose(out);
+    remove(tempPath.c_str());
+}
+
+/**
+\brief Writes a file so it appears whole or not at all.
+
+\param path --- the file to write, replaced if it is already there.
+\param parts --- count blocks of bytes, written one after another.
+\param sizes --- size of each block.
+\param count --- number of blocks.
+
+The bytes go to a temporary file named after the process and the write, are flushed to disk and
+the file is then renamed over path.  A crash part way through leaves at most a stray temporary file.
+
+\return False if the file could not be written, path is then left as it was.
+
+*/
+
+bool writeFileAtomically(const std::string& path, const void* const* parts, const std::size_t* sizes, int count)
+{
+    std::string tempPath;
+    FILE* out = openTemporaryFile(path, tempPath);
+    if (out == NULL)
+        return false;
+
+    bool ok = true;
+    for (int i = 0; i < count && ok; i++)
+        ok = sizes[i] == 0 || fwrite(parts[i], 1, sizes[i], out) == sizes[i];
+    if (!ok)
+    {
+        discardTemporaryFile(out, tempPath);
+        return false;
+    }
+    return commitTemporaryFile(out, tempPath, path);
+}
@@ -0,0 +1,28 @@
+#ifndef FILEUTIL_H_INCLUDED
+#define FILEUTIL_H_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/**
+\file FileUtil.h
+\brief Header file for FileUtil.cpp
+
+*/
+
+bool makeDirectory(const std::string& path);
+bool isDirectory(const std::string& path);
+bool listDirectory(const std::string& path, std::vector<std::string>& names);
+bool getFileStamp(const std::string& path, std::uint64_t* size, std::int64_t* modified);
+std::string scratchPath(const std::string& name);
+std::string temporaryPath(const std::string& path);
+bool replaceFile(const std::string& from, const std::string& to);
+FILE* openTemporaryFile(const std::string& path, std::string& tempPath);
+bool commitTemporaryFile(FILE* out, const std::string& tempPath, const std::string& path);
+void discardTemporaryFile(FILE* out, const std::string& tempPath);
+bool writeFileAtomically(const std::string& path, const void* const* parts, const std::size_t* sizes, int count);
+
+#endif // FILEUTIL_H_INCLUDED
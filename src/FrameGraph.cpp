@@ -0,0 +1,148 @@
+#include "FrameGraph.h"
+
+/**
+\file FrameGraph.cpp
+\brief Draws the frame time graph of the profiler overlay.
+
+*/
+
+// Colour of each FramePhase, then of the time outside every phase.
+static const GLfloat PhaseColors[PhaseCount + 1][3] = {
+    {0.2f, 0.6f, 1.0f},     // audio clock
+    {0.2f, 0.9f, 0.9f},     // bands
+    {0.9f, 0.9f, 0.2f},     // camera
+    {1.0f, 0.5f, 0.1f},     // draw
+    {0.8f, 0.3f, 0.9f},     // swap
+    {0.3f, 0.9f, 0.3f},     // events
+    {0.5f, 0.5f, 0.5f}      // other
+};
+
+static const GLfloat FrameBudgetColor[3] = {0.1f, 0.5f, 0.1f};
+static const GLfloat PercentileColor[3] = {1.0f, 0.1f, 0.1f};
+static const GLfloat BorderColor[3] = {0.6f, 0.6f, 0.6f};
+
+/**
+\brief Constructor
+
+Creates the vertex array, the data is loaded by update.
+
+*/
+
+FrameGraph::FrameGraph()
+{
+    GLint vPosition = 0;
+    GLint vColor = 1;
+    allocated = 0;
+
+    glGenVertexArrays(1, &vboptr);
+    glBindVertexArray(vboptr);
+
+    glGenBuffers(1, &bufptr);
+    glBindBuffer(GL_ARRAY_BUFFER, bufptr);
+    glBufferData(GL_ARRAY_BUFFER, 0, NULL, GL_STREAM_DRAW);
+    glVertexAttribPointer(vPosition, 4, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(0));
+    glVertexAttribPointer(vColor, 3, GL_FLOAT, GL_TRUE, 0, BUFFER_OFFSET(0));
+
+    glEnableVertexAttribArray(vPosition);
+    glEnableVertexAttribArray(vColor);
+}
+
+/**
+\brief Destructor
+
+Removes allocated data from the graphics card.
+
+*/
+
+FrameGraph::~FrameGraph()
+{
+    glBindVertexArray(vboptr);
+    glDeleteBuffers(1, &bufptr);
+    glDeleteVertexArrays(1, &vboptr);
+}
+
+/**
+\brief Adds one line to the vertex data.
+
+*/
+
+void FrameGraph::addLine(GLfloat x0, GLfloat y0, GLfloat x1, GLfloat y1, const GLfloat* color)
+{
+    GLfloat ends[8] = {x0, y0, 0, 1, x1, y1, 0, 1};
+    points.insert(points.end(), ends, ends + 8);
+    colors.insert(colors.end(), color, color + 3);
+    colors.insert(colors.end(), color, color + 3);
+}
+
+/**
+\brief Rebuilds the graph from the newest frames.
+
+\param frames --- the frames to show, oldest first, from FrameProfiler::snapshot.
+\param now --- the profiler's current time in seconds.
+\param seconds --- the time across the graph.
+\param p99 --- the 99th percentile of the frames in milliseconds.
+
+The height of the graph is ProfilerGraphMs, or more when the 99th percentile would not fit.
+
+*/
+
+void FrameGraph::update(const std::vector<FrameRecord>& frames, double now, double seconds, double p99)
+{
+    points.clear();
+    colors.clear();
+
+    double top = (p99 * 1.25 > ProfilerGraphMs) ? p99 * 1.25 : ProfilerGraphMs;
+    for (std::size_t i = 0; i < frames.size(); i++)
+    {
+        GLfloat x = (GLfloat) (1 - (now - frames[i].start) / seconds);
+        if (x < 0)
+            continue;
+
+        double y = 0;
+        double inPhases = 0;
+        for (int p = 0; p <= PhaseCount && y < 1; p++)
+        {
+            double ms = (p < PhaseCount) ? frames[i].phase[p] : frames[i].total - inPhases;
+            if (ms <= 0)
+                continue;
+            inPhases += ms;
+            double next = y + ms / top;
+            next = (next > 1) ? 1 : next;
+            addLine(x, (GLfloat) y, x, (GLfloat) next, PhaseColors[p]);
+            y = next;
+        }
+    }
+
+    GLfloat budget = (GLfloat) (1000.0 / 60 / top);
+    GLfloat mark = (GLfloat) (p99 / top);
+    addLine(0, budget, 1, budget, FrameBudgetColor);
+    addLine(0, mark, 1, mark, PercentileColor);
+    addLine(0, 0, 1, 0, BorderColor);
+    addLine(1, 0, 1, 1, BorderColor);
+    addLine(1, 1, 0, 1, BorderColor);
+    addLine(0, 1, 0, 0, BorderColor);
+
+    // The positions and then the colours, the buffer only grows.
+    std::size_t vertices = points.size() / 4;
+    glBindVertexArray(vboptr);
+    glBindBuffer(GL_ARRAY_BUFFER, bufptr);
+    if (vertices > allocated)
+    {
+        allocated = vertices * 2;
+        glBufferData(GL_ARRAY_BUFFER, allocated * 7 * sizeof(GLfloat), NULL, GL_STREAM_DRAW);
+    }
+    glBufferSubData(GL_ARRAY_BUFFER, 0, points.size() * sizeof(GLfloat), &points[0]);
+    glBufferSubData(GL_ARRAY_BUFFER, allocated * 4 * sizeof(GLfloat), colors.size() * sizeof(GLfloat), &colors[0]);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_TRUE, 0, BUFFER_OFFSET(allocated * 4 * sizeof(GLfloat)));
+}
+
+/**
+\brief Draws the graph as last updated.
+
+*/
+
+void FrameGraph::draw()
+{
+    glBindVertexArray(vboptr);
+    glDrawArrays(GL_LINES, 0, (GLsizei) (points.size() / 4));
+}
@@ -0,0 +1,54 @@
+#ifndef FRAMEGRAPH_H_INCLUDED
+#define FRAMEGRAPH_H_INCLUDED
+
+#ifdef __APPLE__
+    #include <OpenGL/gl3.h>
+    #include <OpenGL/glu.h>
+#else
+    #include <GL/glew.h>
+#endif // __APPLE__
+
+#include <vector>
+
+#include "ProgramDefines.h"
+#include "FrameProfiler.h"
+
+/**
+\file FrameGraph.h
+\brief Header file for FrameGraph.cpp
+
+*/
+
+/**
+\class FrameGraph
+
+\brief An on-screen graph of the last few seconds of frame times.
+
+Each frame is a column as far from the right edge as it is old, its height its time with the
+phases stacked in their own colours and the time outside every phase in grey.  A dim green line
+marks a 60 Hz frame and a red one the 99th percentile of the frames shown.  The graph fills the
+unit square, the caller places it with the model matrix and an orthographic projection.
+
+*/
+
+class FrameGraph
+{
+private:
+    GLuint vboptr;  ///< ID for the VBO.
+    GLuint bufptr;  ///< ID for the array buffer.
+
+    std::vector<GLfloat> points;    ///< Line end points, 4 per vertex.
+    std::vector<GLfloat> colors;    ///< Line colours, 3 per vertex.
+    std::size_t allocated;          ///< Vertices the array buffer holds.
+
+    void addLine(GLfloat x0, GLfloat y0, GLfloat x1, GLfloat y1, const GLfloat* color);
+
+public:
+    FrameGraph();
+    ~FrameGraph();
+
+    void update(const std::vector<FrameRecord>& frames, double now, double seconds, double p99);
+    void draw();
+};
+
+#endif // FRAMEGRAPH_H_INCLUDED
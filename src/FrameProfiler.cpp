@@ -0,0 +1,229 @@
+#include "FrameProfiler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <math.h>
+
+#include "FileUtil.h"
+
+/**
+\file FrameProfiler.cpp
+\brief Per-frame phase timing of the main loop.
+
+*/
+
+/**
+\brief Constructor
+
+\param minCapacity --- the least number of frames kept, rounded up to a power of two.
+
+*/
+
+FrameProfiler::FrameProfiler(std::size_t minCapacity)
+{
+    std::size_t capacity = 1;
+    while (capacity < minCapacity)
+        capacity <<= 1;
+
+    records.resize(capacity);
+    mask = capacity - 1;
+    written.store(0, std::memory_order_relaxed);
+    origin = Clock::now();
+    inFrame = false;
+}
+
+/**
+\brief Starts timing a frame, clearing its phases.
+
+*/
+
+void FrameProfiler::beginFrame()
+{
+    frameStart = Clock::now();
+    current.start = std::chrono::duration<double>(frameStart - origin).count();
+    current.total = 0;
+    for (int p = 0; p < PhaseCount; p++)
+        current.phase[p] = 0;
+    inFrame = true;
+}
+
+/**
+\brief Finishes the frame and publishes its record.
+
+*/
+
+void FrameProfiler::endFrame()
+{
+    if (!inFrame)
+        return;
+    inFrame = false;
+
+    current.total = (float) std::chrono::duration<double, std::milli>(Clock::now() - frameStart).count();
+
+    std::uint64_t count = written.load(std::memory_order_relaxed);
+    records[count & mask] = current;
+    written.store(count + 1, std::memory_order_release);
+}
+
+/**
+\brief Starts timing a phase of the current frame.
+
+*/
+
+void FrameProfiler::beginPhase(FramePhase phase)
+{
+    phaseStart[phase] = Clock::now();
+}
+
+/**
+\brief Adds the time since beginPhase to the phase.
+
+*/
+
+void FrameProfiler::endPhase(FramePhase phase)
+{
+    current.phase[phase] += (float) std::chrono::duration<double, std::milli>(Clock::now() - phaseStart[phase]).count();
+}
+
+/**
+\brief Returns the seconds since the profiler was created, on the same clock as FrameRecord::start.
+
+*/
+
+double FrameProfiler::now() const
+{
+    return std::chrono::duration<double>(Clock::now() - origin).count();
+}
+
+/**
+\brief Returns the number of frames finished so far.
+
+*/
+
+std::uint64_t FrameProfiler::getFrameCount() const
+{
+    return written.load(std::memory_order_acquire);
+}
+
+/**
+\brief Copies out the newest frames, oldest first.
+
+\param out --- output, the frames.
+\param seconds --- only frames that started this many seconds ago or later, 0 or less for every frame kept.
+
+\return The number of frames copied.
+
+*/
+
+std::size_t FrameProfiler::snapshot(std::vector<FrameRecord>& out, double seconds) const
+{
+    out.clear();
+    std::uint64_t end = written.load(std::memory_order_acquire);
+    std::uint64_t capacity = mask + 1;
+    std::uint64_t begin = (end > capacity) ? end - capacity : 0;
+
+    out.reserve((std::size_t) (end - begin));
+    for (std::uint64_t i = begin; i < end; i++)
+        out.push_back(records[i & mask]);
+
+    // The writer may have reused the oldest slots while they were copied, and may be part way
+    // through record after, which reuses the slot of record after - capacity.
+    std::uint64_t after = written.load(std::memory_order_acquire);
+    std::uint64_t valid = (after + 1 > capacity) ? after + 1 - capacity : 0;
+    std::size_t drop = (valid > begin) ? (std::size_t) std::min(valid - begin, end - begin) : 0;
+
+    if (seconds > 0)
+    {
+        double since = now() - seconds;
+        while (drop < out.size() && out[drop].start < since)
+            drop++;
+    }
+    out.erase(out.begin(), out.begin() + drop);
+    return out.size();
+}
+
+/**
+\brief Writes every frame kept to a CSV file, one row per frame with the phases in milliseconds.
+
+\return False if the file could not be written.
+
+*/
+
+bool FrameProfiler::saveCsv(const std::string& path) const
+{
+    std::vector<FrameRecord> frames;
+    snapshot(frames, 0);
+    std::uint64_t first = getFrameCount() - frames.size();
+
+    std::string text = "frame,start_s";
+    for (int p = 0; p < PhaseCount; p++)
+        text += std::string(",") + phaseName((FramePhase) p) + "_ms";
+    text += ",total_ms\n";
+
+    char field[64];
+    for (std::size_t i = 0; i < frames.size(); i++)
+    {
+        snprintf(field, sizeof(field), "%llu,%.6f", (unsigned long long) (first + i), frames[i].start);
+        text += field;
+        for (int p = 0; p < PhaseCount; p++)
+        {
+            snprintf(field, sizeof(field), ",%.4f", frames[i].phase[p]);
+            text += field;
+        }
+        snprintf(field, sizeof(field), ",%.4f\n", frames[i].total);
+        text += field;
+    }
+
+    const void* parts[1] = {text.data()};
+    std::size_t sizes[1] = {text.size()};
+    return writeFileAtomically(path, parts, sizes, 1);
+}
+
+/**
+\brief Returns a percentile of the frame times in milliseconds, nearest rank.
+
+\param frames --- the frames, such as a snapshot.
+\param p --- the percentile, 0 to 100.
+
+*/
+
+double FrameProfiler::percentile(const std::vector<FrameRecord>& frames, double p)
+{
+    if (frames.empty())
+        return 0;
+
+    std::vector<float> totals(frames.size());
+    for (std::size_t i = 0; i < frames.size(); i++)
+        totals[i] = frames[i].total;
+
+    std::size_t rank = (std::size_t) ceil(p / 100 * totals.size());
+    rank = (rank < 1) ? 0 : ((rank > totals.size()) ? totals.size() - 1 : rank - 1);
+    std::nth_element(totals.begin(), totals.begin() + rank, totals.end());
+    return totals[rank];
+}
+
+/**
+\brief Returns the short name of a phase, as used in the CSV header.
+
+*/
+
+const char* FrameProfiler::phaseName(FramePhase phase)
+{
+    switch (phase)
+    {
+    case PhaseAudioClock:
+        return "audio_clock";
+    case PhaseBands:
+        return "bands";
+    case PhaseCamera:
+        return "camera";
+    case PhaseDraw:
+        return "draw";
+    case PhaseSwap:
+        return "swap";
+    case PhaseEvents:
+        return "events";
+    default:
+        return "unknown";
+    }
+}
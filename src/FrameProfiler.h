@@ -0,0 +1,121 @@
+#ifndef FRAMEPROFILER_H_INCLUDED
+#define FRAMEPROFILER_H_INCLUDED
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+\file FrameProfiler.h
+\brief Header file for FrameProfiler.cpp
+
+*/
+
+/**
+\brief The phases of one frame of the main loop that are timed.
+
+*/
+
+enum FramePhase
+{
+    PhaseAudioClock,    ///< Reading the playback position.
+    PhaseBands,         ///< Looking up and smoothing the band magnitudes.
+    PhaseCamera,        ///< Moving the camera and building the view matrix.
+    PhaseDraw,          ///< Issuing the draw calls.
+    PhaseSwap,          ///< The buffer swap.
+    PhaseEvents,        ///< UI::processEvents.
+    PhaseCount          ///< Number of phases.
+};
+
+/**
+\brief The timings of one frame.
+
+*/
+
+struct FrameRecord
+{
+    double start;               ///< Seconds from the profiler's creation to the start of the frame.
+    float total;                ///< Milliseconds from beginFrame to endFrame.
+    float phase[PhaseCount];    ///< Milliseconds spent in each phase.
+};
+
+/**
+\class FrameProfiler
+
+\brief Times the phases of every frame and keeps the last ProfilerFrames of them.
+
+The main loop calls beginFrame and endFrame around each frame and wraps its phases in
+ScopedPhase, a phase entered more than once in a frame adds up.  Finished frames go into a
+ring that only the render thread writes: the record is copied into its slot and then the count
+of frames is published with a release store.  snapshot can be called from any thread without
+a lock, it copies the newest records and then drops any the writer may have reused while it was
+copying.  Nothing is allocated after the constructor.
+
+*/
+
+class FrameProfiler
+{
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    std::vector<FrameRecord> records;   ///< The ring, a power of two of records.
+    std::size_t mask;                   ///< Capacity - 1.
+    std::atomic<std::uint64_t> written; ///< Frames finished so far, written by the render thread only.
+
+    Clock::time_point origin;               ///< When the profiler was created.
+    Clock::time_point frameStart;           ///< Start of the current frame.
+    Clock::time_point phaseStart[PhaseCount]; ///< Start of each phase now running.
+    FrameRecord current;                    ///< The frame being timed.
+    bool inFrame;                           ///< Between beginFrame and endFrame.
+
+    FrameProfiler(const FrameProfiler&);
+    FrameProfiler& operator=(const FrameProfiler&);
+
+public:
+    explicit FrameProfiler(std::size_t minCapacity);
+
+    void beginFrame();
+    void endFrame();
+    void beginPhase(FramePhase phase);
+    void endPhase(FramePhase phase);
+
+    double now() const;
+    std::uint64_t getFrameCount() const;
+    std::size_t snapshot(std::vector<FrameRecord>& out, double seconds) const;
+    bool saveCsv(const std::string& path) const;
+
+    static double percentile(const std::vector<FrameRecord>& frames, double p);
+    static const char* phaseName(FramePhase phase);
+};
+
+/**
+\class ScopedPhase
+
+\brief Times a phase from its construction to the end of its scope.
+
+*/
+
+class ScopedPhase
+{
+private:
+    FrameProfiler& profiler;    ///< The profiler timed into.
+    FramePhase phase;           ///< The phase timed.
+
+    ScopedPhase(const ScopedPhase&);
+    ScopedPhase& operator=(const ScopedPhase&);
+
+public:
+    ScopedPhase(FrameProfiler& p, FramePhase ph) : profiler(p), phase(ph)
+    {
+        profiler.beginPhase(phase);
+    }
+
+    ~ScopedPhase()
+    {
+        profiler.endPhase(phase);
+    }
+};
+
+#endif // FRAMEPROFILER_H_INCLUDED
@@ -1,4 +1,5 @@
 #include "GraphicsEngine.h"
+#include "Tracer.h"
 
 /**
 \file GraphicsEngine.cpp
@@ -20,14 +21,20 @@ This class extends sf::RenderWindow.
 \param MinorVer --- The OpenGL minor version that is requested.
 \param width --- The width (in pixels) of the graphics window.
 \param height --- The height (in pixels) of the graphics window.
+\param input --- Where the audio comes from, tracks or live input.
+\param playlist --- The tracks to play in order when input is InputFile.
+\param vsync --- Sync to the display refresh, or draw as fast as possible.
 
 Creates rendering window, loads the shaders, and sets some initial data settings.
 
 */
 
-GraphicsEngine::GraphicsEngine(std::string title, GLint MajorVer, GLint MinorVer, int width, int height) :
+GraphicsEngine::GraphicsEngine(std::string title, GLint MajorVer, GLint MinorVer, int width, int height, InputMode input,
+                               const std::vector<std::string>& playlist, bool vsync) :
     sf::RenderWindow(sf::VideoMode(width, height), title, sf::Style::Default,
-                     sf::ContextSettings(24, 8, 4, MajorVer, MinorVer, sf::ContextSettings::Core))
+                     sf::ContextSettings(24, 8, 4, MajorVer, MinorVer, sf::ContextSettings::Core)),
+    audioObj(input, playlist),
+    profiler(ProfilerFrames)
 {
     //  Load the shaders
     GLuint program = LoadShadersFromFile("VertexShaderBasic3D.glsl", "PassThroughFrag.glsl");
@@ -38,8 +45,6 @@ GraphicsEngine::GraphicsEngine(std::string title, GLint MajorVer, GLint MinorVer
         exit(EXIT_FAILURE);
     }
 
-    fftData = (double *)malloc( (((audioObj.getNumSamples()/fftBuffer) * 5) +1) * sizeof(double));
-
     // Turn on the shader & get location of transformation matrix.
     glUseProgram(program);
     ProjLoc = glGetUniformLocation(program, "Proj");
@@ -53,14 +58,24 @@ GraphicsEngine::GraphicsEngine(std::string title, GLint MajorVer, GLint MinorVer
     drawAxes = GL_TRUE;
     drawManyBoxes = GL_TRUE;
     drawBoxes = GL_TRUE;
-    counter2 = 0;
-    audioTimer2 = 0.0;
-
-    /////////////////////////////////
-    audioObj.performFFT();
-    timePerVisual = audioObj.getTimePerVisual();
-    audioObj.getPeakMag(fftData);
-    audioObj.getMaxMag(maxMags);
+    counter = 0;
+    drawProfiler = GL_FALSE;
+    profileCount = 1;
+    counter2 = -1;
+    flash = 0;
+    lastFrame.display = 0;
+    lastFrame.submit = 0;
+    lastFrame.swap = 0;
+    visuals.assign(audioObj.getBandCount() * audioObj.getViewCount(), 0);
+    levels = &visuals[0];
+    maxMags.assign(visuals.size(), 0);
+    maxMagsFinal = false;
+    smoother.setBandCount(visuals.size());
+
+    // The analysis runs in the background, display reads the frames as they are published.
+    audioObj.startAnalysis();
+    for (int v = 0; v < audioObj.getViewCount(); v++)
+        audioObj.getMaxMag(&maxMags[v * audioObj.getBandCount()], v);
 
     // Set position of spherical camera
     sphcamera.setPosition(30, 30, 20);
@@ -71,16 +86,7 @@ GraphicsEngine::GraphicsEngine(std::string title, GLint MajorVer, GLint MinorVer
     glEnable(GL_DEPTH_TEST);
     glEnable(GL_CULL_FACE);
 
-    if (SetVS)
-    {
-        setVerticalSyncEnabled(true);
-        setFramerateLimit(60);
-    }
-    else
-    {
-        setVerticalSyncEnabled(false);
-        setFramerateLimit(0);
-    }
+    setVerticalSync(vsync);
 
     // Make it the active window for OpenGL calls, resize to set projection matrix.
     setActive();
@@ -105,56 +111,100 @@ GraphicsEngine::~GraphicsEngine()
 \brief The function responsible for drawing to the OpenGL frame buffer.
 
 This function clears the screen and calls the draw functions of the box. Also keeps track of what visual to display based on the offset of audio.
+Frames past the analysis high-water mark are not read, the bars hold their last value until the analysis catches up.
+When the next track of the playlist starts, its analysis takes over from the first frame heard and the bars carry on
+smoothly from the last track's.
 
 
 */
 
 void GraphicsEngine::display()
 {
+    TRACE_SCOPE("display");
+    sf::Clock timer; // split into lastFrame, see getFrameTiming
+
+    profiler.beginPhase(PhaseBands);
+    if (audioObj.advanceTrack()) // the next track is being heard, show its frames and scale by its peaks
+    {
+        counter2 = -1;
+        maxMagsFinal = false;
+        if (levels != &visuals[0]) // the frame read in place went with the last track
+            visuals.assign(visuals.size(), 0);
+        std::size_t size = (std::size_t) audioObj.getBandCount() * audioObj.getViewCount();
+        if (size != visuals.size()) // only a track with other channels can change the views
+        {
+            visuals.assign(size, 0);
+            maxMags.assign(size, 0);
+            smoother.setBandCount(size);
+        }
+        levels = &visuals[0];
+    }
+    profiler.endPhase(PhaseBands);
+
+    // Flash the background on each onset heard, fading over a few frames.
+    flash = (audioObj.takeOnsets() > 0) ? 1 : flash * 0.85f;
+    glClearColor(flash * 0.25f, flash * 0.25f, flash * 0.3f, 1);
 
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    audioTimer = audioObj.grabPlayingOffset(); //this method will precalculate the amount of time for each visual representation of data
+    profiler.beginPhase(PhaseBands);
+    int bands = audioObj.getBandCount();
+    int views = audioObj.getViewCount();
+
+    if (!maxMagsFinal) // running max over the frames analysed so far, read once more when the analysis completes
+    {
+        maxMagsFinal = audioObj.isAnalysisComplete();
+        for (int v = 0; v < views; v++)
+            audioObj.getMaxMag(&maxMags[v * bands], v);
+    }
+
+    profiler.endPhase(PhaseBands);
 
-    sf::Time t = sf::seconds(timePerVisual);//turn it into a time variable
+    profiler.beginPhase(PhaseAudioClock);
+    bool playing = audioObj.isPlaying() == sf::SoundSource::Playing;
+    int frame = playing ? audioObj.getPlaybackFrame() : -1; // the frame being heard, straight from the stream's playback clock
+    profiler.endPhase(PhaseAudioClock);
 
-    if(audioObj.isPlaying() == sf::SoundSource::Playing) // if the audio is playing
+    profiler.beginPhase(PhaseBands);
+    if(playing) // if the audio is playing
     {
-        if( t.asSeconds() < ((audioTimer) - audioTimer2))//if the timer per visual (around a tenth of a second) is less than amount of time audio has played
+        if( frame != counter2 )
         {
-
-            visuals[0] = fftData[counter2];
-            visuals[1] = fftData[counter2 +1];
-            visuals[2] = fftData[counter2 +2];
-            visuals[3] = fftData[counter2 +3];
-            visuals[4] = fftData[counter2 + 4];
-            audioClock.restart();
-            counter2 = counter2 +5;
-            audioTimer2 = audioTimer;
-            if( counter2+5 >= (audioObj.getNumSamples()/fftBuffer)*5 )//if we are reaching the end of the audio, reset vidual counter
+            ValueSpan mags = audioObj.getFrame(frame); // empty for live input, a timeline, or a frame not analysed yet
+            if (mags.count > 0 && mags.stride == 1)
+                levels = mags.data; // frame major, the views of a frame follow each other, read in place
+            else if (mags.count > 0)
             {
-                counter2 = 0;
-                audioTimer2 = 0.0;
-                //std::cout<<"idc";
+                for (int v = 0; v < views; v++) // band major, gather the frame
+                {
+                    mags = audioObj.getFrame(frame, v);
+                    for (int b = 0; b < bands; b++)
+                        visuals[v * bands + b] = mags[b];
+                }
+                levels = &visuals[0];
             }
-            //std::cout<<t.asSeconds()<<"\n";
-        }
-        else //reset audio timer
-        {
-            //std::cout<<audioTimer2<<"\n";
-            audioTimer2 = 0;
-
+            else
+            {
+                for (int v = 0; v < views; v++) // every view was analysed in the same pass
+                    if (audioObj.getFrameMags(frame, &visuals[v * bands], v)) // keeps the last visuals if this frame is not analysed yet
+                        levels = &visuals[0];
+            }
+            counter2 = frame;
         }
     }
     else//set visuals to 0 to show no audio
     {
-        visuals[0] = 0;
-        visuals[1] = 0;
-        visuals[2] = 0;
-        visuals[3] = 0;
-        visuals[4] = 0;
+        visuals.assign(visuals.size(), 0);
+        levels = &visuals[0];
     }
 
+    // Heights from the smoother move by the real time since the last frame, whatever the frame rate.
+    smoother.update(levels, &maxMags[0], frameClock.restart().asSeconds());
+    const float* heights = smoother.getLevels();
+    const float* peaks = smoother.getPeaks();
+    profiler.endPhase(PhaseBands);
+
+    profiler.beginPhase(PhaseCamera);
     if(CameraNumber == 2)
     {
         if(counter >2094)
@@ -166,6 +216,8 @@ void GraphicsEngine::display()
         yprcamera.setPosition( locationArr[0], locationArr[1] + 0.1, locationArr[2]);
 
     }
+    double submitStart = timer.getElapsedTime().asMicroseconds() * 1e-6;
+
     // Set view matrix via current camera.
     glm::mat4 view(1.0);
     if (CameraNumber == 1)
@@ -173,6 +225,9 @@ void GraphicsEngine::display()
     else if (CameraNumber == 2)
         view = yprcamera.lookAt();
 
+    profiler.endPhase(PhaseCamera);
+
+    profiler.beginPhase(PhaseDraw);
     // Load view matrix to shader.
     glUniformMatrix4fv(ViewLoc, 1, GL_FALSE, glm::value_ptr(view));
 
@@ -192,19 +247,26 @@ void GraphicsEngine::display()
     {
         if (drawManyBoxes)
         {
-            int x = -4;
+            float spacing = 10.0f / bands; // the bars always span the same width, 5 bands are 2 apart
+            float x = -(bands - 1) * spacing / 2;
             int y = 0;
-            int z = 0;
-            for (int i = 0; i <5; i++)
+            for (int i = 0; i < bands * views; i++)
             {
                 /*
                 We shall create the boxes next to each other in space around the origin in order to
-                visualize the audio data
+                visualize the audio data, one row per view front to back
                 */
 
-                glm::mat4 model = glm::translate(glm::mat4(1.0), glm::vec3(x + (i * 2), y, z));
-                model = glm::scale(model, glm::vec3(1,(visuals[i] / maxMags[i]) * 10,1));
-                glUniformMatrix4fv(ModelLoc, 1, GL_FALSE, glm::value_ptr(model));
+                float z = ((views - 1) / 2.0f - i / bands) * 2;
+                glm::mat4 model = glm::translate(glm::mat4(1.0), glm::vec3(x + ((i % bands) * spacing), y, z));
+                glm::mat4 bar = glm::scale(model, glm::vec3(spacing / 2, heights[i] * 10, 1));
+                glUniformMatrix4fv(ModelLoc, 1, GL_FALSE, glm::value_ptr(bar));
+                box.draw();
+
+                // A thin slab marks the held peak at the top of a bar that tall.
+                glm::mat4 cap = glm::translate(model, glm::vec3(0, peaks[i] * 5, 0));
+                cap = glm::scale(cap, glm::vec3(spacing / 2, 0.1f, 1));
+                glUniformMatrix4fv(ModelLoc, 1, GL_FALSE, glm::value_ptr(cap));
                 box.draw();
             }
 
@@ -220,8 +282,50 @@ void GraphicsEngine::display()
 
 
 
-    sf::RenderWindow::display();
+    if (drawProfiler)
+        drawFrameGraph();
+    profiler.endPhase(PhaseDraw);
+
+    double swapStart = timer.getElapsedTime().asMicroseconds() * 1e-6;
+    profiler.beginPhase(PhaseSwap);
+    {
+        TRACE_SCOPE("swap");
+        sf::RenderWindow::display();
+    }
+    profiler.endPhase(PhaseSwap);
+    double swapEnd = timer.getElapsedTime().asMicroseconds() * 1e-6;
+
+    audioObj.markDisplayed(); // live mode times the bars from input to screen
     printOpenGLErrors();
+
+    lastFrame.submit = swapStart - submitStart;
+    lastFrame.swap = swapEnd - swapStart;
+    lastFrame.display = timer.getElapsedTime().asMicroseconds() * 1e-6;
+}
+
+/**
+\brief Draws the profiler's graph of the last ProfilerGraphSeconds over the bottom left of the window.
+
+The scene's projection, view and depth test are put back afterwards.
+
+*/
+
+void GraphicsEngine::drawFrameGraph()
+{
+    profiler.snapshot(recentFrames, ProfilerGraphSeconds);
+    frameGraph.update(recentFrames, profiler.now(), ProfilerGraphSeconds, FrameProfiler::percentile(recentFrames, 99));
+
+    glm::mat4 ortho = glm::ortho(0.0f, 1.0f, 0.0f, 1.0f, -1.0f, 1.0f);
+    glm::mat4 place = glm::scale(glm::translate(glm::mat4(1.0), glm::vec3(0.02f, 0.02f, 0)), glm::vec3(0.45f, 0.3f, 1));
+    glUniformMatrix4fv(ProjLoc, 1, GL_FALSE, glm::value_ptr(ortho));
+    glUniformMatrix4fv(ViewLoc, 1, GL_FALSE, glm::value_ptr(glm::mat4(1.0)));
+    glUniformMatrix4fv(ModelLoc, 1, GL_FALSE, glm::value_ptr(place));
+
+    glDisable(GL_DEPTH_TEST);
+    frameGraph.draw();
+    glEnable(GL_DEPTH_TEST);
+
+    glUniformMatrix4fv(ProjLoc, 1, GL_FALSE, glm::value_ptr(projection));
 }
 
 /**
@@ -257,6 +361,42 @@ void GraphicsEngine::screenshot()
     sscount++;
 }
 
+/**
+\brief Saves the profiler's frames to a file, FrameProfile###.csv.
+
+*/
+
+void GraphicsEngine::saveFrameProfile()
+{
+    char csvfilename[100];
+    sprintf(csvfilename, "FrameProfile%d.csv", profileCount);
+    if (profiler.saveCsv(csvfilename))
+        std::cout << "Saved the frame profile to " << csvfilename << std::endl;
+    else
+        std::cerr << "Could not write " << csvfilename << std::endl;
+    profileCount++;
+}
+
+/**
+\brief Shows or hides the profiler overlay.
+
+*/
+
+void GraphicsEngine::toggleFrameGraph()
+{
+    drawProfiler = !drawProfiler;
+}
+
+/**
+\brief Returns a pointer to the frame profiler, the main loop times its own phases into it.
+
+*/
+
+FrameProfiler* GraphicsEngine::getProfiler()
+{
+    return &profiler;
+}
+
 /**
 \brief Handles the resizing events of the window.
 
@@ -286,6 +426,27 @@ void GraphicsEngine::setSize(unsigned int width, unsigned int height)
     sf::RenderWindow::setSize(sf::Vector2u(width, height));
 }
 
+/**
+\brief Turns vertical sync on or off.
+
+\param vsync --- true to sync to the display refresh at up to 60 frames a second, false to draw as fast as possible.
+
+*/
+
+void GraphicsEngine::setVerticalSync(bool vsync)
+{
+    if (vsync)
+    {
+        setVerticalSyncEnabled(true);
+        setFramerateLimit(60);
+    }
+    else
+    {
+        setVerticalSyncEnabled(false);
+        setFramerateLimit(0);
+    }
+}
+
 /**
 \brief Returns a pointer to the box object.
 
@@ -440,7 +601,6 @@ void GraphicsEngine::setDrawAxes(GLboolean b)
 void GraphicsEngine::startAudio()
 {
     audioObj.soundStart();
-    audioClock.restart();
 }
 /**
 \brief Pauses the audio
@@ -465,3 +625,36 @@ sf::SoundSource::Status GraphicsEngine::isPlaying()
 {
     return audioObj.isPlaying();
 }
+/**
+\brief Gets the input to bar latency of live mode since the last call
+
+\param mean --- output, mean latency in milliseconds.
+\param worst --- output, worst latency in milliseconds.
+
+\return False if not in live mode or no new frame has been shown.
+
+*/
+bool GraphicsEngine::getInputLatency(double* mean, double* worst)
+{
+    return audioObj.getInputLatency(mean, worst);
+}
+/**
+\brief Checks whether the whole track has been analysed
+
+*/
+bool GraphicsEngine::isAnalysisComplete()
+{
+    return audioObj.isAnalysisComplete();
+}
+/**
+\brief Gets where the time of the last display call went
+
+The display time covers the whole call, submit the GL calls of the scene and swap the buffer
+swap.  With a driver that queues the work, submit is the CPU cost of issuing it and swap includes
+waiting for the frame to finish.
+
+*/
+FrameTiming GraphicsEngine::getFrameTiming()
+{
+    return lastFrame;
+}
@@ -13,6 +13,7 @@
 #include <SFML/System.hpp>
 #include <iostream>
 #include <string>
+#include <vector>
 #include <stdio.h>
 
 #include "LoadShaders.h"
@@ -23,6 +24,9 @@
 #include "YPRCamera.h"
 #include "Axes.h"
 #include "fft_SFML.h"
+#include "BandSmoother.h"
+#include "FrameProfiler.h"
+#include "FrameGraph.h"
 
 /**
 \file GraphicsEngine.h
@@ -34,6 +38,18 @@
 
 */
 
+/**
+\brief Where the time of one display call went, in seconds.
+
+*/
+
+struct FrameTiming
+{
+    double display;     ///< The whole display call.
+    double submit;      ///< Issuing the scene's GL calls, from the view matrix to the last draw.
+    double swap;        ///< Handing the frame to the window, the buffer swap.
+};
+
 /**
 \class GraphicsEngine
 
@@ -52,9 +68,12 @@ private:
     Axes coords;    ///< Axes Object
     GLfloat locationArr[3]; ///<location array
     int counter;    ///<counter
-    double maxMags[5]; ///<keeps max mags
-    float audioTimer, audioTimer2; ///<audio timers to help with audio and visual synch
-    double visuals[5]; ///<the visuals displayed
+    std::vector<double> maxMags; ///<keeps max mags, one per band of each view
+    bool maxMagsFinal; ///<maxMags were read after the analysis was complete, they no longer change
+    std::vector<double> visuals; ///<the visuals displayed when they cannot be read in place, one per band of each view
+    const double* levels; ///<the visuals displayed, a frame of the track's analysis read in place or visuals
+    BandSmoother smoother; ///<turns visuals into steady bar heights and held peaks
+    sf::Clock frameClock; ///<time since the last display, drives the smoothing
 
     GLuint ProjLoc;      ///< Location ID of the Projection matrix in the shader.
     GLuint ViewLoc;      ///< Location ID of the View matrix in the shader.
@@ -71,18 +90,25 @@ private:
     GLboolean drawBoxes;       ///< Boolean for boxes being drawn.
 
     fft_SFML audioObj;  ///<audio object
-    sf::Clock audioClock;   ///<sfml clock
-    float timePerVisual; ///< time calculate per visual screen time
-    double *fftData; ///< pointer to the fft data
-    int counter2; ///<general second counter
+    int counter2; ///<analysis frame currently shown
+    GLfloat flash; ///<background brightness after an onset, fades each frame
+    FrameTiming lastFrame; ///<time taken by the last display call
+    FrameProfiler profiler; ///<phase times of the last ProfilerFrames frames
+    FrameGraph frameGraph; ///<overlay graph of the profiler's last few seconds
+    std::vector<FrameRecord> recentFrames; ///<frames shown by the overlay, reused each frame
+    GLboolean drawProfiler; ///<Boolean for the profiler overlay being drawn.
+    int profileCount; ///<Profile count to be appended to the CSV filename.
 
 
     void printOpenGLErrors();
+    void drawFrameGraph();
     void print_GLM_Matrix(glm::mat4 m);
 
 public:
     GraphicsEngine(std::string title = "OpenGL Window", GLint MajorVer = 3, GLint MinorVer = 3,
-                   int width = 600, int height = 600);
+                   int width = 600, int height = 600, InputMode input = InputFile,
+                   const std::vector<std::string>& playlist = std::vector<std::string>(1, DefaultTrackPath),
+                   bool vsync = SetVS);
     ~GraphicsEngine();
 
     void startAudio();
@@ -91,8 +117,12 @@ public:
     void display();
     void changeMode();
     void screenshot();
+    void saveFrameProfile();
+    void toggleFrameGraph();
+    FrameProfiler* getProfiler();
     void resize();
     void setSize(unsigned int, unsigned int);
+    void setVerticalSync(bool);
     GLfloat* getScreenBounds();
     Cube* getBox();
 
@@ -100,6 +130,9 @@ public:
     void setDrawBoxes(GLboolean b);
     void setDrawAxes(GLboolean b);
     sf::SoundSource::Status isPlaying();
+    bool getInputLatency(double* mean, double* worst);
+    bool isAnalysisComplete();
+    FrameTiming getFrameTiming();
 
     GLboolean isSphericalCameraOn();
     void setSphericalCameraOn();
@@ -0,0 +1,379 @@
+#include "LiveAnalyzer.h"
+
+#include <chrono>
+#include <cstring>
+
+#include "AnalysisKernels.h"
+#include "FftPlanCache.h"
+#include "Tracer.h"
+
+/**
+\file LiveAnalyzer.cpp
+\brief Rolling analysis of live input.
+
+*/
+
+/**
+\brief Constructor
+
+The ring holds about a second of audio at LiveSampleRate.
+
+*/
+
+LiveAnalyzer::LiveAnalyzer() : capture(LiveSampleRate), recorder(capture), stdinSource(capture)
+{
+    source = NULL;
+    sampleRate = LiveSampleRate;
+    bandCount = layout.getBandCount();
+    hopSize = fftBuffer / 4;
+    windowType = WindowHann;
+
+    running.store(false);
+    latestMags.assign(bandCount, 0);
+    bandMax.assign(bandCount, 0);
+    latestCapture = 0;
+    framesPublished.store(0);
+    onsetCount.store(0);
+
+    shownCapture = 0;
+    shownPending = false;
+    latencySum = 0;
+    latencyWorst = 0;
+    latencyCount = 0;
+}
+
+/**
+\brief Destructor
+
+Stops the source and joins the analysis thread before the ring goes away.
+
+*/
+
+LiveAnalyzer::~LiveAnalyzer()
+{
+    pause();
+}
+
+/**
+\brief Picks the source of the audio.
+
+\param mode --- InputDevice or InputStdin, InputFile leaves live mode off.
+\param rate --- sample rate to capture at, stdin input must already be at this rate.
+
+*/
+
+void LiveAnalyzer::setInput(InputMode mode, unsigned int rate)
+{
+    pause();
+    source = (mode == InputDevice) ? (LiveSource*) &recorder : (mode == InputStdin) ? (LiveSource*) &stdinSource : NULL;
+    sampleRate = (rate > 0) ? rate : LiveSampleRate;
+}
+
+/**
+\brief Sets how the spectrum is split into bands, restarting the analysis if it is running.
+
+*/
+
+void LiveAnalyzer::setBandLayout(const BandLayout& bands)
+{
+    bool wasRunning = running.load();
+    pause();
+
+    layout = bands;
+    bandCount = layout.getBandCount();
+    latestMags.assign(bandCount, 0);
+    bandMax.assign(bandCount, 0);
+    framesPublished.store(0);
+
+    if (wasRunning)
+        start();
+}
+
+/**
+\brief Sets the samples between frames, clamped to 1 ... fftBuffer, takes effect on the next start.
+
+*/
+
+void LiveAnalyzer::setHopSize(int hop)
+{
+    hopSize = (hop < 1) ? 1 : (hop > fftBuffer) ? fftBuffer : hop;
+}
+
+/**
+\brief Sets the window applied to each frame, takes effect on the next start.
+
+*/
+
+void LiveAnalyzer::setWindow(WindowType type)
+{
+    windowType = type;
+}
+
+/**
+\brief Starts the analysis thread and then the source.
+
+\return False if there is no source or it could not be started.
+
+*/
+
+bool LiveAnalyzer::start()
+{
+    if (source == NULL)
+        return false;
+    if (running.load())
+        return true;
+
+    // Whatever came in while paused is old news.
+    capture.pop(NULL, capture.available());
+
+    running.store(true);
+    worker = std::thread(&LiveAnalyzer::run, this);
+
+    if (!source->start(sampleRate))
+    {
+        pause();
+        return false;
+    }
+    return true;
+}
+
+/**
+\brief Stops the source and the analysis thread.  The bars keep their last values.
+
+*/
+
+void LiveAnalyzer::pause()
+{
+    if (source != NULL)
+        source->stop();
+
+    running.store(false);
+    if (worker.joinable())
+        worker.join();
+}
+
+/**
+\brief Returns true while capturing and analysing.
+
+*/
+
+bool LiveAnalyzer::isRunning() const
+{
+    return running.load();
+}
+
+/**
+\brief Returns the number of bands.
+
+*/
+
+int LiveAnalyzer::getBandCount() const
+{
+    return bandCount;
+}
+
+/**
+\brief Returns the samples between frames.
+
+*/
+
+int LiveAnalyzer::getHopSize() const
+{
+    return hopSize;
+}
+
+/**
+\brief Returns the capture sample rate.
+
+*/
+
+unsigned int LiveAnalyzer::getSampleRate() const
+{
+    return sampleRate;
+}
+
+/**
+\brief Returns the number of frames analysed, it changes whenever a new frame is ready.
+
+*/
+
+int LiveAnalyzer::getFramesPublished() const
+{
+    return framesPublished.load(std::memory_order_acquire);
+}
+
+/**
+\brief Returns the number of onsets picked since start, the renderer counts the difference.
+
+*/
+
+int LiveAnalyzer::getOnsetCount() const
+{
+    return onsetCount.load(std::memory_order_relaxed);
+}
+
+/**
+\brief Returns the number of samples lost because the analysis fell a whole ring behind.
+
+*/
+
+std::uint64_t LiveAnalyzer::getDropped() const
+{
+    return capture.getDropped();
+}
+
+/**
+\brief Render thread, copies the band magnitudes of the newest frame.
+
+\param mags --- getBandCount() slots.
+
+\return False if no frame has been analysed yet.
+
+*/
+
+bool LiveAnalyzer::getLatest(double* mags)
+{
+    std::lock_guard<std::mutex> lock(publishMutex);
+    if (framesPublished.load(std::memory_order_relaxed) == 0)
+        return false;
+
+    memcpy(mags, &latestMags[0], bandCount * sizeof(double));
+    shownCapture = latestCapture;
+    shownPending = true;
+    return true;
+}
+
+/**
+\brief Render thread, copies the decaying peak of each band.
+
+*/
+
+void LiveAnalyzer::getMaxMag(double* mags)
+{
+    std::lock_guard<std::mutex> lock(publishMutex);
+    memcpy(mags, &bandMax[0], bandCount * sizeof(double));
+}
+
+/**
+\brief Render thread, call after the buffer swap.  Times the frame last taken by getLatest.
+
+*/
+
+void LiveAnalyzer::markDisplayed()
+{
+    if (!shownPending)
+        return;
+    shownPending = false;
+
+    double ms = (LiveCapture::nowMicros() - shownCapture) / 1000.0;
+    latencySum += ms;
+    latencyCount++;
+    if (ms > latencyWorst)
+        latencyWorst = ms;
+}
+
+/**
+\brief Render thread, the input to bar latency since the last call.
+
+\param mean --- output, mean latency in milliseconds.
+\param worst --- output, worst latency in milliseconds.
+
+\return False if no frame has been shown since the last call.
+
+*/
+
+bool LiveAnalyzer::getLatency(double* mean, double* worst)
+{
+    if (latencyCount == 0)
+        return false;
+
+    *mean = latencySum / latencyCount;
+    *worst = latencyWorst;
+    latencySum = 0;
+    latencyWorst = 0;
+    latencyCount = 0;
+    return true;
+}
+
+/**
+\brief The analysis thread.
+
+Waits for a hop of new samples, polling because the capture side must not be made to signal,
+and analyses the newest fftBuffer samples each time.
+
+*/
+
+void LiveAnalyzer::run()
+{
+    TRACE_THREAD_NAME("live analysis");
+    const int bins = fftBuffer / 2;
+    const int hop = hopSize;
+
+    std::vector<double> window;
+    buildWindow(windowType, fftBuffer, window);
+    std::vector<int> binBand;
+    layout.buildBinTable(sampleRate, fftBuffer, binBand);
+
+    double* in = (double*) fftw_malloc(sizeof(double) * fftBuffer);
+    fftw_complex* out = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) * (bins + 1));
+    fftw_plan plan = FftPlanCache::instance().getR2C(fftBuffer, in, out);
+
+    std::vector<std::int16_t> frame(fftBuffer, 0);
+    std::vector<double> mags(bins + 1);
+    std::vector<double> previousMags(bins + 1, 0);
+    std::vector<double> bandPeak(bandCount + 1);
+    double decay = pow(0.5, (double) hop / sampleRate / LivePeakHalfLife);
+
+    OnsetDetector onsets;
+    onsets.setFrameTime((double) hop / sampleRate);
+
+    while (running.load())
+    {
+        std::size_t waiting = capture.available();
+        if (waiting < (std::size_t) hop)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+
+        // Take every whole hop waiting, only the newest frame is analysed.
+        std::size_t take = waiting - waiting % hop;
+        if (take >= (std::size_t) fftBuffer)
+        {
+            capture.pop(NULL, take - fftBuffer);
+            capture.pop(&frame[0], fftBuffer);
+        }
+        else
+        {
+            memmove(&frame[0], &frame[take], (fftBuffer - take) * sizeof(std::int16_t));
+            capture.pop(&frame[fftBuffer - take], take);
+        }
+
+        std::int64_t arrived = LiveCapture::nowMicros();
+        capture.getCaptureTime(capture.getPopped(), arrived);
+
+        windowFrame(&frame[0], &window[0], in, fftBuffer);
+        fftw_execute_dft_r2c(plan, in, out);
+        computeMagnitudes(out, &mags[0], bins + 1);
+
+        bandPeak.assign(bandCount + 1, 0);
+        gatherMax(&mags[0], &binBand[0], bins, &bandPeak[0]);
+
+        // Frames skipped while behind make the flux jump, as they would on the screen.
+        if (onsets.push(spectralFlux(&mags[0], &previousMags[0], bins + 1)))
+            onsetCount.fetch_add(1, std::memory_order_relaxed);
+        mags.swap(previousMags);
+
+        std::lock_guard<std::mutex> lock(publishMutex);
+        for (int b = 0; b < bandCount; b++)
+        {
+            latestMags[b] = bandPeak[b];
+            bandMax[b] = (bandPeak[b] > bandMax[b] * decay) ? bandPeak[b] : bandMax[b] * decay;
+        }
+        latestCapture = arrived;
+        framesPublished.fetch_add(1, std::memory_order_release);
+    }
+
+    fftw_free(in);
+    fftw_free(out);
+}
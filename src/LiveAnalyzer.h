@@ -0,0 +1,114 @@
+#ifndef LIVEANALYZER_H_INCLUDED
+#define LIVEANALYZER_H_INCLUDED
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "ProgramDefines.h"
+#include "BandLayout.h"
+#include "WindowFunction.h"
+#include "LiveCapture.h"
+#include "OnsetDetector.h"
+
+/**
+\file LiveAnalyzer.h
+\brief Header file for LiveAnalyzer.cpp
+
+*/
+
+/**
+\brief Where the audio being visualised comes from.
+
+*/
+
+enum InputMode
+{
+    InputFile,      ///< A track analysed up front and played back.
+    InputDevice,    ///< The default recording device, such as line-in.
+    InputStdin      ///< Raw 16 bit PCM on standard input.
+};
+
+/**
+\class LiveAnalyzer
+
+\brief Analyses captured audio as it arrives and hands the newest band magnitudes to the renderer.
+
+A capture source pushes samples into a LiveCapture ring from its own thread.  The analysis
+thread keeps the last fftBuffer samples, and each time a hop has come in it windows them, runs
+the FFT and reduces the spectrum to bands the same way SpectrumAnalyzer does.  Its spectral flux
+goes through an OnsetDetector, so onsets are picked one frame after they arrive.  When it has
+fallen behind it skips straight to the newest whole hops rather than working through old
+frames, so the bars never lag further than one frame.
+
+The render thread takes the newest bands with getLatest.  After the buffer swap it calls
+markDisplayed, which measures the time from the arrival of the frame's newest sample to the
+frame being shown, the input to bar latency.  The time the device spends filling its own
+buffer before SFML sees a chunk is not counted.
+
+*/
+
+class LiveAnalyzer
+{
+private:
+    LiveCapture capture;            ///< Ring between the source and the analysis thread.
+    RecorderSource recorder;        ///< Line-in source.
+    StdinSource stdinSource;        ///< Standard input source.
+    LiveSource* source;             ///< The one in use, NULL until setInput.
+    unsigned int sampleRate;        ///< Frames per second.
+
+    BandLayout layout;              ///< How the spectrum is split into bands.
+    int bandCount;                  ///< Number of bands.
+    int hopSize;                    ///< Samples between frames.
+    WindowType windowType;          ///< Window applied to each frame.
+
+    std::thread worker;             ///< The analysis thread.
+    std::atomic<bool> running;      ///< Cleared to stop the analysis thread.
+
+    std::mutex publishMutex;            ///< Guards the published values below, never held by a capture thread.
+    std::vector<double> latestMags;     ///< Band magnitudes of the newest frame.
+    std::vector<double> bandMax;        ///< Decaying peak of each band.
+    std::int64_t latestCapture;         ///< Arrival time of the newest frame's last sample, microseconds.
+    std::atomic<int> framesPublished;   ///< Frames analysed since start.
+    std::atomic<int> onsetCount;        ///< Onsets picked since start.
+
+    std::int64_t shownCapture;      ///< Arrival time of the frame handed to the renderer, render thread only.
+    bool shownPending;              ///< True until that frame has been marked displayed.
+    double latencySum;              ///< Latency total since the last report, milliseconds.
+    double latencyWorst;            ///< Worst latency since the last report, milliseconds.
+    int latencyCount;               ///< Frames measured since the last report.
+
+    void run();
+
+    LiveAnalyzer(const LiveAnalyzer&);
+    LiveAnalyzer& operator=(const LiveAnalyzer&);
+
+public:
+    LiveAnalyzer();
+    ~LiveAnalyzer();
+
+    void setInput(InputMode mode, unsigned int rate);
+    void setBandLayout(const BandLayout& bands);
+    void setHopSize(int hop);
+    void setWindow(WindowType type);
+
+    bool start();
+    void pause();
+    bool isRunning() const;
+
+    int getBandCount() const;
+    int getHopSize() const;
+    unsigned int getSampleRate() const;
+    int getFramesPublished() const;
+    int getOnsetCount() const;
+    std::uint64_t getDropped() const;
+
+    bool getLatest(double* mags);
+    void getMaxMag(double* mags);
+    void markDisplayed();
+    bool getLatency(double* mean, double* worst);
+};
+
+#endif // LIVEANALYZER_H_INCLUDED
@@ -0,0 +1,345 @@
+#include "LiveCapture.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+/**
+\file LiveCapture.cpp
+\brief Capture sources for live mode and the ring they feed.
+
+*/
+
+/**
+\brief Constructor
+
+\param capacity --- the least number of samples the ring must hold.
+
+*/
+
+LiveCapture::LiveCapture(std::size_t capacity) : ring(capacity), stamps(1024)
+{
+    pushed = 0;
+    popped = 0;
+    dropped.store(0, std::memory_order_relaxed);
+}
+
+/**
+\brief Producer side, queues a chunk of samples and stamps it with the time.
+
+\param in --- mono samples.
+\param count --- number of samples.
+
+*/
+
+void LiveCapture::push(const std::int16_t* in, std::size_t count)
+{
+    std::size_t taken = ring.push(in, count);
+    if (taken < count)
+        dropped.fetch_add(count - taken, std::memory_order_relaxed);
+
+    pushed += taken;
+
+    CaptureStamp stamp;
+    stamp.end = pushed;
+    stamp.time = nowMicros();
+    stamps.push(stamp); // if this one is lost the next stamp covers these samples
+}
+
+/**
+\brief Consumer side, the number of samples waiting.
+
+*/
+
+std::size_t LiveCapture::available() const
+{
+    return ring.available();
+}
+
+/**
+\brief Consumer side, takes up to count samples.
+
+\param out --- count slots, or NULL to skip the samples.
+\param count --- the most samples to take.
+
+\return The number taken.
+
+*/
+
+std::size_t LiveCapture::pop(std::int16_t* out, std::size_t count)
+{
+    std::size_t taken = ring.pop(out, count);
+    popped += taken;
+    return taken;
+}
+
+/**
+\brief Consumer side, the number of samples taken so far.
+
+*/
+
+std::uint64_t LiveCapture::getPopped() const
+{
+    return popped;
+}
+
+/**
+\brief Consumer side, when a sample arrived.
+
+\param sample --- a count of samples, the sample asked about is the one before it.
+\param time --- output, the steady clock time of the chunk holding that sample.
+
+\return False if the chunk's stamp has not been pushed yet.
+
+Stamps for chunks wholly before sample are thrown away, so ask about increasing samples.
+
+*/
+
+bool LiveCapture::getCaptureTime(std::uint64_t sample, std::int64_t& time)
+{
+    CaptureStamp stamp;
+    while (stamps.peek(stamp))
+    {
+        if (stamp.end >= sample)
+        {
+            time = stamp.time;
+            return true;
+        }
+        stamps.pop(NULL, 1);
+    }
+    return false;
+}
+
+/**
+\brief Returns the number of samples lost because the ring was full.
+
+*/
+
+std::uint64_t LiveCapture::getDropped() const
+{
+    return dropped.load(std::memory_order_relaxed);
+}
+
+/**
+\brief Steady clock time in microseconds.
+
+*/
+
+std::int64_t LiveCapture::nowMicros()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+\brief Constructor
+
+\param target --- the capture the recorded samples go to.
+
+*/
+
+RecorderSource::RecorderSource(LiveCapture& target) : capture(target)
+{
+    setProcessingInterval(sf::milliseconds(5)); // SFML's default is 100 ms, far too coarse for the bars
+}
+
+/**
+\brief Destructor
+
+SFML requires a recorder to be stopped before the derived part goes away.
+
+*/
+
+RecorderSource::~RecorderSource()
+{
+    sf::SoundRecorder::stop();
+}
+
+/**
+\brief Starts recording from the default device.
+
+\return False if there is no recording device or it could not be opened.
+
+*/
+
+bool RecorderSource::start(unsigned int rate)
+{
+    if (!sf::SoundRecorder::isAvailable())
+    {
+        std::cerr << "No audio capture device is available." << std::endl;
+        return false;
+    }
+    return sf::SoundRecorder::start(rate);
+}
+
+/**
+\brief Stops recording.
+
+*/
+
+void RecorderSource::stop()
+{
+    sf::SoundRecorder::stop();
+}
+
+/**
+\brief Called by SFML on its recording thread with each new chunk.
+
+Only hands the chunk to the ring, nothing here allocates or waits.
+
+*/
+
+bool RecorderSource::onProcessSamples(const sf::Int16* samples, std::size_t sampleCount)
+{
+    capture.push(samples, sampleCount);
+    return true;
+}
+
+/**
+\brief Waits up to a few milliseconds for data on standard input.
+
+\return True if a read would not block, or if that cannot be told.
+
+*/
+
+static bool waitForStdin(int ms)
+{
+#ifdef _WIN32
+    DWORD waiting = 0;
+    if (!PeekNamedPipe(GetStdHandle(STD_INPUT_HANDLE), NULL, 0, NULL, &waiting, NULL))
+        return true; // not a pipe, such as a redirected file, reads do not block for long
+    if (waiting == 0)
+        Sleep(ms);
+    return waiting > 0;
+#else
+    struct pollfd fd;
+    fd.fd = 0;
+    fd.events = POLLIN;
+    fd.revents = 0;
+    return poll(&fd, 1, ms) != 0;
+#endif
+}
+
+/**
+\brief Constructor
+
+\param target --- the capture the samples go to.
+
+The reader thread is started by the first call to start.
+
+*/
+
+StdinSource::StdinSource(LiveCapture& target) : capture(target)
+{
+    sampleRate = 44100;
+    accepting.store(false);
+    quit.store(false);
+    restartPacing.store(true);
+}
+
+/**
+\brief Destructor
+
+The reader never sleeps in a read for long, so it sees quit and the join returns.
+
+*/
+
+StdinSource::~StdinSource()
+{
+    quit.store(true);
+    if (reader.joinable())
+        reader.join();
+}
+
+/**
+\brief Starts passing stdin samples on, starting the reader on the first call.
+
+*/
+
+bool StdinSource::start(unsigned int rate)
+{
+    restartPacing.store(true);
+    accepting.store(true);
+
+    if (!reader.joinable())
+    {
+        sampleRate = (rate > 0) ? rate : 44100;
+#ifdef _WIN32
+        _setmode(_fileno(stdin), _O_BINARY);
+#endif
+        reader = std::thread(&StdinSource::readLoop, this);
+    }
+    return true;
+}
+
+/**
+\brief Stops passing samples on, stdin is still drained so the writer does not stall.
+
+*/
+
+void StdinSource::stop()
+{
+    accepting.store(false);
+}
+
+/**
+\brief Reader thread, reads stdin in small chunks until it ends.
+
+*/
+
+void StdinSource::readLoop()
+{
+    const std::size_t chunkFrames = 256; // about 6 ms at 44.1 kHz
+    std::vector<std::int16_t> chunk(chunkFrames);
+    std::size_t have = 0; // bytes of chunk filled
+
+    std::chrono::steady_clock::time_point paceStart;
+    std::uint64_t paceFrames = 0;
+
+    while (!quit.load())
+    {
+        if (!waitForStdin(5))
+            continue;
+
+#ifdef _WIN32
+        int got = _read(0, (char*) &chunk[0] + have, (unsigned) (chunk.size() * 2 - have));
+#else
+        ssize_t got = read(0, (char*) &chunk[0] + have, chunk.size() * 2 - have);
+#endif
+        if (got <= 0)
+            break; // end of input
+        have += got;
+
+        std::size_t frames = have / 2;
+        if (frames == 0)
+            continue;
+
+        if (accepting.load())
+        {
+            if (restartPacing.exchange(false))
+            {
+                paceStart = std::chrono::steady_clock::now();
+                paceFrames = 0;
+            }
+
+            // Hold input that comes faster than real time back to the sample rate.
+            paceFrames += frames;
+            std::this_thread::sleep_until(paceStart + std::chrono::microseconds(paceFrames * 1000000 / sampleRate));
+
+            capture.push(&chunk[0], frames);
+        }
+
+        // Keep an odd trailing byte for the next read.
+        memmove(&chunk[0], (char*) &chunk[0] + frames * 2, have - frames * 2);
+        have -= frames * 2;
+    }
+}
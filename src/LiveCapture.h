@@ -0,0 +1,138 @@
+#ifndef LIVECAPTURE_H_INCLUDED
+#define LIVECAPTURE_H_INCLUDED
+
+#include <SFML/Audio.hpp>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "SpscRing.h"
+
+/**
+\file LiveCapture.h
+\brief Header file for LiveCapture.cpp
+
+*/
+
+/**
+\brief Marks when the samples up to a point arrived.
+
+*/
+
+struct CaptureStamp
+{
+    std::uint64_t end;  ///< Samples pushed so far, including the chunk this stamp is for.
+    std::int64_t time;  ///< Steady clock time the chunk arrived, in microseconds.
+};
+
+/**
+\class LiveCapture
+
+\brief The hand over from a capture thread to the analysis thread.
+
+Mono 16 bit samples go through one SpscRing and a CaptureStamp per pushed chunk through another,
+so the analysis can tell how long ago the newest sample of a frame came in.  push is the only
+producer call and never allocates, locks or blocks, if the analysis falls a whole ring behind
+the newest samples are dropped and counted.
+
+*/
+
+class LiveCapture
+{
+private:
+    SpscRing<std::int16_t> ring;            ///< The samples.
+    SpscRing<CaptureStamp> stamps;          ///< One stamp per pushed chunk.
+    std::uint64_t pushed;                   ///< Samples accepted, producer only.
+    std::uint64_t popped;                   ///< Samples taken, consumer only.
+    std::atomic<std::uint64_t> dropped;     ///< Samples lost to a full ring.
+
+public:
+    explicit LiveCapture(std::size_t capacity);
+
+    void push(const std::int16_t* in, std::size_t count);
+
+    std::size_t available() const;
+    std::size_t pop(std::int16_t* out, std::size_t count);
+    std::uint64_t getPopped() const;
+    bool getCaptureTime(std::uint64_t sample, std::int64_t& time);
+    std::uint64_t getDropped() const;
+
+    static std::int64_t nowMicros();
+};
+
+/**
+\class LiveSource
+
+\brief Something that feeds a LiveCapture from its own thread.
+
+*/
+
+class LiveSource
+{
+public:
+    virtual ~LiveSource() {}
+
+    virtual bool start(unsigned int rate) = 0;
+    virtual void stop() = 0;
+};
+
+/**
+\class RecorderSource
+
+\brief Feeds a LiveCapture from the default recording device, usually line-in.
+
+*/
+
+class RecorderSource : public LiveSource, private sf::SoundRecorder
+{
+private:
+    LiveCapture& capture;   ///< Where the samples go.
+
+    virtual bool onProcessSamples(const sf::Int16* samples, std::size_t sampleCount);
+
+public:
+    explicit RecorderSource(LiveCapture& target);
+    ~RecorderSource();
+
+    virtual bool start(unsigned int rate);
+    virtual void stop();
+};
+
+/**
+\class StdinSource
+
+\brief Feeds a LiveCapture from raw signed 16 bit little endian PCM on standard input.
+
+For testing without audio hardware, for example
+
+~~~~~~~~~~~~~~~{.sh}
+ffmpeg -i song.flac -f s16le -ac 1 -ar 44100 - | ./fft_SFML --stdin
+~~~~~~~~~~~~~~~
+
+The input must be mono.  Input that arrives faster than real time, such as a file, is held
+back to the sample rate so the bars move with the music.
+
+*/
+
+class StdinSource : public LiveSource
+{
+private:
+    LiveCapture& capture;           ///< Where the samples go.
+    unsigned int sampleRate;        ///< Frames per second, for pacing.
+    std::thread reader;             ///< Reads stdin until it ends or the source is destroyed.
+    std::atomic<bool> accepting;    ///< False while stopped, samples read then are thrown away.
+    std::atomic<bool> quit;         ///< Set by the destructor.
+    std::atomic<bool> restartPacing; ///< Set by start so a pause does not count as time in hand.
+
+    void readLoop();
+
+public:
+    explicit StdinSource(LiveCapture& target);
+    ~StdinSource();
+
+    virtual bool start(unsigned int rate);
+    virtual void stop();
+};
+
+#endif // LIVECAPTURE_H_INCLUDED
@@ -1,4 +1,5 @@
 #include "LoadShaders.h"
+#include "Tracer.h"
 
 /**
 \file LoadShaders.cpp
@@ -231,6 +232,7 @@ shader to be loaded into a shader program.
 
 GLuint LoadShadersFromFile(ShaderInfo* shaders)
 {
+    TRACE_SCOPE("LoadShadersFromFile");
     if (shaders == NULL)
         return 0;
 
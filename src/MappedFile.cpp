@@ -0,0 +1,261 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/**
+\file MappedFile.cpp
+\brief File mapping, mmap on POSIX and MapViewOfFile on Windows.
+
+*/
+
+/**
+\brief Constructor, nothing is mapped.
+
+*/
+
+MappedFile::MappedFile()
+{
+    mapped = NULL;
+    length = 0;
+    writable = false;
+#ifdef _WIN32
+    fileHandle = NULL;
+    mappingHandle = NULL;
+#endif
+}
+
+/**
+\brief Destructor, unmaps the file.
+
+*/
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+/**
+\brief Maps a whole file read-only.
+
+\param path --- the file to map.
+
+\return False if the file could not be opened or mapped, or is empty.
+
+*/
+
+bool MappedFile::open(const std::string& path)
+{
+    close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping == NULL)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (view == NULL)
+    {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    fileHandle = file;
+    mappingHandle = mapping;
+    mapped = (const unsigned char*) view;
+    length = (std::size_t) fileSize.QuadPart;
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    void* view = mmap(NULL, (std::size_t) info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // the mapping keeps its own reference to the file
+    if (view == MAP_FAILED)
+        return false;
+
+    mapped = (const unsigned char*) view;
+    length = (std::size_t) info.st_size;
+#endif
+
+    return true;
+}
+
+/**
+\brief Creates a file of zeros and maps it for reading and writing.
+
+\param path --- the file to create, replaced if it is already there.
+\param size --- its size in bytes.
+
+The file is sparse where the system allows it, pages cost disk space as they are written.  On
+Windows the file is opened with FILE_SHARE_DELETE, so it can be renamed while it is mapped.
+
+\return False if the file could not be created or mapped.
+
+*/
+
+bool MappedFile::create(const std::string& path, std::size_t size)
+{
+    close();
+    if (size == 0)
+        return false;
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL,
+                              CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    ULARGE_INTEGER fileSize;
+    fileSize.QuadPart = size;
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READWRITE, fileSize.HighPart, fileSize.LowPart, NULL);
+    if (mapping == NULL)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    void* view = MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, 0);
+    if (view == NULL)
+    {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    fileHandle = file;
+    mappingHandle = mapping;
+#else
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return false;
+
+    if (ftruncate(fd, (off_t) size) != 0)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    void* view = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (view == MAP_FAILED)
+        return false;
+#endif
+
+    mapped = (const unsigned char*) view;
+    length = size;
+    writable = true;
+    return true;
+}
+
+/**
+\brief Writes the pages of a created mapping back to the file and waits for them to reach the disk.
+
+\return False if nothing writable is mapped or the pages could not be written.
+
+*/
+
+bool MappedFile::flush()
+{
+    if (!writable)
+        return false;
+#ifdef _WIN32
+    return FlushViewOfFile(mapped, 0) != 0 && FlushFileBuffers((HANDLE) fileHandle) != 0;
+#else
+    return msync((void*) mapped, length, MS_SYNC) == 0;
+#endif
+}
+
+/**
+\brief Unmaps the file, if one is mapped.
+
+*/
+
+void MappedFile::close()
+{
+    if (mapped == NULL)
+        return;
+
+#ifdef _WIN32
+    UnmapViewOfFile(mapped);
+    CloseHandle((HANDLE) mappingHandle);
+    CloseHandle((HANDLE) fileHandle);
+    fileHandle = NULL;
+    mappingHandle = NULL;
+#else
+    munmap((void*) mapped, length);
+#endif
+
+    mapped = NULL;
+    length = 0;
+    writable = false;
+}
+
+/**
+\brief Returns true if a file is mapped.
+
+*/
+
+bool MappedFile::isOpen() const
+{
+    return mapped != NULL;
+}
+
+/**
+\brief Returns the first byte of the mapping.
+
+*/
+
+const unsigned char* MappedFile::data() const
+{
+    return mapped;
+}
+
+/**
+\brief Returns the first byte of a mapping made by create, or NULL if the mapping is read-only.
+
+*/
+
+unsigned char* MappedFile::writableData()
+{
+    return writable ? (unsigned char*) mapped : NULL;
+}
+
+/**
+\brief Returns the size of the mapping in bytes.
+
+*/
+
+std::size_t MappedFile::size() const
+{
+    return length;
+}
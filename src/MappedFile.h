@@ -0,0 +1,54 @@
+#ifndef MAPPEDFILE_H_INCLUDED
+#define MAPPEDFILE_H_INCLUDED
+
+#include <cstddef>
+#include <string>
+
+/**
+\file MappedFile.h
+\brief Header file for MappedFile.cpp
+
+*/
+
+/**
+\class MappedFile
+
+\brief A memory mapping of a whole file, read-only unless the file is made with create.
+
+The mapping lasts until close is called or the object is destroyed.  Pages are read in by the
+operating system as they are touched, so mapping a large file costs no memory up front.  Pages
+written through a created mapping are written back by the operating system too, so a large file
+can be filled without holding it in memory.
+
+*/
+
+class MappedFile
+{
+private:
+    const unsigned char* mapped;    ///< Start of the mapping, NULL when nothing is open.
+    std::size_t length;             ///< Size of the mapping in bytes.
+    bool writable;                  ///< The mapping was made by create and can be written.
+#ifdef _WIN32
+    void* fileHandle;               ///< Handle of the open file.
+    void* mappingHandle;            ///< Handle of the file mapping object.
+#endif
+
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+
+public:
+    MappedFile();
+    ~MappedFile();
+
+    bool open(const std::string& path);
+    bool create(const std::string& path, std::size_t size);
+    bool flush();
+    void close();
+
+    bool isOpen() const;
+    const unsigned char* data() const;
+    unsigned char* writableData();
+    std::size_t size() const;
+};
+
+#endif // MAPPEDFILE_H_INCLUDED
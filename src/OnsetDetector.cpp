@@ -0,0 +1,136 @@
+#include "OnsetDetector.h"
+
+#include <math.h>
+
+/**
+\file OnsetDetector.cpp
+\brief Adaptive median threshold and peak picking over spectral flux.
+
+*/
+
+/**
+\brief Constructor
+
+Set up for the default hop at 44.1 kHz, call setFrameTime for anything else.
+
+*/
+
+OnsetDetector::OnsetDetector()
+{
+    sensitivity = OnsetSensitivity;
+    setFrameTime((double) AnalysisHopSize / 44100);
+}
+
+/**
+\brief Sizes the median window and the gap between onsets for a frame rate, and resets.
+
+\param seconds --- time between frames, the hop over the sample rate.
+
+*/
+
+void OnsetDetector::setFrameTime(double seconds)
+{
+    int window = (seconds > 0) ? (int) (OnsetWindowSeconds / seconds + 0.5) : 1;
+    int gap = (seconds > 0) ? (int) (OnsetMinGapSeconds / seconds + 0.5) : 1;
+
+    windowFrames = (window < 3) ? 3 : (window > 64 ? 64 : window);
+    minGap = (gap < 1) ? 1 : gap;
+    envelopeDecay = (seconds > 0) ? pow(0.5, seconds / OnsetWindowSeconds) : 0;
+    reset();
+}
+
+/**
+\brief Forgets every value pushed so far.
+
+*/
+
+void OnsetDetector::reset()
+{
+    history.assign(windowFrames, 0);
+    sorted.clear();
+    sorted.reserve(windowFrames);
+    historyNext = 0;
+    historySize = 0;
+
+    mean = 0;
+    envelope = 0;
+    previous = 0;
+    beforePrevious = 0;
+    framesSinceOnset = minGap;
+    frames = 0;
+}
+
+/**
+\brief Puts a value in the median window, dropping the oldest once it is full.
+
+*/
+
+void OnsetDetector::addToWindow(double flux)
+{
+    if (historySize == windowFrames)
+    {
+        double oldest = history[historyNext];
+        for (int i = 0; i < historySize; i++)
+        {
+            if (sorted[i] == oldest)
+            {
+                sorted.erase(sorted.begin() + i);
+                break;
+            }
+        }
+    }
+    else
+        historySize++;
+
+    history[historyNext] = flux;
+    historyNext = (historyNext + 1) % windowFrames;
+
+    int i = (int) sorted.size();
+    sorted.push_back(flux);
+    while (i > 0 && sorted[i - 1] > flux)
+    {
+        sorted[i] = sorted[i - 1];
+        i--;
+    }
+    sorted[i] = flux;
+}
+
+/**
+\brief Takes the flux of the next frame.
+
+\param flux --- half-wave rectified spectral flux of the frame.
+
+\return True if the frame before this one is an onset.
+
+*/
+
+bool OnsetDetector::push(double flux)
+{
+    bool onset = false;
+    framesSinceOnset++;
+
+    if (frames > 0)
+    {
+        addToWindow(previous);
+        double median = sorted[historySize / 2];
+        double threshold = sensitivity * median + 0.1 * mean;
+
+        if (previous > threshold && previous >= envelope && previous > beforePrevious && previous >= flux
+            && framesSinceOnset > minGap)
+        {
+            onset = true;
+            framesSinceOnset = 0;
+        }
+
+        double decayed = envelopeDecay * envelope + (1 - envelopeDecay) * previous;
+        envelope = (previous > decayed) ? previous : decayed;
+    }
+
+    // About ten seconds of memory at a few hundred frames per second.
+    mean += (flux - mean) / ((frames < 2048) ? frames + 1 : 2048);
+
+    beforePrevious = previous;
+    previous = flux;
+    frames++;
+    return onset;
+}
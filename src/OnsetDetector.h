@@ -0,0 +1,61 @@
+#ifndef ONSETDETECTOR_H_INCLUDED
+#define ONSETDETECTOR_H_INCLUDED
+
+#include <vector>
+
+#include "ProgramDefines.h"
+
+/**
+\file OnsetDetector.h
+\brief Header file for OnsetDetector.cpp
+
+*/
+
+/**
+\class OnsetDetector
+
+\brief Picks onsets out of a stream of spectral flux values, one value per frame.
+
+A frame is an onset when its flux is a local maximum, is above OnsetSensitivity times the median
+of the last OnsetWindowSeconds of flux plus a tenth of the long run mean, is not below an
+envelope of the recent flux that halves every OnsetWindowSeconds, and is at least
+OnsetMinGapSeconds after the last onset.  The envelope keeps the ripple on the tail of a loud
+note from counting as more onsets.  Deciding on a local maximum needs the next frame, so
+push reports on the frame before the one it is given.
+
+Every push does a fixed amount of work, the median window is kept sorted by insertion, so the
+detector runs the same over a whole track or over live input.
+
+*/
+
+class OnsetDetector
+{
+private:
+    int windowFrames;               ///< Frames in the median window.
+    int minGap;                     ///< Fewest frames between two onsets.
+    double sensitivity;             ///< Multiple of the median the flux must pass.
+    double envelopeDecay;           ///< Per frame decay of the envelope.
+
+    std::vector<double> history;    ///< The last windowFrames flux values, oldest first in ring order.
+    std::vector<double> sorted;     ///< The same values in order, for the median.
+    int historyNext;                ///< Ring slot the next value goes in.
+    int historySize;                ///< Values in the ring so far.
+
+    double mean;                    ///< Long run mean of the flux.
+    double envelope;                ///< Decaying envelope of the flux before the frame being decided.
+    double previous;                ///< Flux of the frame being decided.
+    double beforePrevious;          ///< Flux of the frame before that.
+    int framesSinceOnset;           ///< Frames since the last onset.
+    int frames;                     ///< Values pushed since reset.
+
+    void addToWindow(double flux);
+
+public:
+    OnsetDetector();
+
+    void setFrameTime(double seconds);
+    void reset();
+    bool push(double flux);
+};
+
+#endif // ONSETDETECTOR_H_INCLUDED
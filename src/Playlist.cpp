@@ -0,0 +1,220 @@
+#include "Playlist.h"
+
+#include <iostream>
+
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(__APPLE__)
+#include <pthread.h>
+#else
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "Tracer.h"
+
+/**
+\file Playlist.cpp
+\brief Opens and analyses the next tracks while one plays.
+
+*/
+
+/**
+\brief Lowers the calling thread below the render and audio threads.
+
+On Linux and macOS the threads it starts afterwards, the analysis workers and decoders, start at
+the same priority.  On Windows only the calling thread is lowered.
+
+*/
+
+static void lowerThreadPriority()
+{
+#ifdef _WIN32
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
+#elif defined(__APPLE__)
+    pthread_set_qos_class_self_np(QOS_CLASS_UTILITY, 0);
+#else
+    setpriority(PRIO_PROCESS, (id_t) syscall(SYS_gettid), PlaylistPrepareNice); // a nice value is per thread on Linux
+#endif
+}
+
+/**
+\brief Constructor, there is nothing to prepare.
+
+*/
+
+Playlist::Playlist()
+{
+    nextPath = 0;
+    aheadLimit = 1;
+    quit = false;
+}
+
+/**
+\brief Destructor, stops the thread and deletes every track still held.
+
+*/
+
+Playlist::~Playlist()
+{
+    stop();
+}
+
+/**
+\brief Starts preparing the tracks from one on.
+
+\param trackPaths --- every track of the playlist.
+\param first --- the first track to prepare, the ones before are the caller's.
+\param from --- the analyzer whose settings every track is analysed with, copied before this returns.
+\param ahead --- most tracks prepared and not yet taken, at least 1.
+
+*/
+
+void Playlist::start(const std::vector<std::string>& trackPaths, std::size_t first, const SpectrumAnalyzer& from, std::size_t ahead)
+{
+    stop();
+    paths = trackPaths;
+    nextPath = first;
+    aheadLimit = (ahead > 0) ? ahead : 1;
+    settings.copySettings(from);
+    ready.reserve(aheadLimit);
+    quit = false;
+    if (nextPath < paths.size())
+        thread = std::thread(&Playlist::prepareLoop, this);
+}
+
+/**
+\brief Stops the thread and deletes every track not taken, or retired and not yet deleted.
+
+*/
+
+void Playlist::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    wake.notify_all();
+    if (thread.joinable())
+        thread.join();
+
+    for (std::size_t i = 0; i < ready.size(); i++)
+        delete ready[i];
+    for (std::size_t i = 0; i < retired.size(); i++)
+        delete retired[i];
+    ready.clear();
+    retired.clear();
+}
+
+/**
+\brief The preparing thread, deletes retired tracks and prepares tracks while the queue has room.
+
+The mutex is released while a track is opened or deleted, so the player never waits on either.
+
+*/
+
+void Playlist::prepareLoop()
+{
+    TRACE_THREAD_NAME("playlist");
+    lowerThreadPriority();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;)
+    {
+        while (!quit && retired.empty() && (ready.size() >= aheadLimit || nextPath >= paths.size()))
+            wake.wait(lock);
+        if (quit)
+            return;
+
+        if (!retired.empty())
+        {
+            PreparedTrack* old = retired.back();
+            retired.pop_back();
+            lock.unlock();
+            delete old;
+            lock.lock();
+            continue;
+        }
+
+        std::string path = paths[nextPath++];
+        lock.unlock();
+
+        PreparedTrack* track = new PreparedTrack;
+        bool opened;
+        {
+            TRACE_SCOPE("prepare track");
+            opened = track->open(path);
+            if (opened)
+            {
+                track->getAnalyzer().copySettings(settings);
+                track->startAnalysis(); // its threads start at this thread's priority
+            }
+        }
+        if (!opened)
+        {
+            std::cerr << "Could not open " << path << ", skipping it" << std::endl;
+            delete track;
+        }
+
+        lock.lock();
+        if (opened)
+            ready.push_back(track);
+    }
+}
+
+/**
+\brief Returns the next prepared track without taking it, or NULL if none is ready yet.
+
+Its analysis may still be running, the frames done so far can be read.  The track stays the
+playlist's until it is taken.
+
+*/
+
+PreparedTrack* Playlist::peekNext()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return ready.empty() ? NULL : ready.front();
+}
+
+/**
+\brief Takes the next prepared track, or returns NULL if none is ready yet.
+
+The caller owns the track and gives it back with retire once it is done with it.
+
+*/
+
+PreparedTrack* Playlist::takeNext()
+{
+    PreparedTrack* track = NULL;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!ready.empty())
+        {
+            track = ready.front();
+            ready.erase(ready.begin());
+        }
+    }
+    wake.notify_one();
+    return track;
+}
+
+/**
+\brief Hands back a track to be deleted on the preparing thread.
+
+\param track --- a track nothing reads any more, taken or the caller's own.  NULL is ignored.
+
+A track retired to a playlist that was never started is deleted by stop.
+
+*/
+
+void Playlist::retire(PreparedTrack* track)
+{
+    if (track == NULL)
+        return;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        retired.push_back(track);
+    }
+    wake.notify_one();
+}
@@ -0,0 +1,69 @@
+#ifndef PLAYLIST_H_INCLUDED
+#define PLAYLIST_H_INCLUDED
+
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "PreparedTrack.h"
+#include "SpectrumAnalyzer.h"
+
+/**
+\file Playlist.h
+\brief Header file for Playlist.cpp
+
+*/
+
+/**
+\class Playlist
+
+\brief Prepares the tracks after the one playing on a low priority thread.
+
+The thread opens each track in order and starts its analysis with the settings given to start,
+then queues it.  At most aheadLimit tracks are queued, the thread waits for the player to take
+one before preparing the next, so the memory held by the playlist stays that of aheadLimit
+tracks whatever its length.  A track that cannot be opened is skipped.
+
+The player takes the queued tracks in order without waiting for anything slow, and hands the
+tracks it is done with back to be deleted on the thread, so unmapping a file or stopping an
+analysis never holds up the caller either.
+
+*/
+
+class Playlist
+{
+private:
+    std::vector<std::string> paths;         ///< Every track, in order.
+    std::size_t nextPath;                   ///< Next of paths to prepare.
+    std::size_t aheadLimit;                 ///< Most tracks queued at once.
+    SpectrumAnalyzer settings;              ///< Analysis settings for every track, never analyses itself.
+
+    std::vector<PreparedTrack*> ready;      ///< Prepared tracks waiting to be taken, in order.
+    std::vector<PreparedTrack*> retired;    ///< Tracks the player is done with, to delete.
+    bool quit;                              ///< Asks the thread to finish.
+
+    std::mutex mutex;                       ///< Guards everything from ready on.
+    std::condition_variable wake;           ///< Signalled when a track is taken or retired, and on stop.
+    std::thread thread;                     ///< The preparing thread.
+
+    void prepareLoop();
+
+    Playlist(const Playlist&);
+    Playlist& operator=(const Playlist&);
+
+public:
+    Playlist();
+    ~Playlist();
+
+    void start(const std::vector<std::string>& trackPaths, std::size_t first, const SpectrumAnalyzer& from, std::size_t ahead);
+    void stop();
+
+    PreparedTrack* peekNext();
+    PreparedTrack* takeNext();
+    void retire(PreparedTrack* track);
+};
+
+#endif // PLAYLIST_H_INCLUDED
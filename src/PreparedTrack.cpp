@@ -0,0 +1,382 @@
+#include "PreparedTrack.h"
+
+#include "Tracer.h"
+
+/**
+\file PreparedTrack.cpp
+\brief One track's samples and analysis, opened ahead of its turn to play.
+
+*/
+
+/**
+\brief Constructor, no file is open.
+
+*/
+
+PreparedTrack::PreparedTrack()
+{
+    samples.data = NULL;
+    samples.format = SampleInt16;
+    samples.count = 0;
+    samples.channels = 1;
+    sampleRate = 0;
+}
+
+/**
+\brief Destructor, stops the analysis before the samples go away.
+
+*/
+
+PreparedTrack::~PreparedTrack()
+{
+    stop();
+}
+
+/**
+\brief Opens a sound file and points the analyzer at its samples.
+
+\param audioPath --- a WAV file, mapped, or any other format SFML reads, decoded ahead of playback.
+
+Nothing is decoded up front.  The analyzer's cache folder is set, the rest of its settings are
+left to the caller.
+
+\return False if the file could not be opened, the track then has no samples.
+
+*/
+
+bool PreparedTrack::open(const std::string& audioPath)
+{
+    TRACE_SCOPE("open track");
+    path = audioPath;
+    if (wavFile.open(path))
+    {
+        samples = wavFile.getSamples(); // read in place
+        sampleRate = wavFile.getSampleRate();
+    }
+    else if (decoder.open(path, DecodeBlockFrames, DecodeBlockCount))
+    {
+        samples.data = NULL; // nothing to read in place, playback and analysis go through decoders
+        samples.format = SampleInt16;
+        samples.count = decoder.getSampleCount();
+        samples.channels = decoder.getChannelCount();
+        sampleRate = decoder.getSampleRate();
+    }
+
+    if (isDecoded())
+        analyzer.setStreamFormat(samples.count / samples.channels, samples.channels, sampleRate, SinglePrecisionAnalysis);
+    else if (sampleRate > 0)
+        analyzer.setSamples(samples, sampleRate, SinglePrecisionAnalysis);
+    analyzer.setCacheDirectory(AnalysisCacheDirectory); // warm starts skip the FFT
+    return isOpen();
+}
+
+/**
+\brief Returns true if the file was opened.
+
+*/
+
+bool PreparedTrack::isOpen() const
+{
+    return sampleRate > 0;
+}
+
+/**
+\brief Returns true when the track is decoded a block at a time rather than mapped.
+
+*/
+
+bool PreparedTrack::isDecoded() const
+{
+    return decoder.isOpen();
+}
+
+/**
+\brief Returns the path the track was opened from.
+
+*/
+
+const std::string& PreparedTrack::getPath() const
+{
+    return path;
+}
+
+/**
+\brief Returns the samples, with no data when the track is decoded.
+
+*/
+
+const SampleSpan& PreparedTrack::getSamples() const
+{
+    return samples;
+}
+
+/**
+\brief Returns the frames per second.
+
+*/
+
+unsigned int PreparedTrack::getSampleRate() const
+{
+    return sampleRate;
+}
+
+/**
+\brief Returns the decoder of a decoded track, to play it from.
+
+*/
+
+DecodePipeline& PreparedTrack::getDecoder()
+{
+    return decoder;
+}
+
+/**
+\brief Returns the analyzer, to change its settings before startAnalysis.
+
+*/
+
+SpectrumAnalyzer& PreparedTrack::getAnalyzer()
+{
+    return analyzer;
+}
+
+/**
+\brief Draws the bars from a saved timeline instead of analysing the track.
+
+\param timelinePath --- a timeline written by saveTimeline.
+
+\return False if the file could not be opened, the track is then analysed as usual.
+
+*/
+
+bool PreparedTrack::openTimeline(const std::string& timelinePath)
+{
+    return timeline.open(timelinePath);
+}
+
+/**
+\brief Saves the finished analysis as a compact timeline.
+
+\param timelinePath --- the file to write.
+\param bits --- 8 or 16 bits per band value.
+\param view --- which view to save.
+
+\return False if there is nothing to save or the file could not be written.
+
+*/
+
+bool PreparedTrack::saveTimeline(const std::string& timelinePath, int bits, int view)
+{
+    return analyzer.saveTimeline(timelinePath, bits, view);
+}
+
+/**
+\brief Runs the analysis on a background thread.
+
+Threads the analysis starts are started from the calling thread and so take its priority where
+the system passes it on.  A decoded track is analysed as its pipeline decodes it, keyed by the
+file so a later launch maps the result back from the cache folder.
+
+*/
+
+void PreparedTrack::startAnalysis()
+{
+    if (timeline.isOpen() || !isOpen())
+        return;
+    if (isDecoded())
+        streamAnalyzer.start(analyzer, decoder, StreamAnalyzer::key(analyzer, path, SinglePrecisionAnalysis));
+    else
+        analyzer.startAnalysis();
+}
+
+/**
+\brief Stops a background analysis and waits for it.
+
+*/
+
+void PreparedTrack::stop()
+{
+    analyzer.stop();
+    streamAnalyzer.stop();
+}
+
+/**
+\brief Returns how many leading frames have been analysed.
+
+*/
+
+int PreparedTrack::getFramesReady()
+{
+    if (timeline.isOpen())
+        return timeline.getFrameCount();
+    return analyzer.getFramesReady();
+}
+
+/**
+\brief Returns true once every frame has been analysed, or a decoded track's analysis has failed.
+
+*/
+
+bool PreparedTrack::isAnalysisComplete()
+{
+    return timeline.isOpen() || analyzer.isAnalysisComplete() || streamAnalyzer.hasFailed();
+}
+
+/**
+\brief Copies the band magnitudes of one frame.
+
+\param frame --- the frame index.
+\param mags --- getBandCount() values to fill.
+\param view --- which view, from 0 to getViewCount() - 1.
+
+\return False if the frame has not been analysed yet.
+
+*/
+
+bool PreparedTrack::getFrameMags(int frame, double* mags, int view)
+{
+    if (timeline.isOpen())
+        return timeline.getFrame(frame, mags); // decoded straight from the mapping
+    return analyzer.getFrameMags(frame, mags, view);
+}
+
+/**
+\brief Returns the band magnitudes of one analysed frame where they lie, empty for a timeline.
+
+*/
+
+ValueSpan PreparedTrack::getFrame(int frame, int view)
+{
+    if (timeline.isOpen())
+    {
+        ValueSpan none = {NULL, 0, 1};
+        return none;
+    }
+    return analyzer.getFrame(frame, view);
+}
+
+/**
+\brief Returns the band magnitudes of a run of analysed frames where they lie.
+
+A timeline keeps its frames quantised, so a track read from one returns an empty span and its
+frames are read with getFrameMags.
+
+*/
+
+FrameSpan PreparedTrack::getFrames(int first, int count, int view)
+{
+    if (timeline.isOpen())
+    {
+        FrameSpan none = {NULL, 0, (std::size_t) getBandCount(), 1, 1};
+        return none;
+    }
+    return analyzer.getFrames(first, count, view);
+}
+
+/**
+\brief Returns the history of one band over the analysed frames, empty for a timeline.
+
+*/
+
+ValueSpan PreparedTrack::getBand(int band, int view)
+{
+    if (timeline.isOpen())
+    {
+        ValueSpan none = {NULL, 0, 1};
+        return none;
+    }
+    return analyzer.getBand(band, view);
+}
+
+/**
+\brief Copies the peak of each band over the whole track, or the frames done so far.
+
+*/
+
+void PreparedTrack::getMaxMag(double* mags, int view)
+{
+    if (timeline.isOpen())
+        timeline.getBandPeaks(mags);
+    else
+        analyzer.getMaxMag(mags, view);
+}
+
+/**
+\brief Returns the onsets in frames from to to, a timeline carries none.
+
+*/
+
+int PreparedTrack::countOnsets(int from, int to)
+{
+    if (timeline.isOpen())
+        return 0;
+    return analyzer.countOnsets(from, to);
+}
+
+/**
+\brief Returns the time per visual, the hop in seconds.
+
+*/
+
+float PreparedTrack::getTimePerVisual()
+{
+    if (timeline.isOpen())
+        return timeline.getHopSize() / (float) timeline.getSampleRate();
+    return analyzer.getTimePerVisual();
+}
+
+/**
+\brief Returns the number of analysis frames.
+
+*/
+
+int PreparedTrack::getNumFrames()
+{
+    if (timeline.isOpen())
+        return timeline.getFrameCount();
+    return analyzer.getNumFrames();
+}
+
+/**
+\brief Returns the number of bands per frame.
+
+*/
+
+int PreparedTrack::getBandCount()
+{
+    if (timeline.isOpen())
+        return timeline.getBandCount();
+    return analyzer.getBandCount();
+}
+
+/**
+\brief Returns the number of views, a timeline holds one.
+
+*/
+
+int PreparedTrack::getViewCount()
+{
+    if (timeline.isOpen())
+        return 1;
+    return analyzer.getViewCount();
+}
+
+/**
+\brief Returns the samples between frame starts.
+
+*/
+
+int PreparedTrack::getHopSize()
+{
+    return timeline.isOpen() ? timeline.getHopSize() : analyzer.getHopSize();
+}
+
+/**
+\brief Returns the samples per full frame.
+
+*/
+
+int PreparedTrack::getFrameLength()
+{
+    return timeline.isOpen() ? timeline.getFrameLength() : analyzer.getFrameLength();
+}
@@ -0,0 +1,85 @@
+#ifndef PREPAREDTRACK_H_INCLUDED
+#define PREPAREDTRACK_H_INCLUDED
+
+#include <cstdint>
+#include <string>
+
+#include "ProgramDefines.h"
+#include "SampleFormat.h"
+#include "WavFile.h"
+#include "DecodePipeline.h"
+#include "SpectrumAnalyzer.h"
+#include "SpectralTimeline.h"
+#include "StreamAnalyzer.h"
+
+/**
+\file PreparedTrack.h
+\brief Header file for PreparedTrack.cpp
+
+*/
+
+/**
+\class PreparedTrack
+
+\brief One track of the playlist, its samples ready to play and its analysis.
+
+A WAV file is mapped and analysed in place by a SpectrumAnalyzer.  Any other format is decoded
+ahead of playback by a DecodePipeline and the same SpectrumAnalyzer analyses each block the
+pipeline decodes, through a StreamAnalyzer.  Either way the frames below the analysis high-water
+mark can be read from any thread while the rest are still being analysed.
+
+Settings are changed on the thread that opened the track, before startAnalysis.
+
+*/
+
+class PreparedTrack
+{
+private:
+    std::string path;               ///< The sound file.
+    WavFile wavFile;                ///< Mapping of a WAV file.
+    DecodePipeline decoder;         ///< Decodes a file WavFile cannot read, ahead of playback.
+    SampleSpan samples;             ///< The samples of whichever of the two holds the audio.
+    unsigned int sampleRate;        ///< Frames per second, 0 if the file could not be opened.
+
+    SpectrumAnalyzer analyzer;      ///< Analyses the track, mapped or as it is decoded.
+    SpectralTimeline timeline;      ///< A saved analysis, when open the frames come from it instead of analyzer.
+    StreamAnalyzer streamAnalyzer;  ///< Feeds the decoded blocks of a decoded track to analyzer.
+
+    PreparedTrack(const PreparedTrack&);
+    PreparedTrack& operator=(const PreparedTrack&);
+
+public:
+    PreparedTrack();
+    ~PreparedTrack();
+
+    bool open(const std::string& audioPath);
+    bool isOpen() const;
+    bool isDecoded() const;
+    const std::string& getPath() const;
+    const SampleSpan& getSamples() const;
+    unsigned int getSampleRate() const;
+    DecodePipeline& getDecoder();
+    SpectrumAnalyzer& getAnalyzer();
+
+    bool openTimeline(const std::string& timelinePath);
+    bool saveTimeline(const std::string& timelinePath, int bits, int view);
+    void startAnalysis();
+    void stop();
+
+    int getFramesReady();
+    bool isAnalysisComplete();
+    bool getFrameMags(int frame, double* mags, int view);
+    ValueSpan getFrame(int frame, int view);
+    FrameSpan getFrames(int first, int count, int view);
+    ValueSpan getBand(int band, int view);
+    void getMaxMag(double* mags, int view);
+    int countOnsets(int from, int to);
+    float getTimePerVisual();
+    int getNumFrames();
+    int getBandCount();
+    int getViewCount();
+    int getHopSize();
+    int getFrameLength();
+};
+
+#endif // PREPAREDTRACK_H_INCLUDED
@@ -25,5 +25,102 @@ The file is simply for convenience so that multiple headers do not need to redef
 #define deg PI_DIV_180
 #define degf PI_DIV_180f
 #define fftBuffer 1024
+#define fftFramesPerBlock 256
+
+// Location of the FFTW wisdom files.  Plans measured on one run are reused on the next.
+#define fftWisdomPath "./fftw.wisdom"
+#define fftwfWisdomPath "./fftwf.wisdom"
+
+// Folder of finished analyses.  A track analysed once with the same settings is mapped back from
+// here on the next launch instead of being analysed again.  Set to "" to turn the cache off.
+#define AnalysisCacheDirectory "./analysis_cache"
+
+// The track played when none is given on the command line.
+#define DefaultTrackPath "./excitable.wav"
+
+// A track that is not a WAV file, such as FLAC or Ogg, is never decoded whole.  A decode thread
+// reads it ahead of playback into DecodeBlockCount blocks of DecodeBlockFrames frames that are
+// reused, and blocks still in the pool are played again after a seek without decoding.  The same
+// blocks are analysed as they are decoded, into a result in the cache folder, or a temporary file
+// removed with the track when the cache is off.  WAV files are mapped instead.
+#define DecodeBlockFrames 8192
+#define DecodeBlockCount 16
+
+// Given more than one track, they play in order as a playlist.  While one plays, a thread at low
+// priority, nice PlaylistPrepareNice on Linux, opens the next PlaylistPrepareAhead tracks and
+// analyses them with the first track's settings.  Each track follows the one before without a gap
+// when their sample rates and channels match.
+#define PlaylistPrepareAhead 1
+#define PlaylistPrepareNice 10
+
+// A SpectralTimeline file to draw the bars from instead of analysing the track, "" for none.
+#define TimelinePath ""
+
+// SinglePrecisionAnalysis keeps the samples as float and runs the analysis through fftwf, which
+// halves the memory traffic of the analysis.  Band peaks must stay within 1e-4 of the band's
+// overall peak of the double precision path, far finer than a bar can show.  Off until
+// "AnalysisBench --precision compare" passes with the FFTW build and settings in use.
+#define SinglePrecisionAnalysis false
+
+// AnalysisWindowType and AnalysisHopSize set up the short-time Fourier transform.  WindowRectangular
+// with a hop of fftBuffer is the original non-overlapping analysis, fftBuffer / 4 is 75% overlap.
+// AnalysisFrameRate, when above 0, sets the hop instead so there is one frame per display refresh.
+#define AnalysisWindowType WindowHann
+#define AnalysisHopSize (fftBuffer / 4)
+#define AnalysisFrameRate 0
+
+// DefaultBandScale and DefaultBandCount pick the bars drawn.  BandClassic is the original five
+// bands and ignores the count; the other BandScale values split 20 Hz - 20 kHz into the count.
+#define DefaultBandScale BandClassic
+#define DefaultBandCount 5
+
+// BandConstantQ takes DefaultBandCount as bins per octave and measures them with one long FFT per
+// frame and a sparse kernel.  The frame is as long as the lowest bin needs, up to ConstantQMaxFrame
+// samples, lower bins are shortened to fit and lose some of their resolution.
+#define ConstantQMaxFrame 65536
+
+// The bars follow a rise with the BarAttackSeconds time constant and a fall with BarReleaseSeconds.
+// The top of each bar is marked by a peak held for BarPeakHoldSeconds that then falls at
+// BarPeakFallPerSecond bar heights a second.  BarDecibelFloor below 0 draws the bars in decibels
+// down to that level under the band's peak, 0 keeps them linear.
+#define BarAttackSeconds 0.015
+#define BarReleaseSeconds 0.12
+#define BarPeakHoldSeconds 0.4
+#define BarPeakFallPerSecond 0.8
+#define BarDecibelFloor 0
+
+// AnalysisChannelMode is how a multichannel track is analysed.  ChannelDownmix analyses the mean of
+// the channels, ChannelSplit each channel and ChannelMidSide the mid and side of a stereo track.
+// With more than one view the bars are drawn as one row per view.
+#define AnalysisChannelMode ChannelDownmix
+
+// AnalysisResultLayout is how the band peaks of a track are kept.  ResultFrameMajor keeps each frame's
+// bands together, so the bars are read in place a frame at a time.  ResultBandMajor keeps each band's
+// history together for readers that walk one band over many frames, the bars then gather each frame.
+#define AnalysisResultLayout ResultFrameMajor
+
+// Onsets are picked from the spectral flux of each frame.  A frame is an onset when its flux peaks
+// above OnsetSensitivity times the median flux of the last OnsetWindowSeconds, and at least
+// OnsetMinGapSeconds after the one before.  Lower the sensitivity for more onsets.
+#define OnsetSensitivity 1.5
+#define OnsetWindowSeconds 0.1
+#define OnsetMinGapSeconds 0.05
+
+// The frame profiler keeps the phase times of the last ProfilerFrames frames, F8 saves them as CSV.
+// Its overlay, toggled with F7, graphs the last ProfilerGraphSeconds, ProfilerGraphMs high or more.
+#define ProfilerFrames 8192
+#define ProfilerGraphSeconds 4.0
+#define ProfilerGraphMs 33.3
+
+// Built with -DENABLE_TRACING, the startup and every frame are traced, see Tracer.h.  F9 and
+// quitting write the last TraceEventsPerThread events of each thread to TracePath.
+#define TraceEventsPerThread 65536
+#define TracePath "./trace.json"
+
+// Live mode, started with --live or --stdin, analyses mono input at LiveSampleRate as it arrives.
+// The bars are scaled by a running peak per band that halves every LivePeakHalfLife seconds, so a
+// loud moment does not flatten them for the rest of the show.
+#define LiveSampleRate 44100
+#define LivePeakHalfLife 5.0
 
 #endif // PROGRAMDEFINES_H_INCLUDED
@@ -0,0 +1,64 @@
+#ifndef SAMPLEFORMAT_H_INCLUDED
+#define SAMPLEFORMAT_H_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+\file SampleFormat.h
+\brief Sample formats the analysis and playback read in place.
+
+*/
+
+/**
+\brief Encoding of the samples in a SampleSpan.
+
+*/
+
+enum SampleFormat
+{
+    SampleInt16,    ///< Signed 16 bit, little endian.
+    SampleInt24,    ///< Signed 24 bit packed in 3 bytes, little endian.
+    SampleFloat32   ///< 32 bit float, full scale at 1.0.
+};
+
+/**
+\brief How the channels of a multichannel track are analysed.
+
+Each mode gives one or more views of the track, each with its own band data.
+
+*/
+
+enum ChannelMode
+{
+    ChannelDownmix,     ///< One view, the mean of all channels.
+    ChannelSplit,       ///< One view per channel.
+    ChannelMidSide      ///< Mid (L+R)/2 and side (L-R)/2 of a stereo track, a downmix otherwise.
+};
+
+/**
+\brief Interleaved samples that live somewhere else, usually a file mapping.
+
+The span does not own the samples.  count is the total number of samples over all channels.
+
+*/
+
+struct SampleSpan
+{
+    const void* data;       ///< First sample.
+    SampleFormat format;    ///< Encoding of each sample.
+    std::uint64_t count;    ///< Number of samples.
+    unsigned int channels;  ///< Samples per frame.
+};
+
+/**
+\brief Returns the size of one sample in bytes.
+
+*/
+
+inline std::size_t sampleBytes(SampleFormat format)
+{
+    return (format == SampleInt16) ? 2 : (format == SampleInt24 ? 3 : 4);
+}
+
+#endif // SAMPLEFORMAT_H_INCLUDED
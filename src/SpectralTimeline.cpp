@@ -0,0 +1,487 @@
+#include "SpectralTimeline.h"
+
+#include "FileUtil.h"
+#include "ProgramDefines.h"
+
+#include <limits.h>
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+/**
+\file SpectralTimeline.cpp
+\brief Writing and reading the quantised spectral timeline format.
+
+*/
+
+//  Quieter than this below the loudest value of a block is stored as silence.
+static const double TimelineRangeDb = 120;
+
+/**
+\brief Constructor, nothing is open.
+
+*/
+
+SpectralTimeline::SpectralTimeline()
+{
+    close();
+}
+
+/**
+\brief Maps a timeline file.
+
+\param path --- the file to open.
+
+\return False if the file is missing, of another version, or its band peaks, index or blocks do not
+fit where its header puts them.  The frame count is stored in 64 bits, but the frames are read by
+int index, so a timeline of more than INT_MAX frames is refused rather than cut short.
+
+*/
+
+bool SpectralTimeline::open(const std::string& path)
+{
+    close();
+    if (!file.open(path) || file.size() < sizeof(Header))
+    {
+        close();
+        return false;
+    }
+    memcpy(&header, file.data(), sizeof(header));
+
+    std::size_t valueBytes = header.bits / 8;
+    std::size_t blockBytes = 8 + ((std::size_t) header.framesPerBlock * header.bands * valueBytes + 7) / 8 * 8;
+    bool valid = memcmp(header.magic, "FFTVTIME", 8) == 0 && header.version == FormatVersion &&
+                 (header.bits == 8 || header.bits == 16) && header.bands > 0 && header.framesPerBlock > 0 &&
+                 header.frames <= INT_MAX &&
+                 header.blocks == (header.frames + header.framesPerBlock - 1) / header.framesPerBlock &&
+                 header.indexOffset >= sizeof(Header) + (std::uint64_t) header.bands * sizeof(float) &&
+                 header.indexOffset + header.blocks * sizeof(std::uint64_t) <= file.size();
+
+    if (valid)
+    {
+        bandPeaks = (const float*) (file.data() + sizeof(Header));
+        blockIndex = (const std::uint64_t*) (file.data() + header.indexOffset);
+        for (std::uint64_t b = 0; b < header.blocks && valid; b++)
+            valid = blockIndex[b] + blockBytes <= file.size();
+    }
+
+    if (!valid)
+    {
+        close();
+        return false;
+    }
+    return true;
+}
+
+/**
+\brief Unmaps the timeline.
+
+*/
+
+void SpectralTimeline::close()
+{
+    file.close();
+    memset(&header, 0, sizeof(header));
+    bandPeaks = NULL;
+    blockIndex = NULL;
+}
+
+/**
+\brief Returns true if a timeline is open.
+
+*/
+
+bool SpectralTimeline::isOpen() const
+{
+    return file.isOpen();
+}
+
+/**
+\brief Returns the number of frames, open refuses more than an int holds.
+
+*/
+
+int SpectralTimeline::getFrameCount() const
+{
+    return (int) header.frames;
+}
+
+/**
+\brief Returns the number of bands per frame.
+
+*/
+
+int SpectralTimeline::getBandCount() const
+{
+    return (int) header.bands;
+}
+
+/**
+\brief Returns 8 or 16, the bits per stored value.
+
+*/
+
+int SpectralTimeline::getBits() const
+{
+    return (int) header.bits;
+}
+
+/**
+\brief Returns the samples between frames.
+
+*/
+
+int SpectralTimeline::getHopSize() const
+{
+    return (int) header.hopSize;
+}
+
+/**
+\brief Returns the samples per analysis frame, the bars are centred on the middle of a frame.
+
+*/
+
+int SpectralTimeline::getFrameLength() const
+{
+    return (header.frameLength > 0) ? (int) header.frameLength : fftBuffer;
+}
+
+/**
+\brief Returns the sample rate of the analysed audio.
+
+*/
+
+unsigned int SpectralTimeline::getSampleRate() const
+{
+    return header.sampleRate;
+}
+
+/**
+\brief Copies the peak of each band over the whole timeline.
+
+\param peaks --- getBandCount() values to be filled.
+
+*/
+
+void SpectralTimeline::getBandPeaks(double* peaks) const
+{
+    for (std::uint32_t b = 0; b < header.bands; b++)
+        peaks[b] = bandPeaks[b];
+}
+
+/**
+\brief Returns the stored values of one frame, in place in the mapping.
+
+\param frame --- the frame index.
+\param floorDb --- set to the block's floor in dB.
+\param stepDb --- set to the block's step in dB.
+
+\return getBandCount() values of getBits() bits, or NULL if the frame is out of range.
+
+*/
+
+const unsigned char* SpectralTimeline::getFrameData(int frame, float* floorDb, float* stepDb) const
+{
+    if (frame < 0 || (std::uint64_t) frame >= header.frames)
+        return NULL;
+
+    const unsigned char* block = file.data() + blockIndex[frame / header.framesPerBlock];
+    memcpy(floorDb, block, sizeof(float));
+    memcpy(stepDb, block + 4, sizeof(float));
+    return block + 8 + (std::size_t) (frame % header.framesPerBlock) * header.bands * (header.bits / 8);
+}
+
+/**
+\brief Decodes one frame back to linear magnitudes.
+
+\param frame --- the frame index.
+\param mags --- getBandCount() values to be filled.
+
+\return False, leaving mags untouched, if the frame is out of range.
+
+*/
+
+bool SpectralTimeline::getFrame(int frame, double* mags) const
+{
+    float floorDb, stepDb;
+    const unsigned char* values = getFrameData(frame, &floorDb, &stepDb);
+    if (values == NULL)
+        return false;
+
+    for (std::uint32_t b = 0; b < header.bands; b++)
+    {
+        unsigned int q;
+        if (header.bits == 8)
+        {
+            q = values[b];
+        }
+        else
+        {
+            std::uint16_t v;
+            memcpy(&v, values + 2 * b, sizeof(v));
+            q = v;
+        }
+        mags[b] = (q == 0) ? 0 : pow(10.0, (floorDb + (q - 1) * (double) stepDb) / 20);
+    }
+    return true;
+}
+
+/**
+\brief Quantises band magnitudes and writes them as a timeline file.
+
+\param path --- the file to write, replaced atomically.
+\param peaks --- frames * bands linear magnitudes, frame after frame.
+\param frames --- number of frames.
+\param bands --- bands per frame.
+\param bits --- 8 or 16 bits per value.
+\param framesPerBlock --- frames per block, each block has its own dB range.
+\param hopSize --- samples between frames.
+\param sampleRate --- samples per second.
+\param frameLength --- samples per frame.
+
+\return False if the arguments are invalid or the file could not be written.
+
+*/
+
+bool SpectralTimeline::save(const std::string& path, const double* peaks, int frames, int bands, int bits,
+                            int framesPerBlock, int hopSize, unsigned int sampleRate, int frameLength)
+{
+    if (frames < 0)
+        return false;
+
+    TimelineWriter writer;
+    return writer.begin(path, frames, bands, bits, framesPerBlock, hopSize, sampleRate, frameLength) &&
+           writer.addFrames(peaks, frames) && writer.finish();
+}
+
+/**
+\brief Constructor, nothing is being written.
+
+*/
+
+TimelineWriter::TimelineWriter()
+{
+    out = NULL;
+    memset(&head, 0, sizeof(head));
+    framesAdded = 0;
+    pendingFrames = 0;
+}
+
+/**
+\brief Destructor, drops a file that was not finished.
+
+*/
+
+TimelineWriter::~TimelineWriter()
+{
+    abort();
+}
+
+/**
+\brief Starts a timeline file, writing its header and block index.
+
+\param path --- the file to write, replaced by finish.
+\param frames --- the number of frames that will be added.
+\param bands --- bands per frame.
+\param bits --- 8 or 16 bits per value.
+\param framesPerBlock --- frames per block, each block has its own dB range.
+\param hopSize --- samples between frames.
+\param sampleRate --- samples per second.
+\param frameLength --- samples per frame.
+
+\return False if the arguments are invalid or the file could not be created.
+
+*/
+
+bool TimelineWriter::begin(const std::string& path, std::uint64_t frames, int bands, int bits,
+                           int framesPerBlock, int hopSize, unsigned int sampleRate, int frameLength)
+{
+    abort();
+    if ((bits != 8 && bits != 16) || bands <= 0 || framesPerBlock <= 0)
+        return false;
+
+    std::size_t valueBytes = bits / 8;
+    std::uint64_t blocks = (frames + framesPerBlock - 1) / framesPerBlock;
+    std::size_t blockBytes = 8 + ((std::size_t) framesPerBlock * bands * valueBytes + 7) / 8 * 8;
+    std::size_t peaksBytes = ((std::size_t) bands * sizeof(float) + 7) / 8 * 8;
+
+    memset(&head, 0, sizeof(head));
+    memcpy(head.magic, "FFTVTIME", 8);
+    head.version = SpectralTimeline::FormatVersion;
+    head.bands = bands;
+    head.bits = bits;
+    head.framesPerBlock = framesPerBlock;
+    head.frames = frames;
+    head.blocks = blocks;
+    head.hopSize = hopSize;
+    head.sampleRate = sampleRate;
+    head.frameLength = frameLength;
+    head.indexOffset = sizeof(head) + peaksBytes;
+
+    framesAdded = 0;
+    pendingFrames = 0;
+    pending.assign((std::size_t) framesPerBlock * bands, 0);
+    bandMax.assign(peaksBytes / sizeof(float), 0.0f);
+    block.assign(blockBytes, 0);
+
+    this->path = path;
+    out = openTemporaryFile(path, tempPath);
+    if (out == NULL)
+        return false;
+
+    // The blocks are all the same size, so the index is known before any of them is written.
+    bool ok = fwrite(&head, sizeof(head), 1, out) == 1 && fwrite(&bandMax[0], peaksBytes, 1, out) == 1;
+    std::uint64_t dataOffset = head.indexOffset + blocks * sizeof(std::uint64_t);
+    for (std::uint64_t b = 0; b < blocks && ok; b++)
+    {
+        std::uint64_t offset = dataOffset + b * blockBytes;
+        ok = fwrite(&offset, sizeof(offset), 1, out) == 1;
+    }
+    if (!ok)
+        abort();
+    return ok;
+}
+
+/**
+\brief Adds frames to the timeline, writing each block as it fills.
+
+\param peaks --- count * bands linear magnitudes, frame after frame.
+\param count --- number of frames, any number up to those still to come.
+
+\return False if more frames are added than begin was given or the file could not be written,
+the file is then dropped.
+
+*/
+
+bool TimelineWriter::addFrames(const double* peaks, std::uint64_t count)
+{
+    if (out == NULL || framesAdded + count > head.frames)
+    {
+        abort();
+        return false;
+    }
+
+    std::size_t bands = head.bands;
+    for (std::uint64_t f = 0; f < count; f++)
+    {
+        const double* frame = peaks + (std::size_t) f * bands;
+        for (std::size_t b = 0; b < bands; b++)
+        {
+            if (frame[b] > bandMax[b])
+                bandMax[b] = (float) frame[b];
+        }
+        memcpy(&pending[pendingFrames * bands], frame, bands * sizeof(double));
+        pendingFrames++;
+        framesAdded++;
+
+        if (pendingFrames == head.framesPerBlock && !writeBlock())
+        {
+            abort();
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+\brief Quantises the pending frames into one block and writes it.
+
+The block's range runs from its loudest value down TimelineRangeDb, or to its quietest if that is nearer.
+
+*/
+
+bool TimelineWriter::writeBlock()
+{
+    unsigned int maxQ = (head.bits == 8) ? 255 : 65535;
+    std::size_t count = pendingFrames * head.bands;
+    memset(&block[0], 0, block.size());
+
+    double topDb = -HUGE_VAL, lowDb = HUGE_VAL;
+    for (std::size_t i = 0; i < count; i++)
+    {
+        if (pending[i] > 0)
+        {
+            double db = 20 * log10(pending[i]);
+            topDb = (db > topDb) ? db : topDb;
+            lowDb = (db < lowDb) ? db : lowDb;
+        }
+    }
+    float floorDb = 0, stepDb = 0;
+    if (topDb > -HUGE_VAL)
+    {
+        floorDb = (float) ((lowDb > topDb - TimelineRangeDb) ? lowDb : topDb - TimelineRangeDb);
+        stepDb = (float) ((topDb - floorDb) / (maxQ - 1));
+    }
+    memcpy(&block[0], &floorDb, sizeof(float));
+    memcpy(&block[4], &stepDb, sizeof(float));
+
+    for (std::size_t i = 0; i < count; i++)
+    {
+        unsigned int q = 0;
+        if (pending[i] > 0)
+        {
+            double db = 20 * log10(pending[i]);
+            double level = (stepDb > 0) ? (db - floorDb) / stepDb : 0;
+            if (level > -0.5) // the floor is rounded to float, so the quietest value can sit just under it
+            {
+                q = 1 + (unsigned int) (level > 0 ? level + 0.5 : 0);
+                q = (q > maxQ) ? maxQ : q;
+            }
+        }
+
+        if (head.bits == 8)
+        {
+            block[8 + i] = (unsigned char) q;
+        }
+        else
+        {
+            std::uint16_t v = (std::uint16_t) q;
+            memcpy(&block[8 + 2 * i], &v, sizeof(v));
+        }
+    }
+
+    pendingFrames = 0;
+    return fwrite(&block[0], block.size(), 1, out) == 1;
+}
+
+/**
+\brief Writes the last, padded block and the band peaks, then renames the file into place.
+
+\return False if fewer frames were added than begin was given or the file could not be written,
+the file is then dropped.
+
+*/
+
+bool TimelineWriter::finish()
+{
+    if (out == NULL || framesAdded != head.frames)
+    {
+        abort();
+        return false;
+    }
+
+    bool ok = (pendingFrames == 0 || writeBlock()) &&
+              fseek(out, sizeof(head), SEEK_SET) == 0 &&
+              fwrite(&bandMax[0], bandMax.size() * sizeof(float), 1, out) == 1;
+    if (!ok)
+    {
+        abort();
+        return false;
+    }
+
+    FILE* file = out;
+    out = NULL;
+    return commitTemporaryFile(file, tempPath, path);
+}
+
+/**
+\brief Stops writing and removes the unfinished file.
+
+*/
+
+void TimelineWriter::abort()
+{
+    if (out != NULL)
+        discardTemporaryFile(out, tempPath);
+    out = NULL;
+}
@@ -0,0 +1,129 @@
+#ifndef SPECTRALTIMELINE_H_INCLUDED
+#define SPECTRALTIMELINE_H_INCLUDED
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+
+/**
+\file SpectralTimeline.h
+\brief Header file for SpectralTimeline.cpp
+
+*/
+
+/**
+\class SpectralTimeline
+
+\brief Compact file of band magnitudes over time, quantised in the log domain.
+
+The file is a header, the peak of each band, a block index and then fixed-size blocks of
+framesPerBlock frames.  Each block holds its own dB floor and step, followed by one 8 or 16 bit
+value per band per frame, frame after frame.  Value 0 is silence, value q is floor + (q - 1) * step dB.
+
+A frame is found with one index lookup, so any frame of a mapped file is read in O(1) and straight
+from the mapping.  At 8 bits a 128 band frame is 128 bytes.
+
+*/
+
+class SpectralTimeline
+{
+private:
+    /**
+    \brief Start of every timeline file.
+    */
+    struct Header
+    {
+        char magic[8];                  ///< "FFTVTIME"
+        std::uint32_t version;          ///< Format version.
+        std::uint32_t bands;            ///< Bands per frame.
+        std::uint32_t bits;             ///< 8 or 16 bits per value.
+        std::uint32_t framesPerBlock;   ///< Frames in every block, the last one is padded.
+        std::uint64_t frames;           ///< Number of frames.
+        std::uint64_t blocks;           ///< Number of blocks.
+        std::uint32_t hopSize;          ///< Samples between frames.
+        std::uint32_t sampleRate;       ///< Samples per second.
+        std::uint64_t indexOffset;      ///< Byte offset of the block index.
+        std::uint32_t frameLength;      ///< Samples per frame, 0 in files from before it was kept means fftBuffer.
+        std::uint32_t reserved;
+    };
+
+    MappedFile file;                    ///< Mapping of the open timeline.
+    Header header;                      ///< Copy of the open timeline's header.
+    const float* bandPeaks;             ///< Peak of each band, linear.
+    const std::uint64_t* blockIndex;    ///< Byte offset of each block.
+
+    SpectralTimeline(const SpectralTimeline&);
+    SpectralTimeline& operator=(const SpectralTimeline&);
+
+    friend class TimelineWriter;
+
+public:
+    static const std::uint32_t FormatVersion = 1;
+
+    SpectralTimeline();
+
+    bool open(const std::string& path);
+    void close();
+    bool isOpen() const;
+
+    int getFrameCount() const;
+    int getBandCount() const;
+    int getBits() const;
+    int getHopSize() const;
+    int getFrameLength() const;
+    unsigned int getSampleRate() const;
+    void getBandPeaks(double* peaks) const;
+
+    const unsigned char* getFrameData(int frame, float* floorDb, float* stepDb) const;
+    bool getFrame(int frame, double* mags) const;
+
+    static bool save(const std::string& path, const double* peaks, int frames, int bands, int bits,
+                     int framesPerBlock, int hopSize, unsigned int sampleRate, int frameLength);
+};
+
+/**
+\class TimelineWriter
+
+\brief Writes a SpectralTimeline a block at a time, for analyses too long to hold in memory.
+
+The number of frames is given up front, so the header and block index are written first and
+every block goes out as soon as its frames are in.  The band peaks are only known at the end and
+are written over their place in the header by finish.  Memory is one block of frames whatever
+the length of the timeline.  The file is written under a temporary name and renamed into place
+by finish, a writer that is abandoned leaves nothing behind.
+
+*/
+
+class TimelineWriter
+{
+private:
+    FILE* out;                          ///< The temporary file, NULL when not writing.
+    std::string path;                   ///< Where finish puts the file.
+    std::string tempPath;               ///< Name of the temporary file.
+    SpectralTimeline::Header head;      ///< Header of the file being written.
+    std::uint64_t framesAdded;          ///< Frames given to addFrames so far.
+    std::vector<double> pending;        ///< Frames of the block being filled, frame after frame.
+    std::size_t pendingFrames;          ///< Frames in pending.
+    std::vector<float> bandMax;         ///< Running peak of each band, padded to 8 bytes.
+    std::vector<unsigned char> block;   ///< One quantised block.
+
+    bool writeBlock();
+
+    TimelineWriter(const TimelineWriter&);
+    TimelineWriter& operator=(const TimelineWriter&);
+
+public:
+    TimelineWriter();
+    ~TimelineWriter();
+
+    bool begin(const std::string& path, std::uint64_t frames, int bands, int bits,
+               int framesPerBlock, int hopSize, unsigned int sampleRate, int frameLength);
+    bool addFrames(const double* peaks, std::uint64_t count);
+    bool finish();
+    void abort();
+};
+
+#endif // SPECTRALTIMELINE_H_INCLUDED
@@ -0,0 +1,1432 @@
+#include "SpectrumAnalyzer.h"
+#include "Tracer.h"
+/**
+\file SpectrumAnalyzer.cpp
+\brief Performs the FFT over a track and reduces each frame to band peaks.
+
+*/
+
+/**
+\brief Constructor
+
+Sets the default analysis settings. Call setSamples before analysing.
+
+*/
+SpectrumAnalyzer::SpectrumAnalyzer(){
+    samples = NULL;
+    samplesF = NULL;
+    rawSamples = NULL;
+    rawFormat = SampleInt16;
+    channels = 1;
+    channelMode = ChannelDownmix;
+    viewCount = 1;
+    singlePrecision = false;
+    streamed = false;
+    sampleBase = 0;
+    numSamples = 0;
+    sampleRate = 0;
+    timePerVisual = 0;
+    resultLayout = ResultFrameMajor;
+    numFrames = 0;
+    numFullFrames = 0;
+    tailLength = 0;
+    frameLength = fftBuffer;
+    cqKernel = NULL;
+
+    threadCount = std::thread::hardware_concurrency(); ///one analysis worker per core
+    if(threadCount == 0){
+        threadCount = 1;
+    }
+    plannerFlags = FFTW_MEASURE; ///measured plans are cached and kept in the wisdom file, so they are only slow once
+    batchMode = true;
+    batchFrames = true;
+    hopSize = fftBuffer;
+    frameRate = 0;
+    windowType = WindowRectangular;
+    kaiserBeta = 8.6;
+    directFrames = true;
+
+    fullPlan = NULL;
+    blockPlan = NULL;
+    remainderPlan = NULL;
+    tailPlan = NULL;
+    fullPlanF = blockPlanF = remainderPlanF = tailPlanF = NULL;
+
+    nextBlock = 0;
+    framesReady = 0;
+    stopAnalysis = false;
+    readyBlocks = 0;
+    onsetFramesPicked = 0;
+
+    streamBuffers = WorkerBuffers(); ///no buffers until beginStream
+    seamStart = 0;
+    seamFrames = 0;
+    streamNext = 0;
+
+    bandCount = layout.getBandCount();
+    overallPeakMag.assign(bandCount, 0);
+}
+/**
+\brief Destructor
+
+Stops a background analysis that is still running, the results free their values and the cache unmaps its own. Plans belong to the FftPlanCache.
+
+*/
+SpectrumAnalyzer::~SpectrumAnalyzer(){
+    stop();
+    freeBuffers(streamBuffers);
+}
+/**
+\brief Set the samples to analyse
+
+\param in --- mono sample data, must outlive the analysis.
+\param count --- number of samples.
+\param rate --- sample rate in samples per second.
+
+Resets any earlier results. Must not be called while an analysis is running.
+
+*/
+void SpectrumAnalyzer::setSamples(double* in, std::uint64_t count, unsigned int rate){
+    samples = in;
+    samplesF = NULL;
+    rawSamples = NULL;
+    rawFormat = SampleInt16;
+    channels = 1;
+    singlePrecision = false;
+    streamed = false;
+    sampleBase = 0;
+    numSamples = count;
+    sampleRate = rate;
+
+    computeFrames();
+    updateViews();
+    resetResults();
+}
+/**
+\brief Set single precision samples to analyse
+
+\param in --- mono sample data, must outlive the analysis.
+\param count --- number of samples.
+\param rate --- sample rate in samples per second.
+
+The analysis then runs through fftwf and the float magnitude kernel. The band peaks are still
+returned as double.
+
+*/
+void SpectrumAnalyzer::setSamples(float* in, std::uint64_t count, unsigned int rate){
+    setSamples((double*)NULL, count, rate);
+    samplesF = in;
+    singlePrecision = true;
+}
+/**
+\brief Set 16 bit samples to analyse
+
+\param in --- mono sample data, must outlive the analysis.
+\param count --- number of samples.
+\param rate --- sample rate in samples per second.
+\param single --- true to run the analysis through fftwf.
+
+*/
+void SpectrumAnalyzer::setSamples(const std::int16_t* in, std::uint64_t count, unsigned int rate, bool single){
+    setSamples(in, SampleInt16, count, rate, single);
+}
+/**
+\brief Set samples stored in a file format to analyse
+
+\param in --- mono sample data, such as a WavFile mapping, must outlive the analysis.
+\param format --- 16 bit, 24 bit or float.
+\param count --- number of samples.
+\param rate --- sample rate in samples per second.
+\param single --- true to run the analysis through fftwf.
+
+The samples are never converted as a whole. Each frame is converted and windowed in one pass
+straight into the FFT input, so the analysis only touches the pages of the file it is reading.
+
+*/
+void SpectrumAnalyzer::setSamples(const void* in, SampleFormat format, std::uint64_t count, unsigned int rate, bool single){
+    setSamples((double*)NULL, count, rate);
+    rawSamples = in;
+    rawFormat = format;
+    singlePrecision = single;
+}
+/**
+\brief Set interleaved samples to analyse
+
+\param span --- the samples, such as a WavFile mapping, must outlive the analysis.
+\param rate --- sample rate in frames per second.
+\param single --- true to run the analysis through fftwf.
+
+Frames are counted per channel.  Each frame is split or mixed down as it is staged, see
+setChannelMode, so the track is read in one pass whatever the number of views.
+
+*/
+void SpectrumAnalyzer::setSamples(const SampleSpan& span, unsigned int rate, bool single){
+    unsigned int spanChannels = (span.channels > 0) ? span.channels : 1;
+    setSamples(span.data, span.format, span.count / spanChannels, rate, single);
+    channels = spanChannels;
+    updateViews();
+    resetResults();
+}
+/**
+\brief Set the format of a track that is analysed as it is decoded
+
+\param count --- frames per channel of the whole track.
+\param channelCount --- interleaved channels of the blocks.
+\param rate --- sample rate in frames per second.
+\param single --- true to run the analysis through fftwf.
+
+The frames are counted as for setSamples, but no samples are held and nothing is allocated for
+the result yet, beginStream does that once the track is to be analysed.
+
+*/
+void SpectrumAnalyzer::setStreamFormat(std::uint64_t count, unsigned int channelCount, unsigned int rate, bool single){
+    samples = NULL;
+    samplesF = NULL;
+    rawSamples = NULL;
+    rawFormat = SampleInt16; ///what a DecodePipeline block holds
+    channels = (channelCount > 0) ? channelCount : 1;
+    singlePrecision = single;
+    streamed = true;
+    sampleBase = 0;
+    numSamples = count;
+    sampleRate = rate;
+
+    computeFrames();
+    updateViews();
+    resetResults();
+}
+/**
+\brief Set how the channels are analysed
+
+\param mode --- a downmix, every channel on its own, or mid and side.
+
+Resets any earlier results. Must not be called while an analysis is running.
+
+*/
+void SpectrumAnalyzer::setChannelMode(ChannelMode mode){
+    channelMode = mode;
+    updateViews();
+    resetResults();
+}
+/**
+\brief Work out the number of views from the channel mode and channel count
+
+*/
+void SpectrumAnalyzer::updateViews(){
+    if(channelMode == ChannelSplit && channels > 1)
+        viewCount = channels;
+    else if(channelMode == ChannelMidSide && channels == 2)
+        viewCount = 2;
+    else
+        viewCount = 1;
+}
+/**
+\brief Return the doubles of results per frame, bandCount for each view and the onset strength
+
+*/
+int SpectrumAnalyzer::peakStride(){
+    return bandCount * viewCount + 1;
+}
+/**
+\brief Return true if the analysis runs in single precision
+
+*/
+bool SpectrumAnalyzer::isSinglePrecision(){
+    return singlePrecision;
+}
+/**
+\brief Set how the spectrum is split into bands
+
+\param bands --- the band layout, 5 classic bands by default.
+
+A BandConstantQ layout lengthens the frames to what its lowest bin needs and measures the bins
+with a ConstantQKernel rather than taking the peak of the FFT bins between the edges.
+
+Resets any earlier results. Must not be called while an analysis is running.
+
+*/
+void SpectrumAnalyzer::setBandLayout(const BandLayout& bands){
+    layout = bands;
+    bandCount = layout.getBandCount();
+    computeFrames();
+    resetResults();
+}
+/**
+\brief Set the hop between frames
+
+\param hop --- samples between frame starts, from 1 to fftBuffer. fftBuffer gives the original
+non-overlapping frames, fftBuffer/4 gives 75% overlap.
+
+Replaces a frame rate set before. Resets any earlier results. Must not be called while an
+analysis is running.
+
+*/
+void SpectrumAnalyzer::setHopSize(int hop){
+    hopSize = (hop < 1) ? 1 : (hop > fftBuffer ? fftBuffer : hop);
+    frameRate = 0;
+    computeFrames();
+    resetResults();
+}
+/**
+\brief Set the hop so there are a number of frames per second
+
+\param hz --- frames per second, e.g. one per display refresh, or 0 to keep the hop as it is.
+
+The hop is worked out from the sample rate of the samples set, now and each time they are set
+again, so every track of a playlist gets the same frame rate whatever its own rate. Resets any
+earlier results. Must not be called while an analysis is running.
+
+*/
+void SpectrumAnalyzer::setFrameRate(float hz){
+    frameRate = (hz > 0) ? hz : 0;
+    computeFrames();
+    resetResults();
+}
+/**
+\brief Set the window applied to each frame
+
+\param type --- the window.
+\param beta --- shape of the Kaiser window, ignored by the others.
+
+*/
+void SpectrumAnalyzer::setWindow(WindowType type, double beta){
+    windowType = type;
+    kaiserBeta = beta;
+}
+/**
+\brief Keep finished analyses on disk and reuse them
+
+\param dir --- folder for the cache files, empty to turn the cache off.
+
+*/
+void SpectrumAnalyzer::setCacheDirectory(const std::string& dir){
+    resultCache.setDirectory(dir);
+}
+/**
+\brief Set how the results are laid out
+
+\param order --- ResultFrameMajor keeps each frame's bands together, ResultBandMajor each band's
+history, for readers that walk one band over many frames.
+
+Resets any earlier results. Must not be called while an analysis is running.
+
+*/
+void SpectrumAnalyzer::setResultLayout(ResultLayout order){
+    resultLayout = order;
+    resetResults();
+}
+/**
+\brief Return how the results are laid out
+
+*/
+ResultLayout SpectrumAnalyzer::getResultLayout(){
+    return resultLayout;
+}
+/**
+\brief Take every analysis setting from another analyzer
+
+\param from --- the analyzer to copy, its samples, results and cache directory are not copied.
+
+Resets any earlier results. Must not be called while an analysis is running.
+
+*/
+void SpectrumAnalyzer::copySettings(const SpectrumAnalyzer& from){
+    plannerFlags = from.plannerFlags;
+    threadCount = from.threadCount;
+    batchMode = from.batchMode;
+    setWindow(from.windowType, from.kaiserBeta);
+    channelMode = from.channelMode;
+    updateViews();
+    resultLayout = from.resultLayout;
+    layout = from.layout;
+    bandCount = layout.getBandCount();
+    hopSize = from.hopSize;
+    frameRate = from.frameRate; ///the hop is worked out again for these samples' own rate
+    computeFrames();
+    resetResults();
+}
+/**
+\brief Hash the samples together with every setting that changes the result
+
+*/
+std::uint64_t SpectrumAnalyzer::resultKey(){
+    std::uint64_t key = AnalysisCache::FormatVersion;
+    if(rawSamples != NULL)
+        key = AnalysisCache::hash(rawSamples, numSamples * channels * sampleBytes(rawFormat), key);
+    else if(singlePrecision)
+        key = AnalysisCache::hash(samplesF, numSamples * sizeof(float), key);
+    else
+        key = AnalysisCache::hash(samples, numSamples * sizeof(double), key);
+
+    double settings[] = {(double)numSamples, (double)sampleRate, (double)frameLength, (double)hopSize,
+                         (double)windowType, kaiserBeta, (double)singlePrecision,
+                         (double)(rawSamples != NULL ? rawFormat : -1), (double)layout.getScale(), (double)bandCount,
+                         (double)channels, (double)(viewCount > 1 ? channelMode : ChannelDownmix)};
+    key = AnalysisCache::hash(settings, sizeof(settings), key);
+    key = AnalysisCache::hash(&layout.getEdges()[0], layout.getEdges().size() * sizeof(double), key);
+    if(resultLayout != ResultFrameMajor){
+        key = AnalysisCache::hash(&resultLayout, sizeof(resultLayout), key); ///frame major files from before the layout was a setting stay valid
+    }
+    return key;
+}
+/**
+\brief Map a cached result in place of running the FFT
+
+\param key --- from resultKey.
+
+\return False if the cache has no result for these samples and settings.
+
+*/
+bool SpectrumAnalyzer::loadCachedResults(std::uint64_t key){
+    if(!resultCache.open(key, numFrames, numFrames + 1, peakStride())){
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(progressMutex);
+    results.map(resultCache.getPeaks(), resultLayout, numFrames + 1, bandCount, viewCount); ///read only, nothing writes to it until resetResults
+    overallPeakMag.assign(resultCache.getOverallPeaks(), resultCache.getOverallPeaks() + peakStride());
+    resetOnsets();
+    pickOnsets(numFrames); ///the onset strengths are cached, only the picking is redone
+    framesReady.store(numFrames, std::memory_order_release);
+    return true;
+}
+/**
+\brief Work out the frames from the sample count, hop and band layout
+
+With a frame rate set the hop is worked out first, from the sample rate. A constant-Q kernel is only defined for a whole frame, so a constant-Q analysis has no short
+left over frame.
+
+*/
+void SpectrumAnalyzer::computeFrames(){
+    if(frameRate > 0 && sampleRate > 0){
+        int hop = (int)(sampleRate / frameRate + 0.5f);
+        hopSize = (hop < 1) ? 1 : (hop > fftBuffer ? fftBuffer : hop);
+    }
+    frameLength = fftBuffer;
+    if(layout.getScale() == BandConstantQ){
+        frameLength = ConstantQKernel::fftSizeFor(sampleRate, layout);
+        frameLength = (frameLength > 0) ? frameLength : fftBuffer; ///no sample rate yet
+    }
+
+    numFullFrames = (numSamples >= (std::uint64_t)frameLength) ? (int)((numSamples - frameLength) / hopSize) + 1 : 0;
+    tailLength = (int)(numSamples - (std::uint64_t)numFullFrames * hopSize); ///what the full frames leave over at the end
+    if(layout.getScale() == BandConstantQ){
+        tailLength = 0;
+    }
+    numFrames = numFullFrames + (tailLength > 0 ? 1 : 0); ///full frames plus the left over one
+    timePerVisual = 1/(sampleRate/(float)hopSize); ///calculating time between each visual
+}
+/**
+\brief Return the number of frames in a number of samples with the current settings
+
+\param count --- samples per channel.
+
+The frames computeFrames finds, as a 64 bit count for tracks too long to analyse in one pass.
+The frame length of a constant-Q layout is the one for the sample rate last set.
+
+*/
+std::uint64_t SpectrumAnalyzer::countFrames(std::uint64_t count){
+    std::uint64_t fullFrames = (count >= (std::uint64_t)frameLength) ? (count - frameLength) / hopSize + 1 : 0;
+    bool tail = count > fullFrames * hopSize && layout.getScale() != BandConstantQ;
+    return fullFrames + (tail ? 1 : 0);
+}
+/**
+\brief Clear the results and size them for the current samples and band layout
+
+*/
+void SpectrumAnalyzer::resetResults(){
+    nextBlock = 0;
+    framesReady = 0;
+    readyBlocks = 0;
+    overallPeakMag.assign(peakStride(), 0);
+    resetOnsets();
+
+    results.release();
+    resultCache.close(); ///a mapped or streamed result goes with its file
+    if(streamed){
+        return; ///a streamed result is made by beginStream
+    }
+    results.allocate(resultLayout, numFrames + 1, bandCount, viewCount); ///peak mags per band per view, zeroed
+}
+/**
+\brief Set the FFTW planner flags
+
+\param flags --- FFTW_ESTIMATE, FFTW_MEASURE or FFTW_PATIENT. Wisdom from earlier runs makes the slower ones cheap.
+
+*/
+void SpectrumAnalyzer::setPlannerFlags(unsigned flags){
+    plannerFlags = flags;
+}
+/**
+\brief Set the number of analysis threads
+
+\param count --- number of workers performFFT splits the frames across, at least 1.
+
+*/
+void SpectrumAnalyzer::setThreadCount(unsigned count){
+    threadCount = (count > 0) ? count : 1;
+}
+/**
+\brief Choose between one plan execution per block or per frame
+
+\param on --- true to transform each block of frames with fftw_plan_many_dft_r2c.
+
+*/
+void SpectrumAnalyzer::setBatchMode(bool on){
+    batchMode = on;
+}
+/**
+\brief Perform the fft on the whole data of the audio
+
+Frames start every hopSize samples. With no window and a hop of frameLength the FFT runs straight on
+the sample array, otherwise each frame is windowed, and converted if the samples are in a file format, in one
+pass into the worker's input buffer. Plans come from the FftPlanCache and are all made before the workers start. The frames are handed
+out in blocks of fftFramesPerBlock, in order, to a pool of worker threads. In batch mode a block's
+full frames are transformed by a single execution, otherwise one frame at a time. A constant-Q
+layout always runs one unwindowed frame at a time and its kernel takes the place of the band reduction. Every worker runs
+the same plans on its own output buffer. As blocks finish, their band maxima are merged into
+overallPeakMag and the high-water mark moves past every leading block that is complete. A max is
+exact, so the result is the same whatever the thread count or finishing order.
+
+With a cache directory set, the result is looked up by a hash of the samples and settings first
+and mapped back if it is there, otherwise it is saved once every frame is done.
+*/
+void SpectrumAnalyzer::performFFT(){
+    TRACE_SCOPE("performFFT");
+    //Perform FFT on set of Data
+    int numBlocks = (numFrames + fftFramesPerBlock - 1) / fftFramesPerBlock;
+
+    if(numFrames == 0 || streamed)
+        return; ///a streamed track is analysed by analyseBlock
+
+    if(results.isMapped()){
+        resetResults(); ///a mapped result is read only, analyse into a fresh allocation
+    }
+    std::uint64_t key = 0;
+    if(resultCache.isEnabled()){
+        TRACE_SCOPE("analysis cache lookup");
+        key = resultKey();
+        if(loadCachedResults(key)){
+            return; ///warm start, the FFT has already been done for these samples and settings
+        }
+    }
+
+    preparePass(batchMode);
+
+    blockDone.assign(numBlocks, 0);
+    readyBlocks = 0;
+    nextBlock = 0;
+    {
+        std::lock_guard<std::mutex> lock(progressMutex);
+        resetOnsets();
+    }
+
+    int workers = (threadCount < (unsigned)numBlocks) ? threadCount : numBlocks;
+    std::vector<std::thread> pool;
+
+    for(int t = 1; t < workers; t++){
+        pool.push_back(std::thread(&SpectrumAnalyzer::analysisWorker, this));
+    }
+    analysisWorker(); ///this thread works too
+
+    for(std::size_t t = 0; t < pool.size(); t++){
+        pool[t].join();
+    }
+
+    FftPlanCache::instance().saveWisdom(); ///keep any newly measured plans for the next launch
+
+    if(resultCache.isEnabled() && isAnalysisComplete()){
+        TRACE_SCOPE("analysis cache save");
+        resultCache.save(key, numFrames, numFrames + 1, peakStride(), results.data(), &overallPeakMag[0]);
+    }
+}
+/**
+\brief Make the kernel, windows, plans and tables of a pass
+
+\param batch --- true to transform the full frames of a block with one execution.
+
+*/
+void SpectrumAnalyzer::preparePass(bool batch){
+    cqKernel = (layout.getScale() == BandConstantQ) ? &ConstantQKernel::get(sampleRate, layout) : NULL; ///built once per sample rate and layout
+    WindowType frameWindow = cqKernel ? WindowRectangular : windowType; ///the constant-Q kernels carry their own windows
+    batchFrames = batch && cqKernel == NULL; ///a block of long frames would need hundreds of MB per worker
+
+    directFrames = !streamed && rawSamples == NULL && frameWindow == WindowRectangular && hopSize == frameLength;
+    buildWindow(frameWindow, frameLength, window, kaiserBeta);
+    buildWindow(frameWindow, tailLength, tailWindow, kaiserBeta);
+    windowF.assign(window.begin(), window.end());
+    tailWindowF.assign(tailWindow.begin(), tailWindow.end());
+
+    {
+        TRACE_SCOPE("make plans");
+        makePlans(); ///make the plans up front so the workers only ever execute them
+    }
+    layout.buildBinTable(sampleRate, frameLength, binBand); ///bin to band tables, built once per pass
+    layout.buildBinTable(sampleRate, tailLength, tailBinBand);
+}
+/**
+\brief Get every plan the analysis needs from the FftPlanCache
+
+Falls back to estimated plans if FFTW cannot make one with the planner flags, FFTW_WISDOM_ONLY
+without the wisdom for it say, so the workers never execute a NULL plan.
+
+*/
+void SpectrumAnalyzer::makePlans(){
+    if(!makePlans(plannerFlags) && plannerFlags != FFTW_ESTIMATE){
+        std::cerr << "FFTW could not plan with the planner flags, estimating the plans instead" << std::endl;
+        makePlans(FFTW_ESTIMATE);
+    }
+}
+/**
+\brief Get every plan the analysis needs with the given planner flags
+
+\param flags --- the planner flags for the full frames. The short left over frame is always
+estimated, its length changes from track to track and measuring it would cost a fresh plan and
+a wisdom save for almost every new track.
+
+\return False if a plan the analysis needs could not be made.
+
+*/
+bool SpectrumAnalyzer::makePlans(unsigned flags){
+    FftPlanCache& planCache = FftPlanCache::instance();
+    int numFftSamples = numFullFrames; ///num of fftSamples
+    int leftOver = tailLength; ///samples in the last, short frame
+    int fullBlocks = numFftSamples / fftFramesPerBlock;
+    int remainder = numFftSamples % fftFramesPerBlock;
+    std::uint64_t tailStart = (std::uint64_t)hopSize * numFftSamples;
+    std::size_t inLen = (std::size_t)fftFramesPerBlock * frameLength;
+    std::size_t outLen = (std::size_t)fftFramesPerBlock * (frameLength/2 + 1);
+
+    fullPlan = blockPlan = remainderPlan = tailPlan = NULL;
+    fullPlanF = blockPlanF = remainderPlanF = tailPlanF = NULL;
+
+    if(singlePrecision){
+        fftwf_complex* planOut = fftwf_alloc_complex(outLen);
+        float* planIn = directFrames ? samplesF : fftwf_alloc_real(inLen); ///plans run on the samples or on a worker's input buffer
+        if(numFftSamples > 0)
+            fullPlanF = planCache.getR2C(frameLength, planIn, planOut, flags);
+        if(batchFrames && fullBlocks > 0)
+            blockPlanF = planCache.getManyR2C(frameLength, fftFramesPerBlock, planIn, planOut, flags);
+        if(batchFrames && remainder > 1)
+            remainderPlanF = planCache.getManyR2C(frameLength, remainder, planIn, planOut, flags);
+        if(leftOver != 0)
+            tailPlanF = planCache.getR2C(leftOver, directFrames ? &samplesF[tailStart] : planIn, planOut, FFTW_ESTIMATE);
+        if(!directFrames)
+            fftwf_free(planIn);
+        fftwf_free(planOut);
+        return (numFftSamples == 0 || fullPlanF) && (!batchFrames || fullBlocks == 0 || blockPlanF)
+            && (!batchFrames || remainder <= 1 || remainderPlanF) && (leftOver == 0 || tailPlanF);
+    }
+    else{
+        fftw_complex* planOut = fftw_alloc_complex(outLen);
+        double* planIn = directFrames ? samples : fftw_alloc_real(inLen);
+        if(numFftSamples > 0)
+            fullPlan = planCache.getR2C(frameLength, planIn, planOut, flags);
+        if(batchFrames && fullBlocks > 0)
+            blockPlan = planCache.getManyR2C(frameLength, fftFramesPerBlock, planIn, planOut, flags);
+        if(batchFrames && remainder > 1)
+            remainderPlan = planCache.getManyR2C(frameLength, remainder, planIn, planOut, flags);
+        if(leftOver != 0)
+            tailPlan = planCache.getR2C(leftOver, directFrames ? &samples[tailStart] : planIn, planOut, FFTW_ESTIMATE);
+        if(!directFrames)
+            fftw_free(planIn);
+        fftw_free(planOut);
+        return (numFftSamples == 0 || fullPlan) && (!batchFrames || fullBlocks == 0 || blockPlan)
+            && (!batchFrames || remainder <= 1 || remainderPlan) && (leftOver == 0 || tailPlan);
+    }
+}
+/**
+\brief Pick the plan for a run of frames
+
+\param rows --- number of frames transformed by one execution.
+\param buffLen --- length of each frame.
+
+*/
+fftw_plan SpectrumAnalyzer::planFor(int rows, int buffLen){
+    if(buffLen != frameLength)
+        return tailPlan;
+    if(rows == 1)
+        return fullPlan;
+    return (rows == fftFramesPerBlock) ? blockPlan : remainderPlan;
+}
+/**
+\brief Pick the single precision plan for a run of frames
+
+\param rows --- number of frames transformed by one execution.
+\param buffLen --- length of each frame.
+
+*/
+fftwf_plan SpectrumAnalyzer::planForF(int rows, int buffLen){
+    if(buffLen != frameLength)
+        return tailPlanF;
+    if(rows == 1)
+        return fullPlanF;
+    return (rows == fftFramesPerBlock) ? blockPlanF : remainderPlanF;
+}
+/**
+\brief Run performFFT on a background thread
+
+Returns straight away. Use getFramesReady or getFrameMags to read the frames that are done so far.
+*/
+void SpectrumAnalyzer::startAnalysis(){
+    if(analysisThread.joinable()){
+        return;
+    }
+    stopAnalysis = false;
+    analysisThread = std::thread(&SpectrumAnalyzer::performFFT, this);
+}
+/**
+\brief Stop a background analysis and wait for it to finish
+
+*/
+void SpectrumAnalyzer::stop(){
+    stopAnalysis = true;
+    if(analysisThread.joinable()){
+        analysisThread.join();
+    }
+}
+/**
+\brief Worker loop, takes blocks of frames until there are none left
+
+*/
+void SpectrumAnalyzer::analysisWorker(){
+    TRACE_THREAD_NAME("analysis");
+    int numBlocks = blockDone.size();
+    WorkerBuffers buffers = WorkerBuffers(); ///this worker's input and output buffers
+    allocateBuffers(buffers);
+    std::vector<double> blockMax(peakStride());
+
+    while(!stopAnalysis){
+        int block = nextBlock.fetch_add(1);
+        if(block >= numBlocks){
+            break;
+        }
+
+        int first = block * fftFramesPerBlock;
+        int last = (first + fftFramesPerBlock < numFrames) ? first + fftFramesPerBlock : numFrames;
+        blockMax.assign(peakStride(), 0);
+
+        TRACE_SCOPE("analyse block");
+        primeFlux(first, buffers); ///the frame before the block, so the first onset strength does not wait on another block
+        analyzeRange(first, last, buffers, &blockMax[0]);
+        publishBlock(block, &blockMax[0]);
+    }
+
+    freeBuffers(buffers);
+}
+/**
+\brief Allocate a worker's buffers for the current pass
+
+\param buffers --- empty or earlier buffers, sized for a block in batch mode and for one frame otherwise.
+
+*/
+void SpectrumAnalyzer::allocateBuffers(WorkerBuffers& buffers){
+    int rowsPerRun = batchFrames ? fftFramesPerBlock : 1;
+    std::size_t inLen = (std::size_t)rowsPerRun * frameLength;
+    std::size_t outLen = (std::size_t)rowsPerRun * (frameLength/2 + 1);
+    freeBuffers(buffers);
+    buffers.viewStride = inLen; ///each view has its own input matrix, the output is reused view after view
+    if(singlePrecision){
+        buffers.inputF = directFrames ? NULL : fftwf_alloc_real(inLen * viewCount);
+        buffers.resultF = fftwf_alloc_complex(outLen);
+        buffers.magsF = fftwf_alloc_real(outLen);
+        buffers.prevMagsF = fftwf_alloc_real((std::size_t)viewCount * (frameLength/2 + 1));
+    }
+    else{
+        buffers.input = directFrames ? NULL : fftw_alloc_real(inLen * viewCount);
+        buffers.result = fftw_alloc_complex(outLen);
+        buffers.mags = fftw_alloc_real(outLen);
+        buffers.prevMags = fftw_alloc_real((std::size_t)viewCount * (frameLength/2 + 1));
+    }
+    buffers.bandPeak.resize(bandCount + 1);
+    buffers.framePeak.resize(bandCount);
+    if(channels > 1){
+        buffers.planar.resize((std::size_t)channels * frameLength);
+        for(unsigned c = 0; c < channels; c++){
+            buffers.planarRows.push_back(&buffers.planar[(std::size_t)c * frameLength]);
+        }
+    }
+}
+/**
+\brief Free a worker's buffers, they may be empty
+
+*/
+void SpectrumAnalyzer::freeBuffers(WorkerBuffers& buffers){
+    fftw_free(buffers.input);
+    fftw_free(buffers.result);
+    fftw_free(buffers.mags);
+    fftw_free(buffers.prevMags);
+    fftwf_free(buffers.inputF);
+    fftwf_free(buffers.resultF);
+    fftwf_free(buffers.magsF);
+    fftwf_free(buffers.prevMagsF);
+    buffers.input = NULL;
+    buffers.inputF = NULL;
+    buffers.result = NULL;
+    buffers.resultF = NULL;
+    buffers.mags = NULL;
+    buffers.magsF = NULL;
+    buffers.prevMags = NULL;
+    buffers.prevMagsF = NULL;
+    buffers.planar.clear();
+    buffers.planarRows.clear();
+}
+/**
+\brief Analyse a range of frames
+
+\param first --- first frame to analyse.
+\param last --- one past the last frame to analyse.
+\param buffers --- the worker's output buffers, prevMags holding the frame before first.
+\param bandMax --- the band maxima for this range, updated in place.
+
+In batch mode all the full frames of the range go through one plan execution, otherwise one frame
+at a time. The input is the frames where they sit in the sample array when directFrames is set,
+otherwise the windowed frames staged one row per frame in the worker's input buffer. The output is
+one row per frame. The magnitudes of the whole output matrix are computed in one vectorised pass and each row
+then goes to the band reduction and the onset strength, which compares it with the row before.
+*/
+void SpectrumAnalyzer::analyzeRange(int first, int last, WorkerBuffers& buffers, double* bandMax){
+    int numFftSamples = numFullFrames;
+    int rowLen = frameLength/2 + 1;
+    int frame = first;
+
+    while(frame < last){
+        int rows = 1;
+        int buffLen = frameLength;
+        const int* table = binBand.empty() ? NULL : &binBand[0];
+        if(frame == numFftSamples){
+            buffLen = tailLength; ///incase there are left over samples
+            table = tailBinBand.empty() ? NULL : &tailBinBand[0];
+        }
+        else if(batchFrames){
+            rows = ((last < numFftSamples) ? last : numFftSamples) - frame;
+        }
+
+        std::uint64_t offset = (std::uint64_t)hopSize * frame; ///start of the first frame
+        if(singlePrecision){
+            float* in = directFrames ? &samplesF[offset] : buffers.inputF;
+            for(int r = 0; !directFrames && r < rows; r++){
+                stageFrame(offset + (std::uint64_t)r * hopSize, buffLen, (buffLen == frameLength) ? &windowF[0] : &tailWindowF[0], &buffers.inputF[r * frameLength], buffers);
+            }
+            for(int v = 0; v < viewCount; v++){
+                fftwf_execute_dft_r2c(planForF(rows, buffLen), in + v * buffers.viewStride, buffers.resultF);
+                computeMagnitudes(buffers.resultF, buffers.magsF, rows * rowLen);
+                if(buffLen == frameLength){
+                    accumulateFlux(buffers.magsF, buffers.prevMagsF + v * rowLen, rows, frame, v > 0, bandMax);
+                }
+                for(int r = 0; r < rows; r++){
+                    double* framePeak = results.frameOutput(frame + r, v, &buffers.framePeak[0]);
+                    if(cqKernel)
+                        reduceConstantQ(&buffers.resultF[r * rowLen], framePeak, bandMax + v * bandCount);
+                    else
+                        reduceBands(&buffers.magsF[r * rowLen], table, buffLen/2, framePeak, bandMax + v * bandCount, &buffers.bandPeak[0]);
+                    results.storeFrame(frame + r, v, framePeak);
+                }
+            }
+        }
+        else{
+            double* in = directFrames ? &samples[offset] : buffers.input;
+            for(int r = 0; !directFrames && r < rows; r++){
+                stageFrame(offset + (std::uint64_t)r * hopSize, buffLen, (buffLen == frameLength) ? &window[0] : &tailWindow[0], &buffers.input[r * frameLength], buffers);
+            }
+            for(int v = 0; v < viewCount; v++){
+                fftw_execute_dft_r2c(planFor(rows, buffLen), in + v * buffers.viewStride, buffers.result);
+                computeMagnitudes(buffers.result, buffers.mags, rows * rowLen);
+                if(buffLen == frameLength){
+                    accumulateFlux(buffers.mags, buffers.prevMags + v * rowLen, rows, frame, v > 0, bandMax);
+                }
+                for(int r = 0; r < rows; r++){
+                    double* framePeak = results.frameOutput(frame + r, v, &buffers.framePeak[0]);
+                    if(cqKernel)
+                        reduceConstantQ(&buffers.result[r * rowLen], framePeak, bandMax + v * bandCount);
+                    else
+                        reduceBands(&buffers.mags[r * rowLen], table, buffLen/2, framePeak, bandMax + v * bandCount, &buffers.bandPeak[0]);
+                    results.storeFrame(frame + r, v, framePeak);
+                }
+            }
+        }
+
+        frame += rows;
+    }
+}
+/**
+\brief Window one frame of every view into the FFT input
+
+\param start --- index of the frame's first sample, counted per channel.
+\param len --- samples in the frame.
+\param win --- len window coefficients.
+\param out --- the frame's row in the first view's input matrix, the other views follow every viewStride.
+\param buffers --- the worker's buffers, planar holds the split channels.
+
+A mono track is windowed straight from the samples. Otherwise the frame is split into channels,
+or mixed down, in one vectorised pass and each view is windowed from that.
+
+*/
+template <typename T>
+void SpectrumAnalyzer::stageFrame(std::uint64_t start, int len, const T* win, T* out, WorkerBuffers& buffers){
+    if(channels <= 1){
+        stageMono(start, len, win, out);
+        return;
+    }
+
+    if(viewCount == 1){
+        downmix(rawSamples, rawFormat, channels, start - sampleBase, &buffers.planar[0], len);
+    }
+    else{
+        deinterleave(rawSamples, rawFormat, channels, start - sampleBase, &buffers.planarRows[0], len);
+        if(channelMode == ChannelMidSide){
+            midSide(buffers.planarRows[0], buffers.planarRows[1], buffers.planarRows[0], buffers.planarRows[1], len);
+        }
+    }
+
+    for(int v = 0; v < viewCount; v++){
+        windowFrame(buffers.planarRows[v], win, out + v * buffers.viewStride, len);
+    }
+}
+/**
+\brief Window one frame of a mono track into the FFT input
+
+*/
+void SpectrumAnalyzer::stageMono(std::uint64_t start, int len, const double* win, double* out){
+    if(rawSamples != NULL)
+        windowSamples(rawSamples, rawFormat, start - sampleBase, win, out, len);
+    else
+        windowFrame(&samples[start], win, out, len);
+}
+/**
+\brief Window one frame of a mono track into the single precision FFT input
+
+*/
+void SpectrumAnalyzer::stageMono(std::uint64_t start, int len, const float* win, float* out){
+    if(rawSamples != NULL)
+        windowSamples(rawSamples, rawFormat, start - sampleBase, win, out, len);
+    else
+        windowFrame(&samplesF[start], win, out, len);
+}
+/**
+\brief Reduce one frame's magnitudes to the peak of each band
+
+\param mags --- the magnitudes of one frame's spectrum.
+\param table --- the bin to band table for this frame's length.
+\param bins --- number of bins in the table.
+\param framePeak --- where to write this frame's band peaks.
+\param bandMax --- the band maxima, updated in place.
+\param bandPeak --- scratch of bandCount + 1, the last slot collects the bins outside every band.
+
+*/
+template <typename T>
+void SpectrumAnalyzer::reduceBands(const T* mags, const int* table, int bins, double* framePeak, double* bandMax, double* bandPeak){
+    for(int b = 0; b <= bandCount; b++){
+        bandPeak[b] = 0;
+    }
+
+    gatherMax(mags, table, bins, bandPeak); ///branchless max through the bin to band table
+
+    for(int b = 0; b < bandCount; b++){
+        framePeak[b] = bandPeak[b];
+        if(bandPeak[b] > bandMax[b]){
+            bandMax[b] = bandPeak[b];
+        }
+    }
+}
+/**
+\brief Measure one frame's constant-Q bins from its spectrum
+
+\param spectrum --- one row of the FFT output.
+\param framePeak --- where to write this frame's band peaks.
+\param bandMax --- the band maxima, updated in place.
+
+One sparse matrix times the spectrum, see ConstantQKernel.
+
+*/
+template <typename C>
+void SpectrumAnalyzer::reduceConstantQ(const C* spectrum, double* framePeak, double* bandMax){
+    cqKernel->apply(spectrum, framePeak);
+    for(int b = 0; b < bandCount; b++){
+        if(framePeak[b] > bandMax[b]){
+            bandMax[b] = framePeak[b];
+        }
+    }
+}
+/**
+\brief Work out the onset strength of a run of frames from their magnitudes
+
+\param mags --- the magnitudes of rows consecutive full frames of one view.
+\param previous --- the magnitudes of the frame before the run, replaced by those of its last frame.
+\param rows --- frames in the run.
+\param frame --- the first frame of the run.
+\param add --- false for the first view, the other views add their flux to it.
+\param bandMax --- the range maxima, the last slot keeps the strongest onset strength.
+
+The onset strength is the half-wave rectified spectral flux summed over the views.
+
+*/
+template <typename T>
+void SpectrumAnalyzer::accumulateFlux(const T* mags, T* previous, int rows, int frame, bool add, double* bandMax){
+    int rowLen = frameLength/2 + 1;
+    int stride = peakStride();
+    for(int r = 0; r < rows; r++){
+        const T* before = (r == 0) ? previous : &mags[(r - 1) * rowLen];
+        double* strength = results.slot(frame + r, stride - 1);
+        *strength = (add ? *strength : 0) + spectralFlux(&mags[r * rowLen], before, rowLen);
+        if(*strength > bandMax[stride - 1]){
+            bandMax[stride - 1] = *strength;
+        }
+    }
+    memcpy(previous, &mags[(rows - 1) * rowLen], rowLen * sizeof(T));
+}
+/**
+\brief Fill prevMags with the magnitudes of the frame before a range
+
+\param first --- the range's first frame, the first frame of the track is compared with silence.
+\param buffers --- the worker's buffers, the first row of each input matrix is used as scratch.
+
+One extra transform per block, so every block's onset strengths come out the same whichever
+worker or order they are analysed in.
+
+*/
+void SpectrumAnalyzer::primeFlux(int first, WorkerBuffers& buffers){
+    int rowLen = frameLength/2 + 1;
+    std::uint64_t offset = (std::uint64_t)hopSize * (first - 1);
+
+    if(singlePrecision){
+        if(first == 0 || first > numFullFrames){
+            memset(buffers.prevMagsF, 0, (std::size_t)viewCount * rowLen * sizeof(float));
+            return;
+        }
+        float* in = directFrames ? &samplesF[offset] : buffers.inputF;
+        if(!directFrames)
+            stageFrame(offset, frameLength, &windowF[0], buffers.inputF, buffers);
+        for(int v = 0; v < viewCount; v++){
+            fftwf_execute_dft_r2c(fullPlanF, in + v * buffers.viewStride, buffers.resultF);
+            computeMagnitudes(buffers.resultF, buffers.prevMagsF + v * rowLen, rowLen);
+        }
+    }
+    else{
+        if(first == 0 || first > numFullFrames){
+            memset(buffers.prevMags, 0, (std::size_t)viewCount * rowLen * sizeof(double));
+            return;
+        }
+        double* in = directFrames ? &samples[offset] : buffers.input;
+        if(!directFrames)
+            stageFrame(offset, frameLength, &window[0], buffers.input, buffers);
+        for(int v = 0; v < viewCount; v++){
+            fftw_execute_dft_r2c(fullPlan, in + v * buffers.viewStride, buffers.result);
+            computeMagnitudes(buffers.result, buffers.prevMags + v * rowLen, rowLen);
+        }
+    }
+}
+/**
+\brief Forget the onsets picked so far, call with progressMutex held
+
+*/
+void SpectrumAnalyzer::resetOnsets(){
+    onsetDetector.setFrameTime((double)hopSize / (sampleRate > 0 ? sampleRate : 1));
+    onsetFramesPicked = 0;
+    onsetFrames.clear();
+}
+/**
+\brief Run the onset picker over the frames up to the high-water mark, call with progressMutex held
+
+\param ready --- frames below this are complete.
+
+The picker needs the frames in order, so it runs here as the mark moves rather than in the workers.
+Each frame is decided when the next one arrives, the last frame by a silent frame after it.
+
+*/
+void SpectrumAnalyzer::pickOnsets(int ready){
+    int stride = peakStride();
+    for(; onsetFramesPicked < ready; onsetFramesPicked++){
+        if(onsetDetector.push(results.value(onsetFramesPicked, stride - 1))){
+            onsetFrames.push_back(onsetFramesPicked - 1);
+        }
+    }
+    if(ready == numFrames && onsetDetector.push(0)){
+        onsetFrames.push_back(numFrames - 1);
+    }
+}
+/**
+\brief Mark a block complete and move the high-water mark
+
+\param block --- the finished block.
+\param blockMax --- the block's band maxima.
+
+*/
+void SpectrumAnalyzer::publishBlock(int block, const double* blockMax){
+    std::lock_guard<std::mutex> lock(progressMutex);
+
+    blockDone[block] = 1;
+    while(readyBlocks < (int)blockDone.size() && blockDone[readyBlocks]){
+        readyBlocks++;
+    }
+
+    int ready = readyBlocks * fftFramesPerBlock;
+    publishFrames((ready < numFrames) ? ready : numFrames, blockMax);
+}
+/**
+\brief Merge a range's band maxima and move the high-water mark, call with progressMutex held
+
+\param ready --- frames below this are complete.
+\param rangeMax --- the band maxima of the frames just finished.
+
+*/
+void SpectrumAnalyzer::publishFrames(int ready, const double* rangeMax){
+    for(int b = 0; b < peakStride(); b++){
+        if(rangeMax[b] > overallPeakMag[b]){
+            overallPeakMag[b] = rangeMax[b];
+        }
+    }
+
+    if(ready > onsetFramesPicked){
+        pickOnsets(ready);
+    }
+    framesReady.store(ready, std::memory_order_release); ///peaks below the mark are visible to readers
+}
+/**
+\brief Start analysing a track set with setStreamFormat
+
+\param key --- the track's cache key, see StreamAnalyzer::key.
+
+With the cache on, a result saved for the key is mapped back and the track is complete at once.
+Otherwise the result is made in a file mapping, kept under the key once every frame is done, or
+a temporary file when the cache is off, so a long track costs no memory.  The plans, tables,
+buffers and the seam are made here, once, and analyseBlock only reuses them.
+
+\return False if the track cannot be analysed, it is empty, too long or the file could not be made.
+
+*/
+bool SpectrumAnalyzer::beginStream(std::uint64_t key){
+    TRACE_SCOPE("begin stream");
+    freeBuffers(streamBuffers);
+    if(!streamed || numFrames == 0 || countFrames(numSamples) > (std::uint64_t)INT_MAX){
+        return false;
+    }
+
+    resetResults();
+    if(loadCachedResults(key)){
+        return true; ///warm start
+    }
+    double* peaks = resultCache.create(key, numFrames, numFrames + 1, peakStride());
+    if(peaks == NULL){
+        return false;
+    }
+    results.attach(peaks, resultLayout, numFrames + 1, bandCount, viewCount);
+
+    std::size_t frameBytes = sampleBytes(rawFormat) * channels;
+    seam.assign((std::size_t)(2 * frameLength - 1) * frameBytes, 0); ///the start of a frame and a block's worth of the rest
+    seamStart = 0;
+    seamFrames = 0;
+    streamNext = 0;
+    rawSamples = &seam[0];
+
+    preparePass(false); ///one frame per execution, the frames of a block do not line up with the plans' blocks
+    allocateBuffers(streamBuffers);
+    streamMax.assign(peakStride(), 0);
+    primeFlux(0, streamBuffers);
+    return true;
+}
+/**
+\brief Analyse the next block of a streamed track
+
+\param block --- interleaved 16 bit samples, count a multiple of the channels.
+\param first --- frame of the track the block starts at, each block following the one before.
+
+Call on one thread, in order, between beginStream and endStream.  Frames inside the block are read
+where they lie.  A frame that starts in one block and ends in a later one is finished from the seam,
+which keeps the end of the blocks before, so the frames come out as performFFT makes them.  Readers
+see each block's frames, bands, views and onset strengths as soon as it returns.
+
+*/
+void SpectrumAnalyzer::analyseBlock(const SampleSpan& block, std::uint64_t first){
+    TRACE_SCOPE("analyse block");
+    if(!streamed || (streamBuffers.prevMags == NULL && streamBuffers.prevMagsF == NULL) || streamNext >= numFrames){
+        return; ///not begun, mapped back from the cache or done
+    }
+    std::size_t frameBytes = sampleBytes(rawFormat) * channels;
+    std::uint64_t count = block.count / channels;
+    std::uint64_t end = first + count;
+    const unsigned char* data = (const unsigned char*)block.data;
+    streamMax.assign(streamMax.size(), 0);
+
+    if(frameStart(streamNext) < first){
+        std::uint64_t room = seam.size() / frameBytes - seamFrames;
+        std::uint64_t take = (count < room) ? count : room;
+        memcpy(&seam[seamFrames * frameBytes], data, take * frameBytes);
+        seamFrames += take;
+        analyseStreamed(&seam[0], seamStart, seamStart + seamFrames, first); ///the frames that started before the block
+    }
+    analyseStreamed(data, first, end, end);
+
+    if(streamNext < numFrames){
+        std::uint64_t keep = frameStart(streamNext); ///the next frame runs on into the next block
+        if(keep >= end){
+            seamStart = end;
+            seamFrames = 0;
+        }
+        else if(keep >= first){
+            memcpy(&seam[0], data + (keep - first) * frameBytes, (end - keep) * frameBytes);
+            seamStart = keep;
+            seamFrames = end - keep;
+        }
+        else{
+            std::uint64_t held = seamStart + seamFrames - keep;
+            memmove(&seam[0], &seam[(keep - seamStart) * frameBytes], held * frameBytes);
+            seamStart = keep;
+            seamFrames = held;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(progressMutex);
+    publishFrames(streamNext, &streamMax[0]);
+}
+/**
+\brief Analyse the frames of a streamed track that lie inside some samples
+
+\param from --- the samples.
+\param base --- frame of the track from starts at.
+\param end --- frame of the track one past the last sample.
+\param startLimit --- only frames starting before this are taken.
+
+*/
+void SpectrumAnalyzer::analyseStreamed(const void* from, std::uint64_t base, std::uint64_t end, std::uint64_t startLimit){
+    int last = streamNext;
+    while(last < numFrames && frameStart(last) >= base && frameStart(last) < startLimit
+          && frameStart(last) + frameSamples(last) <= end){
+        last++;
+    }
+    if(last == streamNext){
+        return;
+    }
+    rawSamples = from;
+    sampleBase = base;
+    analyzeRange(streamNext, last, streamBuffers, &streamMax[0]);
+    streamNext = last;
+}
+/**
+\brief Return the sample a frame starts at
+
+*/
+std::uint64_t SpectrumAnalyzer::frameStart(int frame){
+    return (std::uint64_t)hopSize * frame;
+}
+/**
+\brief Return the length of a frame, the left over frame is short
+
+*/
+int SpectrumAnalyzer::frameSamples(int frame){
+    return (frame == numFullFrames) ? tailLength : frameLength;
+}
+/**
+\brief Finish a streamed analysis
+
+Frees the buffers beginStream made.  A complete result is kept in the cache, an unfinished one
+stays readable up to getFramesReady until the samples or settings change.
+
+*/
+void SpectrumAnalyzer::endStream(){
+    bool begun = streamBuffers.prevMags != NULL || streamBuffers.prevMagsF != NULL;
+    freeBuffers(streamBuffers);
+    if(!begun){
+        return;
+    }
+    if(isAnalysisComplete()){
+        TRACE_SCOPE("analysis cache save");
+        std::lock_guard<std::mutex> lock(progressMutex);
+        resultCache.commit(&overallPeakMag[0]);
+    }
+    FftPlanCache::instance().saveWisdom();
+}
+/**
+\brief Return the number of bands per frame
+
+*/
+int SpectrumAnalyzer::getBandCount(){
+    return bandCount;
+}
+/**
+\brief Return the number of views, the band sets kept per frame
+
+One for a downmix, one per channel when split, two for mid and side.
+
+*/
+int SpectrumAnalyzer::getViewCount(){
+    return viewCount;
+}
+/**
+\brief Return the hop between frames in samples
+
+*/
+int SpectrumAnalyzer::getHopSize(){
+    return hopSize;
+}
+/**
+\brief Return the number of analysis frames
+
+*/
+int SpectrumAnalyzer::getNumFrames(){
+    return numFrames;
+}
+/**
+\brief Return how many leading frames have been analysed
+
+*/
+int SpectrumAnalyzer::getFramesReady(){
+    return framesReady.load(std::memory_order_acquire);
+}
+/**
+\brief Return true once every frame has been analysed
+
+*/
+bool SpectrumAnalyzer::isAnalysisComplete(){
+    return getFramesReady() == numFrames;
+}
+/**
+\brief Copy the band magnitudes of one frame
+
+\param frame --- the frame index.
+\param mags --- array of getBandCount() to be filled.
+\param view --- which view, from 0 to getViewCount() - 1.
+
+\return False, leaving mags untouched, if the frame has not been analysed yet.
+
+*/
+bool SpectrumAnalyzer::getFrameMags(int frame, double* mags, int view){
+    if(frame < 0 || frame >= getFramesReady() || view < 0 || view >= viewCount){
+        return false;
+    }
+    ValueSpan peaks = results.frame(frame, view);
+    for(int b = 0; b < bandCount; b++){
+        mags[b] = peaks[b];
+    }
+    return true;
+}
+/**
+\brief Return the band magnitudes of one frame where they lie
+
+\param frame --- the frame index.
+\param view --- which view, from 0 to getViewCount() - 1.
+
+\return An empty span if the frame has not been analysed yet. The values stay put until the
+results are next reset, so any thread can read them.
+
+*/
+ValueSpan SpectrumAnalyzer::getFrame(int frame, int view){
+    if(frame < 0 || frame >= getFramesReady() || view < 0 || view >= viewCount){
+        ValueSpan none = {NULL, 0, 1};
+        return none;
+    }
+    return results.frame(frame, view);
+}
+/**
+\brief Return the history of one band over the frames analysed so far
+
+\param band --- the band, from 0 to getBandCount() - 1.
+\param view --- which view, from 0 to getViewCount() - 1.
+
+Contiguous when the results are band major.
+
+*/
+ValueSpan SpectrumAnalyzer::getBand(int band, int view){
+    int ready = getFramesReady();
+    if(ready == 0 || band < 0 || band >= bandCount || view < 0 || view >= viewCount){
+        ValueSpan none = {NULL, 0, 1};
+        return none;
+    }
+    return results.band(band, view, 0, ready);
+}
+/**
+\brief Return the band magnitudes of a run of frames
+
+\param first --- the first frame.
+\param count --- frames wanted, cut short at the frames analysed so far.
+\param view --- which view, from 0 to getViewCount() - 1.
+
+*/
+FrameSpan SpectrumAnalyzer::getFrames(int first, int count, int view){
+    int ready = getFramesReady();
+    if(first < 0 || count <= 0 || first >= ready || view < 0 || view >= viewCount){
+        FrameSpan none = {NULL, 0, (std::size_t)bandCount, 1, 1};
+        return none;
+    }
+    return results.frames(first, (count < ready - first) ? count : ready - first, view);
+}
+/**
+\brief get the max mag data
+
+While the analysis is still running this is the max over the frames done so far.
+
+*/
+void SpectrumAnalyzer::getMaxMag( double* overallMagArr, int view){
+    std::lock_guard<std::mutex> lock(progressMutex);
+    if(view < 0 || view >= viewCount){
+        view = 0;
+    }
+    for(int i = 0; i < bandCount; i ++){
+            overallMagArr[i] = overallPeakMag[view * bandCount + i];
+    }
+}
+/**
+\brief Write the finished analysis as a compact SpectralTimeline file
+
+\param path --- the file to write.
+\param bits --- 8 or 16 bits per band value.
+\param view --- which view to save, a timeline holds one.
+
+\return False if the analysis is not complete or the file could not be written.
+
+*/
+bool SpectrumAnalyzer::saveTimeline(const std::string& path, int bits, int view){
+    if(!isAnalysisComplete() || view < 0 || view >= viewCount){
+        return false;
+    }
+
+    std::vector<double> viewPeaks((std::size_t)numFrames * bandCount);
+    FrameSpan peaks = results.frames(0, numFrames, view);
+    for(int f = 0; f < numFrames; f++){
+        for(int b = 0; b < bandCount; b++){
+            viewPeaks[(std::size_t)f * bandCount + b] = peaks.at(f, b);
+        }
+    }
+    return SpectralTimeline::save(path, &viewPeaks[0], numFrames, bandCount, bits, fftFramesPerBlock, hopSize, sampleRate, frameLength);
+}
+/**
+\brief Return the onset strength of a frame, its spectral flux
+
+\return 0 if the frame has not been analysed yet.
+
+*/
+double SpectrumAnalyzer::getOnsetStrength(int frame){
+    if(frame < 0 || frame >= getFramesReady()){
+        return 0;
+    }
+    return results.value(frame, peakStride() - 1);
+}
+/**
+\brief Count the onsets in a range of frames
+
+\param first --- first frame of the range.
+\param last --- one past the last frame of the range.
+
+Only onsets already picked are counted, a frame is picked once the frame after it is analysed.
+
+*/
+int SpectrumAnalyzer::countOnsets(int first, int last){
+    std::lock_guard<std::mutex> lock(progressMutex);
+    std::vector<int>::iterator from = std::lower_bound(onsetFrames.begin(), onsetFrames.end(), first);
+    std::vector<int>::iterator to = std::lower_bound(onsetFrames.begin(), onsetFrames.end(), last);
+    return (to > from) ? (int)(to - from) : 0;
+}
+/**
+\brief Return the samples in a full frame, fftBuffer unless the layout is constant-Q
+
+*/
+int SpectrumAnalyzer::getFrameLength(){
+    return frameLength;
+}
+/**
+\brief Return the time per visual
+
+*/
+float SpectrumAnalyzer::getTimePerVisual(){
+    return timePerVisual;
+}
@@ -0,0 +1,217 @@
+#ifndef SPECTRUMANALYZER_H_INCLUDED
+#define SPECTRUMANALYZER_H_INCLUDED
+
+#include    "ProgramDefines.h"
+#include    "FftPlanCache.h"
+#include    "AnalysisKernels.h"
+#include    "BandLayout.h"
+#include    "ConstantQKernel.h"
+#include    "WindowFunction.h"
+#include    "AnalysisCache.h"
+#include    "AnalysisResult.h"
+#include    "SpectralTimeline.h"
+#include    "OnsetDetector.h"
+#include	<fftw3.h>
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include    <math.h>
+
+/**
+\file SpectrumAnalyzer.h
+\brief Header for SpectrumAnalyzer.cpp.
+
+The analysis half of fft_SFML. It only needs FFTW, so it can be driven without a window or
+audio device.
+
+*/
+
+/**
+\class SpectrumAnalyzer
+
+\brief Performs the FFT over a whole track and keeps the peak magnitude of each band per frame.
+
+A track held in memory or mapped is analysed by performFFT.  A track decoded a block at a time is
+streamed instead: setStreamFormat gives its length, beginStream sizes everything once, and each
+block in order goes through analyseBlock on one thread, which allocates nothing.
+
+*/
+
+class SpectrumAnalyzer {
+private:
+    double *samples; ///<double precision samples to analyse, owned by the caller
+    float *samplesF; ///<single precision samples to analyse, owned by the caller
+    const void *rawSamples; ///<samples in a file format, owned by the caller and converted as each frame is windowed
+    SampleFormat rawFormat; ///<how rawSamples are stored
+    unsigned int channels; ///<interleaved channels of rawSamples, the other inputs are mono
+    ChannelMode channelMode; ///<how the channels are analysed
+    int viewCount; ///<band sets per frame, one per channel, mid and side, or 1 for a downmix
+    bool singlePrecision; ///<true when the samples are float and the fftwf path is used
+    bool streamed; ///<the samples arrive a block at a time through analyseBlock, see setStreamFormat
+    std::uint64_t sampleBase; ///<frame of the track rawSamples starts at, 0 unless streamed
+    std::uint64_t numSamples; ///< Num of samples per channel
+    unsigned int sampleRate; ///<Sample Rate
+    float timePerVisual; ///<Time per visual, the hop in seconds
+
+    int hopSize; ///<samples between the starts of consecutive frames
+    float frameRate; ///<frames per second the hop is worked out for from the sample rate, 0 to keep hopSize
+    WindowType windowType; ///<window applied to each frame
+    double kaiserBeta; ///<shape of the Kaiser window
+    std::vector<double> window, tailWindow; ///<window coefficients for full frames and the left over frame
+    std::vector<float> windowF, tailWindowF; ///<single precision copies of the windows
+    bool directFrames; ///<frames are transformed where they sit in the sample array, no window or conversion needed
+
+    BandLayout layout; ///<how the spectrum is split into bands
+    int bandCount; ///<number of bands per frame
+    std::vector<int> binBand, tailBinBand; ///<bin to band tables for full frames and the left over frame
+    AnalysisResult results; ///<the band peaks of every frame, bandCount per view, then the frame's onset strength
+    ResultLayout resultLayout; ///<frame or band major, how results lays the frames out
+    std::vector<double> overallPeakMag; ///< max mags per band of each view and the max onset strength (running max while analysing)
+    AnalysisCache resultCache; ///<finished analyses kept on disk
+    int numFrames; ///<number of analysis frames, including a short left over frame
+    int numFullFrames; ///<number of frames of frameLength samples
+    int frameLength; ///<samples per full frame, fftBuffer or the length a constant-Q layout needs
+    const ConstantQKernel* cqKernel; ///<the shared kernel while analysing a BandConstantQ layout, NULL otherwise
+    int tailLength; ///<samples in the short left over frame, 0 if there is none
+
+    unsigned plannerFlags; ///<FFTW planner flags used for the cached plans
+    unsigned threadCount; ///<number of workers performFFT uses
+    bool batchMode; ///<transform a whole block of frames with one plan execution
+    bool batchFrames; ///<batchMode as the current pass uses it, off for constant-Q frames
+
+    fftw_plan fullPlan; ///<one full frame
+    fftw_plan blockPlan; ///<fftFramesPerBlock full frames
+    fftw_plan remainderPlan; ///<the full frames of the last, shorter block
+    fftw_plan tailPlan; ///<the short left over frame
+    fftwf_plan fullPlanF, blockPlanF, remainderPlanF, tailPlanF; ///<single precision versions of the plans above
+
+    /**
+    \brief Output buffers owned by one worker.
+    */
+    struct WorkerBuffers
+    {
+        double* input;          ///< windowed FFT input matrix, unused when directFrames
+        float* inputF;          ///< single precision windowed FFT input matrix
+        fftw_complex* result;   ///< FFT output matrix
+        fftwf_complex* resultF; ///< single precision FFT output matrix
+        double* mags;           ///< magnitudes of result
+        float* magsF;           ///< magnitudes of resultF
+        std::vector<double> bandPeak; ///< one frame's band peaks plus a slot for unused bins
+        std::vector<double> framePeak; ///< one view of a frame before it is scattered into a band major result
+        double* prevMags;       ///< magnitudes of the frame before the current one, one row per view
+        float* prevMagsF;       ///< single precision prevMags
+        std::size_t viewStride; ///< entries between the input matrices of consecutive views
+        std::vector<float> planar; ///< one frame split into channels, or mixed, before windowing
+        std::vector<float*> planarRows; ///< start of each channel in planar
+    };
+
+    WorkerBuffers streamBuffers; ///<the buffers of a streamed analysis, its one worker is the thread feeding it
+    std::vector<double> streamMax; ///<band maxima of the block being streamed
+    std::vector<unsigned char> seam; ///<samples of the frames that run from one streamed block into the next
+    std::uint64_t seamStart; ///<frame of the track seam starts at
+    std::uint64_t seamFrames; ///<frames held in seam
+    int streamNext; ///<next frame a streamed analysis takes
+
+    std::thread analysisThread; ///<background thread started by startAnalysis
+    std::atomic<int> nextBlock; ///<next block of frames to hand to a worker
+    std::atomic<int> framesReady; ///<high-water mark, frames below it are complete
+    std::atomic<bool> stopAnalysis; ///<asks the workers to quit early
+    std::mutex progressMutex; ///<guards blockDone, readyBlocks and overallPeakMag
+    std::vector<unsigned char> blockDone; ///<completed blocks, may finish out of order
+    int readyBlocks; ///<number of leading blocks that are all complete
+    OnsetDetector onsetDetector; ///<picks onsets from the onset strength of the frames in order
+    int onsetFramesPicked; ///<frames given to onsetDetector so far
+    std::vector<int> onsetFrames; ///<frames found to be onsets, in order
+
+    void makePlans();
+    bool makePlans(unsigned);
+    fftw_plan planFor(int, int);
+    fftwf_plan planForF(int, int);
+    void preparePass(bool);
+    void allocateBuffers(WorkerBuffers&);
+    void freeBuffers(WorkerBuffers&);
+    void analysisWorker();
+    void analyzeRange(int, int, WorkerBuffers&, double*);
+    template <typename T> void reduceBands(const T*, const int*, int, double*, double*, double*);
+    template <typename C> void reduceConstantQ(const C*, double*, double*);
+    template <typename T> void accumulateFlux(const T*, T*, int, int, bool, double*);
+    void primeFlux(int, WorkerBuffers&);
+    void resetOnsets();
+    void pickOnsets(int);
+    void resetResults();
+    void computeFrames();
+    void updateViews();
+    int peakStride();
+    bool loadCachedResults(std::uint64_t);
+    template <typename T> void stageFrame(std::uint64_t, int, const T*, T*, WorkerBuffers&);
+    void stageMono(std::uint64_t, int, const double*, double*);
+    void stageMono(std::uint64_t, int, const float*, float*);
+    void publishBlock(int, const double*);
+    void publishFrames(int, const double*);
+    std::uint64_t frameStart(int);
+    int frameSamples(int);
+    void analyseStreamed(const void*, std::uint64_t, std::uint64_t, std::uint64_t);
+
+    SpectrumAnalyzer(const SpectrumAnalyzer&);
+    SpectrumAnalyzer& operator=(const SpectrumAnalyzer&);
+
+public:
+    SpectrumAnalyzer();
+    ~SpectrumAnalyzer();
+
+    void setSamples(double*, std::uint64_t, unsigned int);
+    void setSamples(float*, std::uint64_t, unsigned int);
+    void setSamples(const std::int16_t*, std::uint64_t, unsigned int, bool);
+    void setSamples(const void*, SampleFormat, std::uint64_t, unsigned int, bool);
+    void setSamples(const SampleSpan&, unsigned int, bool);
+    void setStreamFormat(std::uint64_t, unsigned int, unsigned int, bool);
+    void setChannelMode(ChannelMode);
+    bool isSinglePrecision();
+    void setPlannerFlags(unsigned);
+    void setThreadCount(unsigned);
+    void setBatchMode(bool);
+    void setBandLayout(const BandLayout&);
+    void setHopSize(int);
+    void setFrameRate(float);
+    void setWindow(WindowType, double beta = 8.6);
+    void setCacheDirectory(const std::string&);
+    void setResultLayout(ResultLayout);
+    ResultLayout getResultLayout();
+    void copySettings(const SpectrumAnalyzer&);
+    std::uint64_t resultKey();
+
+    void performFFT();
+    void startAnalysis();
+    void stop();
+
+    bool beginStream(std::uint64_t);
+    void analyseBlock(const SampleSpan&, std::uint64_t);
+    void endStream();
+
+    int getNumFrames();
+    std::uint64_t countFrames(std::uint64_t);
+    int getBandCount();
+    int getViewCount();
+    int getHopSize();
+    int getFrameLength();
+    int getFramesReady();
+    bool isAnalysisComplete();
+    bool getFrameMags(int, double*, int view = 0);
+    ValueSpan getFrame(int, int view = 0);
+    ValueSpan getBand(int, int view = 0);
+    FrameSpan getFrames(int, int, int view = 0);
+    void getMaxMag(double*, int view = 0);
+    bool saveTimeline(const std::string&, int bits = 8, int view = 0);
+    double getOnsetStrength(int);
+    int countOnsets(int, int);
+    float getTimePerVisual();
+};
+
+#endif // SPECTRUMANALYZER_H_INCLUDED
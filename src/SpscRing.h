@@ -0,0 +1,158 @@
+#ifndef SPSCRING_H_INCLUDED
+#define SPSCRING_H_INCLUDED
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+/**
+\file SpscRing.h
+\brief Lock-free single producer, single consumer ring buffer.
+
+*/
+
+/**
+\class SpscRing
+
+\brief A fixed size ring of T with one writing thread and one reading thread.
+
+The storage is allocated once by the constructor, so push and pop never allocate, lock or
+block and are safe to call from an audio callback.  The capacity is rounded up to a power of
+two and the head and tail count up forever, the slot is the count masked by capacity - 1.
+Each side only writes its own counter, the release store after copying the items and the
+acquire load on the other side make the items visible before the count that covers them.
+
+The counters sit on their own cache lines so the two threads do not fight over one line.
+
+*/
+
+template <typename T>
+class SpscRing
+{
+private:
+    std::vector<T> items;                   ///< capacity slots.
+    std::size_t mask;                       ///< capacity - 1.
+
+    alignas(64) std::atomic<std::size_t> head;  ///< Items pushed so far, written by the producer.
+    alignas(64) std::atomic<std::size_t> tail;  ///< Items popped so far, written by the consumer.
+
+    SpscRing(const SpscRing&);
+    SpscRing& operator=(const SpscRing&);
+
+public:
+    /**
+    \brief Constructor
+
+    \param minCapacity --- the least number of items the ring must hold.
+
+    */
+
+    explicit SpscRing(std::size_t minCapacity)
+    {
+        std::size_t capacity = 1;
+        while (capacity < minCapacity)
+            capacity <<= 1;
+
+        items.resize(capacity);
+        mask = capacity - 1;
+        head.store(0, std::memory_order_relaxed);
+        tail.store(0, std::memory_order_relaxed);
+    }
+
+    /**
+    \brief Returns the number of slots.
+
+    */
+
+    std::size_t capacity() const
+    {
+        return mask + 1;
+    }
+
+    /**
+    \brief Producer side, copies in as many of the items as fit.
+
+    \param in --- the items.
+    \param count --- number of items.
+
+    \return The number copied, less than count if the ring is full.
+
+    */
+
+    std::size_t push(const T* in, std::size_t count)
+    {
+        std::size_t h = head.load(std::memory_order_relaxed);
+        std::size_t space = capacity() - (h - tail.load(std::memory_order_acquire));
+        if (count > space)
+            count = space;
+
+        for (std::size_t i = 0; i < count; i++)
+            items[(h + i) & mask] = in[i];
+
+        head.store(h + count, std::memory_order_release);
+        return count;
+    }
+
+    /**
+    \brief Producer side, pushes one item if there is room.
+
+    */
+
+    bool push(const T& item)
+    {
+        return push(&item, 1) == 1;
+    }
+
+    /**
+    \brief Consumer side, copies out and removes up to count items.
+
+    \param out --- count slots, may be NULL to drop the items.
+    \param count --- the most items to take.
+
+    \return The number taken.
+
+    */
+
+    std::size_t pop(T* out, std::size_t count)
+    {
+        std::size_t t = tail.load(std::memory_order_relaxed);
+        std::size_t ready = head.load(std::memory_order_acquire) - t;
+        if (count > ready)
+            count = ready;
+
+        for (std::size_t i = 0; out != NULL && i < count; i++)
+            out[i] = items[(t + i) & mask];
+
+        tail.store(t + count, std::memory_order_release);
+        return count;
+    }
+
+    /**
+    \brief Consumer side, copies the oldest item without removing it.
+
+    \return False if the ring is empty.
+
+    */
+
+    bool peek(T& out) const
+    {
+        std::size_t t = tail.load(std::memory_order_relaxed);
+        if (head.load(std::memory_order_acquire) == t)
+            return false;
+
+        out = items[t & mask];
+        return true;
+    }
+
+    /**
+    \brief Consumer side, the number of items waiting.
+
+    */
+
+    std::size_t available() const
+    {
+        return head.load(std::memory_order_acquire) - tail.load(std::memory_order_relaxed);
+    }
+};
+
+#endif // SPSCRING_H_INCLUDED
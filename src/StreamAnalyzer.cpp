@@ -0,0 +1,227 @@
+#include "StreamAnalyzer.h"
+
+#include <vector>
+
+#include "FileUtil.h"
+#include "Tracer.h"
+
+/**
+\file StreamAnalyzer.cpp
+\brief Analyses a decoded track a block at a time as its pipeline decodes it.
+
+*/
+
+/**
+\brief Decodes the first block of a file, enough to key it by its start, rate and channels.
+
+\param path --- the sound file.
+\param pcm --- output, the samples.
+\param rate --- output, frames per second.
+\param total --- output, samples of the whole file over all channels.
+
+\return The samples as a span over pcm, with no channels if the file could not be read.
+
+*/
+
+static SampleSpan readHead(const std::string& path, std::vector<sf::Int16>& pcm, unsigned int* rate, std::uint64_t* total)
+{
+    SampleSpan span;
+    span.data = NULL;
+    span.format = SampleInt16;
+    span.count = 0;
+    span.channels = 0;
+
+    sf::InputSoundFile file;
+    if (!file.openFromFile(path) || file.getChannelCount() == 0 || file.getSampleCount() == 0)
+        return span;
+
+    *rate = file.getSampleRate();
+    *total = file.getSampleCount();
+    std::uint64_t head = (std::uint64_t) DecodeBlockFrames * file.getChannelCount();
+    pcm.resize((std::size_t) ((*total < head) ? *total : head));
+    pcm.resize((std::size_t) file.read(&pcm[0], pcm.size()));
+
+    span.data = pcm.empty() ? NULL : &pcm[0];
+    span.count = pcm.size();
+    span.channels = file.getChannelCount();
+    return span;
+}
+
+/**
+\brief Constructor, nothing is being analysed.
+
+*/
+
+StreamAnalyzer::StreamAnalyzer()
+{
+    analyzer = NULL;
+    decoder = NULL;
+    stopRequested = false;
+    state = 0;
+}
+
+/**
+\brief Destructor, stops a background analysis.
+
+*/
+
+StreamAnalyzer::~StreamAnalyzer()
+{
+    stop();
+}
+
+/**
+\brief Returns the cache key of a file analysed with some settings.
+
+\param settings --- the analyzer whose settings will be used.
+\param audioPath --- the sound file.
+\param single --- true to analyse in single precision.
+
+The key hashes the path, the size and modification time of the file, its length, the samples of
+its first block and every setting that changes the result, so the file is not decoded whole but a
+file edited or replaced in place gets a new key.  The analysis is kept in the cache under it and
+mapped back on the next launch.
+
+\return The key, or 0 if the file could not be read.
+
+*/
+
+std::uint64_t StreamAnalyzer::key(const SpectrumAnalyzer& settings, const std::string& audioPath, bool single)
+{
+    std::uint64_t size = 0;
+    std::int64_t modified = 0;
+    if (!getFileStamp(audioPath, &size, &modified))
+        return 0;
+
+    std::vector<sf::Int16> pcm;
+    unsigned int rate = 0;
+    std::uint64_t total = 0;
+    SampleSpan head = readHead(audioPath, pcm, &rate, &total);
+    if (head.channels == 0)
+        return 0;
+
+    SpectrumAnalyzer probe;
+    probe.copySettings(settings);
+    probe.setSamples(head, rate, single);
+
+    std::uint64_t key = AnalysisCache::hash(audioPath.data(), audioPath.size(), probe.resultKey()); // with the cache's format version
+    key = AnalysisCache::hash(&total, sizeof(total), key);
+    key = AnalysisCache::hash(&size, sizeof(size), key);
+    return AnalysisCache::hash(&modified, sizeof(modified), key);
+}
+
+/**
+\brief Analyses a decoded track on the calling thread.
+
+\param target --- the analyzer, already set up with setStreamFormat for the track.
+\param source --- the track's pipeline, open, whose analysis cursor this takes.
+\param cacheKey --- from key, the result is mapped back from the cache when it is there.
+
+The analyzer's frames can be read from any thread while this runs.  Its buffers, plans and result
+are made once before the first block.
+
+\return False if the track could not be analysed or stop was called.
+
+*/
+
+bool StreamAnalyzer::analyse(SpectrumAnalyzer& target, DecodePipeline& source, std::uint64_t cacheKey)
+{
+    stop();
+    analyzer = &target;
+    decoder = &source;
+    stopRequested = false;
+    state = 0;
+    return run(cacheKey);
+}
+
+/**
+\brief Analyses a decoded track on a background thread, see analyse.
+
+Returns straight away.  The analysis keeps pace with playback, it only runs ahead of the reader
+as far as the pipeline's read-ahead.
+
+*/
+
+void StreamAnalyzer::start(SpectrumAnalyzer& target, DecodePipeline& source, std::uint64_t cacheKey)
+{
+    stop();
+    analyzer = &target;
+    decoder = &source;
+    stopRequested = false;
+    state = 0;
+    thread = std::thread(&StreamAnalyzer::run, this, cacheKey);
+}
+
+/**
+\brief Stops a background analysis after its current block and waits for it.
+
+*/
+
+void StreamAnalyzer::stop()
+{
+    stopRequested = true;
+    if (thread.joinable())
+    {
+        decoder->closeAnalysis(); // wakes the analysis if it is waiting for a block
+        thread.join();
+    }
+}
+
+/**
+\brief Returns true once every frame has been analysed.
+
+*/
+
+bool StreamAnalyzer::isComplete() const
+{
+    return state.load(std::memory_order_acquire) == 1;
+}
+
+/**
+\brief Returns true if the last analysis failed or was stopped.
+
+*/
+
+bool StreamAnalyzer::hasFailed() const
+{
+    return state.load(std::memory_order_acquire) == -1;
+}
+
+/**
+\brief The analysis itself, with analyzer and decoder set, see analyse.
+
+*/
+
+bool StreamAnalyzer::run(std::uint64_t cacheKey)
+{
+    TRACE_THREAD_NAME("stream analysis");
+    TRACE_SCOPE("analyse stream");
+    unsigned int channels = decoder->getChannelCount();
+    if (channels == 0 || !analyzer->beginStream(cacheKey))
+    {
+        state.store(-1, std::memory_order_release);
+        return false;
+    }
+
+    decoder->openAnalysis();
+    while (!stopRequested && !analyzer->isAnalysisComplete())
+    {
+        const PcmBlock* block = decoder->acquireAnalysis();
+        if (block == NULL)
+            break;
+
+        SampleSpan span;
+        span.data = block->samples;
+        span.format = SampleInt16;
+        span.count = block->count;
+        span.channels = channels;
+        analyzer->analyseBlock(span, block->first / channels);
+        decoder->releaseAnalysis(block);
+    }
+    decoder->closeAnalysis();
+    analyzer->endStream();
+
+    bool ok = analyzer->isAnalysisComplete();
+    state.store(ok ? 1 : -1, std::memory_order_release);
+    return ok;
+}
@@ -0,0 +1,61 @@
+#ifndef STREAMANALYZER_H_INCLUDED
+#define STREAMANALYZER_H_INCLUDED
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+#include "DecodePipeline.h"
+#include "SpectrumAnalyzer.h"
+
+/**
+\file StreamAnalyzer.h
+\brief Header file for StreamAnalyzer.cpp
+
+*/
+
+/**
+\class StreamAnalyzer
+
+\brief Analyses a decoded track from the blocks its DecodePipeline decodes for playback.
+
+The analysis takes every block of the file in order through the pipeline's analysis cursor, so
+the blocks decoded for playback are analysed where they lie and the track is decoded once.  Each
+block goes through SpectrumAnalyzer::analyseBlock on this class's thread, into the analyzer's
+own result, which was sized once for the whole track by beginStream, so its frames, views and
+onsets can be read as soon as each block is done.
+
+Frame and sample counts are 64 bit throughout.
+
+*/
+
+class StreamAnalyzer
+{
+private:
+    SpectrumAnalyzer* analyzer;                 ///< The analyzer of the track, set to the stream's format.
+    DecodePipeline* decoder;                    ///< The track's pipeline.
+    std::thread thread;                         ///< Background thread started by start.
+    std::atomic<bool> stopRequested;            ///< Asks the analysis to quit after its current block.
+    std::atomic<int> state;                     ///< 0 running or idle, 1 finished, -1 failed or stopped.
+
+    bool run(std::uint64_t cacheKey);
+
+    StreamAnalyzer(const StreamAnalyzer&);
+    StreamAnalyzer& operator=(const StreamAnalyzer&);
+
+public:
+    StreamAnalyzer();
+    ~StreamAnalyzer();
+
+    static std::uint64_t key(const SpectrumAnalyzer& settings, const std::string& audioPath, bool single);
+
+    bool analyse(SpectrumAnalyzer& target, DecodePipeline& source, std::uint64_t cacheKey);
+    void start(SpectrumAnalyzer& target, DecodePipeline& source, std::uint64_t cacheKey);
+    void stop();
+
+    bool isComplete() const;
+    bool hasFailed() const;
+};
+
+#endif // STREAMANALYZER_H_INCLUDED
@@ -0,0 +1,107 @@
+#ifndef TRACER_H_INCLUDED
+#define TRACER_H_INCLUDED
+
+#include <cstdint>
+#include <string>
+
+/**
+\file Tracer.h
+\brief Header file for Tracer.cpp
+
+Scoped trace events, written as Chrome Trace Event JSON that chrome://tracing and Perfetto open.
+Tracing is only compiled in when ENABLE_TRACING is defined, such as with -DENABLE_TRACING.
+Otherwise every macro expands to nothing and costs nothing.
+
+- TRACE_SCOPE("name") times from that line to the end of the enclosing scope.
+- TRACE_SPAN(var, "name") and TRACE_SPAN_END(var) time a span that does not fit a scope.
+- TRACE_THREAD_NAME("name") labels the calling thread in the trace.
+
+The names must be string literals, or at least outlive the trace, only the pointer is kept.
+
+*/
+
+bool saveTrace(const std::string& path);
+
+#ifdef ENABLE_TRACING
+
+#define TRACING_ENABLED true
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+#define TRACE_SPAN(var, name) TraceScope var(name)
+#define TRACE_SPAN_END(var) var.end()
+#define TRACE_THREAD_NAME(name) Tracer::setThreadName(name)
+
+/**
+\class Tracer
+
+\brief Keeps the trace events of every thread.
+
+Each thread gets its own buffer on its first event, a ring of the last TraceEventsPerThread
+events, so recording never locks or allocates and threads never share a cache line.  Only the
+owning thread writes a buffer: it copies the event into its slot and then publishes the count
+with a release store.  save reads every buffer from whichever thread calls it and drops any
+events that were overwritten while it copied them.  Buffers outlive their threads so the events
+of finished workers are still saved.
+
+An event costs two clock reads and one store.  The clock is the time stamp counter on x86 and
+the steady clock elsewhere, either way the trace has nanosecond timestamps.
+
+*/
+
+class Tracer
+{
+public:
+    static std::uint64_t now();
+    static void record(const char* name, std::uint64_t start, std::uint64_t end);
+    static void setThreadName(const char* name);
+    static bool save(const std::string& path);
+};
+
+/**
+\class TraceScope
+
+\brief Records one trace event from its construction to end() or its destruction.
+
+*/
+
+class TraceScope
+{
+private:
+    const char* name;       ///< The event's name, NULL once recorded.
+    std::uint64_t start;    ///< Start time in ticks, see Tracer::now.
+
+    TraceScope(const TraceScope&);
+    TraceScope& operator=(const TraceScope&);
+
+public:
+    explicit TraceScope(const char* n) : name(n), start(Tracer::now())
+    {
+    }
+
+    ~TraceScope()
+    {
+        end();
+    }
+
+    void end()
+    {
+        if (name != NULL)
+            Tracer::record(name, start, Tracer::now());
+        name = NULL;
+    }
+};
+
+#else
+
+#define TRACING_ENABLED false
+
+#define TRACE_SCOPE(name) ((void) 0)
+#define TRACE_SPAN(var, name) ((void) 0)
+#define TRACE_SPAN_END(var) ((void) 0)
+#define TRACE_THREAD_NAME(name) ((void) 0)
+
+#endif // ENABLE_TRACING
+
+#endif // TRACER_H_INCLUDED
@@ -1,4 +1,5 @@
 #include "Track.h"
+#include "Tracer.h"
 
 /*
 NEed to create methods, comment
@@ -7,6 +8,7 @@ NEed to create methods, comment
 
 
 Track::Track(){
+    TRACE_SCOPE("Track upload");
     glGenVertexArrays(1, &TrackVAO0);
     glGenBuffers(1, &TrackEBO0);
     glGenBuffers(1, &ArrayBuffer0);
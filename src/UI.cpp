@@ -1,4 +1,5 @@
 #include "UI.h"
+#include "Tracer.h"
 
 /**
 \file UI.cpp
@@ -146,6 +147,9 @@ void UI::processMouseButtonReleased(sf::Event::MouseButtonEvent mouseButtonEvent
 - F2: Sets the flag to draw a grid of boxes.
 - F3: Sets the flag to draw boxes.
 - F4: Sets the flag to hide boxes.
+- F7: Shows or hides the frame time graph.
+- F8: Saves the frame times of the last ProfilerFrames frames to a CSV file.
+- F9: Saves the trace so far to TracePath, in builds with ENABLE_TRACING.
 - F10: Saves a screen shot of the graphics window to a png file.
 - F11 or O: Turns on the spherical camera.
 - F12 or P: Turns on the yaw-pitch-roll camera.
@@ -182,6 +186,23 @@ void UI::keyPressed(sf::Event::KeyEvent keyevent)
         ge->setDrawAxes(GL_FALSE);
         break;
 
+    case sf::Keyboard::F7:
+        ge->toggleFrameGraph();
+        break;
+
+    case sf::Keyboard::F8:
+        ge->saveFrameProfile();
+        break;
+
+    case sf::Keyboard::F9:
+        if (!TRACING_ENABLED)
+            std::cerr << "Tracing is off, build with ENABLE_TRACING to record a trace." << std::endl;
+        else if (saveTrace(TracePath))
+            std::cout << "Saved the trace to " << TracePath << std::endl;
+        else
+            std::cerr << "Could not write " << TracePath << std::endl;
+        break;
+
     case sf::Keyboard::F10:
         ge->screenshot();
         break;
@@ -0,0 +1,190 @@
+#include "WavFile.h"
+
+#include <string.h>
+
+/**
+\file WavFile.cpp
+\brief RIFF/WAVE parsing over a file mapping.
+
+*/
+
+/**
+\brief Reads a little endian 16 bit field.
+
+*/
+
+static unsigned int readU16(const unsigned char* p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+/**
+\brief Reads a little endian 32 bit field.
+
+*/
+
+static std::uint32_t readU32(const unsigned char* p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((std::uint32_t) p[3] << 24);
+}
+
+/**
+\brief Constructor, nothing is open.
+
+*/
+
+WavFile::WavFile()
+{
+    close();
+}
+
+/**
+\brief Maps a WAV file and finds its samples.
+
+\param path --- the file to open.
+
+\return False if the file could not be mapped or is not a WAV file in a supported format.
+
+*/
+
+bool WavFile::open(const std::string& path)
+{
+    close();
+    if (!file.open(path) || !parse())
+    {
+        close();
+        return false;
+    }
+    return true;
+}
+
+/**
+\brief Walks the RIFF chunks for the format and the samples.
+
+\return False if the file is not a WAV file in a supported format.
+
+*/
+
+bool WavFile::parse()
+{
+    const unsigned char* base = file.data();
+    std::size_t size = file.size();
+
+    if (size < 12 || memcmp(base, "RIFF", 4) != 0 || memcmp(base + 8, "WAVE", 4) != 0)
+        return false;
+
+    unsigned int formatTag = 0, channels = 0, bits = 0;
+    bool haveFormat = false;
+    std::size_t pos = 12;
+
+    while (pos + 8 <= size)
+    {
+        const unsigned char* chunk = base + pos;
+        std::uint64_t chunkSize = readU32(chunk + 4);
+        std::size_t body = pos + 8;
+
+        if (memcmp(chunk, "fmt ", 4) == 0 && chunkSize >= 16 && body + 16 <= size)
+        {
+            formatTag = readU16(base + body);
+            channels = readU16(base + body + 2);
+            sampleRate = readU32(base + body + 4);
+            bits = readU16(base + body + 14);
+            if (formatTag == 0xFFFE && chunkSize >= 40 && body + 26 <= size)
+                formatTag = readU16(base + body + 24); // WAVE_FORMAT_EXTENSIBLE keeps the real tag in its sub format
+            haveFormat = true;
+        }
+        else if (memcmp(chunk, "data", 4) == 0 && haveFormat)
+        {
+            // Streaming writers can leave the size at 0 or 0xFFFFFFFF, the samples then run to the end.
+            if (chunkSize == 0 || body + chunkSize > size)
+                chunkSize = size - body;
+
+            if (formatTag == 1 && bits == 16)
+                samples.format = SampleInt16;
+            else if (formatTag == 1 && bits == 24)
+                samples.format = SampleInt24;
+            else if (formatTag == 3 && bits == 32)
+                samples.format = SampleFloat32;
+            else
+                return false;
+
+            if (channels == 0 || sampleRate == 0)
+                return false;
+
+            std::uint64_t frameBytes = sampleBytes(samples.format) * channels;
+            samples.data = base + body;
+            samples.channels = channels;
+            samples.count = (chunkSize / frameBytes) * channels; // whole frames only
+            return true;
+        }
+
+        pos = body + chunkSize + (chunkSize & 1); // chunks are padded to an even size
+    }
+
+    return false;
+}
+
+/**
+\brief Unmaps the file.
+
+*/
+
+void WavFile::close()
+{
+    file.close();
+    samples.data = NULL;
+    samples.format = SampleInt16;
+    samples.count = 0;
+    samples.channels = 0;
+    sampleRate = 0;
+}
+
+/**
+\brief Returns true if a WAV file is open.
+
+*/
+
+bool WavFile::isOpen() const
+{
+    return samples.data != NULL;
+}
+
+/**
+\brief Returns the samples, in place in the mapping.
+
+*/
+
+const SampleSpan& WavFile::getSamples() const
+{
+    return samples;
+}
+
+/**
+\brief Returns the sample rate in frames per second.
+
+*/
+
+unsigned int WavFile::getSampleRate() const
+{
+    return sampleRate;
+}
+
+/**
+\brief Returns the number of channels.
+
+*/
+
+unsigned int WavFile::getChannelCount() const
+{
+    return samples.channels;
+}
+
+/**
+\brief Returns the number of samples over all channels.
+
+*/
+
+std::uint64_t WavFile::getSampleCount() const
+{
+    return samples.count;
+}
@@ -0,0 +1,52 @@
+#ifndef WAVFILE_H_INCLUDED
+#define WAVFILE_H_INCLUDED
+
+#include <cstdint>
+#include <string>
+
+#include "MappedFile.h"
+#include "SampleFormat.h"
+
+/**
+\file WavFile.h
+\brief Header file for WavFile.cpp
+
+*/
+
+/**
+\class WavFile
+
+\brief A WAV file mapped into memory, with its samples exposed in place.
+
+Reads the RIFF chunks to find the format and the data chunk.  Nothing is decoded or copied, the
+sample span points straight into the mapping, so it stays valid while the WavFile is open.
+16 bit, 24 bit and 32 bit float PCM are supported, including WAVE_FORMAT_EXTENSIBLE files.
+
+*/
+
+class WavFile
+{
+private:
+    MappedFile file;            ///< Mapping of the whole file.
+    SampleSpan samples;         ///< The data chunk.
+    unsigned int sampleRate;    ///< Frames per second.
+
+    bool parse();
+
+    WavFile(const WavFile&);
+    WavFile& operator=(const WavFile&);
+
+public:
+    WavFile();
+
+    bool open(const std::string& path);
+    void close();
+
+    bool isOpen() const;
+    const SampleSpan& getSamples() const;
+    unsigned int getSampleRate() const;
+    unsigned int getChannelCount() const;
+    std::uint64_t getSampleCount() const;
+};
+
+#endif // WAVFILE_H_INCLUDED
@@ -0,0 +1,89 @@
+#include "WindowFunction.h"
+
+/**
+\file WindowFunction.cpp
+\brief Coefficients of the analysis windows.
+
+The windows are periodic, the form used for overlapping frames, so a Hann window at 50% or 75%
+overlap sums to a constant.
+
+*/
+
+/**
+\brief Modified Bessel function of the first kind, order zero, by its power series.
+
+*/
+
+static double besselI0(double x)
+{
+    double sum = 1;
+    double term = 1;
+    double halfX = x / 2;
+
+    for (int k = 1; k < 50; k++)
+    {
+        term *= (halfX / k) * (halfX / k);
+        sum += term;
+        if (term < sum * 1e-17)
+            break;
+    }
+    return sum;
+}
+
+/**
+\brief Fills coeffs with a window.
+
+\param type --- which window.
+\param size --- number of coefficients, the frame length.
+\param coeffs --- output, size coefficients.
+\param beta --- shape of the Kaiser window, ignored by the others.
+
+*/
+
+void buildWindow(WindowType type, int size, std::vector<double>& coeffs, double beta)
+{
+    coeffs.assign(size > 0 ? size : 0, 1.0);
+
+    for (int n = 0; n < size; n++)
+    {
+        double phase = 2 * 3.14159265358979323846 * n / size;
+
+        switch (type)
+        {
+        case WindowHann:
+            coeffs[n] = 0.5 - 0.5 * cos(phase);
+            break;
+        case WindowBlackmanHarris:
+            coeffs[n] = 0.35875 - 0.48829 * cos(phase) + 0.14128 * cos(2 * phase) - 0.01168 * cos(3 * phase);
+            break;
+        case WindowKaiser:
+        {
+            double r = 2.0 * n / size - 1;
+            coeffs[n] = besselI0(beta * sqrt(1 - r * r)) / besselI0(beta);
+            break;
+        }
+        default:
+            break;
+        }
+    }
+}
+
+/**
+\brief Returns the window's name, for logs and benchmarks.
+
+*/
+
+const char* windowName(WindowType type)
+{
+    switch (type)
+    {
+    case WindowHann:
+        return "hann";
+    case WindowBlackmanHarris:
+        return "blackman-harris";
+    case WindowKaiser:
+        return "kaiser";
+    default:
+        return "rectangular";
+    }
+}
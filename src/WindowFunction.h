@@ -0,0 +1,29 @@
+#ifndef WINDOWFUNCTION_H_INCLUDED
+#define WINDOWFUNCTION_H_INCLUDED
+
+#include <vector>
+#include <math.h>
+
+/**
+\file WindowFunction.h
+\brief Header file for WindowFunction.cpp
+
+*/
+
+/**
+\brief Window applied to each analysis frame before the FFT.
+
+*/
+
+enum WindowType
+{
+    WindowRectangular,      ///< No window, the original non-overlapping frames.
+    WindowHann,             ///< Raised cosine, a good default for overlapping frames.
+    WindowBlackmanHarris,   ///< Four term Blackman-Harris, very low side lobes.
+    WindowKaiser            ///< Kaiser, side lobes traded against main lobe width by beta.
+};
+
+void buildWindow(WindowType type, int size, std::vector<double>& coeffs, double beta = 8.6);
+const char* windowName(WindowType type);
+
+#endif // WINDOWFUNCTION_H_INCLUDED
@@ -1,4 +1,5 @@
 #include "fft_SFML.h"
+#include "Tracer.h"
 /**
 \file fft_SFML.cpp
 \brief Performs FFT, open audio buffer and interprets data.
@@ -14,47 +15,76 @@ This class Performs FFT and plays with audio.
 /**
 \brief Constructor
 
-\param in --- path to audio file, set to default which is included in package.
+\param input --- InputFile to play tracks, InputDevice or InputStdin to visualise live input.
+\param paths --- the tracks to play in order, unused for live input.
 
-Creates rendering window, loads the shaders, and sets some initial data settings.
+Maps the first track and points the player and the analyser at its samples. Nothing is decoded
+up front. A file WavFile can't read, such as an ogg or flac file, is decoded by SFML a block at a
+time ahead of playback and each block is analysed as it is decoded, see PreparedTrack.
+The tracks after the first are prepared by the playlist once the analysis starts, see advanceTrack.
+In live mode no file is opened, the bars come from the live analyser.
 
 */
-fft_SFML::fft_SFML(){
-    audioPath = "./excitable.wav"; ///ask for path to file or use default path
-    //audioPath = "./highlands.wav";
+fft_SFML::fft_SFML(InputMode input, const std::vector<std::string>& paths){
+    inputMode = input;
+    onsetFrame = 0;
+    onsetsSeen = 0;
+    track = new PreparedTrack; ///stays empty in live mode
+    queuedTrack = NULL;
+    trackSerial = 0;
+    started = false;
+    if(isLive()){
+        live.setInput(inputMode, LiveSampleRate);
+        live.setBandLayout(BandLayout(DefaultBandScale, DefaultBandCount));
+        live.setWindow(AnalysisWindowType);
+        if(AnalysisFrameRate > 0)
+            setFrameRate(AnalysisFrameRate);
+        else
+            live.setHopSize(AnalysisHopSize);
+        return;
+    }
 
-    soundBuffer.loadFromFile(audioPath); ///Load audio from the audio path
-    audio.setBuffer(soundBuffer); ///set buffer to the sound
+    trackPaths = paths; ///the tracks given on the command line, or DefaultTrackPath
+    if(!trackPaths.empty())
+        track->open(trackPaths[0]); ///mapped or decoded ahead of playback, never whole
+    setAudioSource();
     audio.setLoop(false); ///set loop to false
-    counter1 = 0; ///initialize counter1
-
-    numSamples = soundBuffer.getSampleCount(); ///grabs the number of samples within the audio file
-    audioSamples.assign(soundBuffer.getSamples(), soundBuffer.getSamples() + soundBuffer.getSampleCount() );///assigns the audio samples to the vector
-    sampleRate = soundBuffer.getSampleRate();///get the sample rate of the audio, samples per second
-    overallPeakMag[0] = 0;///initializing Data
-    overallPeakMag[1] = 0;
-    overallPeakMag[2] = 0;
-    overallPeakMag[3] = 0;
-    overallPeakMag[4] = 0;
-    timePerVisual = 1/(sampleRate/(float)fftBuffer); ///calculating time between each visual
-
-    peakMag = (double *)malloc( (((numSamples/fftBuffer) * 5 ) +1) * sizeof(double)); ///allocate memory for holding peak mags per freq
-    //zero  out peak magnitude
-    for(int i = 0; i <= (numSamples/fftBuffer)*5; i++){
-        peakMag[i] = 0; ///zero out the peakmags
-    }
+
+    SpectrumAnalyzer& analyzer = track->getAnalyzer();
+    analyzer.setBandLayout(BandLayout(DefaultBandScale, DefaultBandCount)); ///how the spectrum is split into bars
+    analyzer.setChannelMode(AnalysisChannelMode); ///the analyser splits or mixes the channels and converts each frame as it windows it
+    analyzer.setResultLayout(AnalysisResultLayout);
+    analyzer.setWindow(AnalysisWindowType);
+    if(AnalysisFrameRate > 0)
+        setFrameRate(AnalysisFrameRate);
+    else
+        analyzer.setHopSize(AnalysisHopSize);
+
+    if(std::string(TimelinePath) != "")
+        openTimeline(TimelinePath); ///bars from a saved timeline, the track is then not analysed
 }
 /**
 \brief Destructor
 
-Destroy plan and free the results complex structure. Also delete the frames and peakmag allocation
+The stream lets go of the track before it goes, the playlist deletes the ones it still holds.
 
 */
 fft_SFML::~fft_SFML(){
-    fftw_destroy_plan(plan);
-    fftw_free(result);
-    delete frames;
-    delete peakMag;
+    audio.clearSource();
+    live.pause();
+    playlist.stop();
+    delete track;
+}
+/**
+\brief Point the stream at the current track, from its start
+
+*/
+void fft_SFML::setAudioSource(){
+    if(track->isDecoded())
+        audio.setSource(track->getDecoder()); ///SFML plays the decoded blocks where they lie
+    else
+        audio.setSource(track->getSamples(), track->getSampleRate()); ///playback streams from the same samples
+    trackSerial = 0;
 }
 
 
@@ -63,134 +93,448 @@ fft_SFML::~fft_SFML(){
 
 */
 void fft_SFML::soundStart(){
-    audio.play();
+    if(isLive())
+        live.start();
+    else
+        audio.play();
+    started = true;
 }
 /**
 \brief Pause the audio
 
 */
 void fft_SFML::soundPause(){
-    audio.pause();
+    if(isLive())
+        live.pause();
+    else
+        audio.pause();
+}
+/**
+\brief Set the FFTW planner flags
+
+\param flags --- FFTW_ESTIMATE, FFTW_MEASURE or FFTW_PATIENT.
+
+*/
+void fft_SFML::setPlannerFlags(unsigned flags){
+    track->getAnalyzer().setPlannerFlags(flags);
+}
+/**
+\brief Set the number of analysis threads
+
+*/
+void fft_SFML::setThreadCount(unsigned count){
+    track->getAnalyzer().setThreadCount(count);
+}
+/**
+\brief Turn batched transforms on or off
+
+*/
+void fft_SFML::setBatchMode(bool on){
+    track->getAnalyzer().setBatchMode(on);
+}
+/**
+\brief Set the hop between analysis frames
+
+\param hop --- samples between frame starts, fftBuffer for no overlap.
+
+*/
+void fft_SFML::setHopSize(int hop){
+    if(isLive())
+        live.setHopSize(hop);
+    else
+        track->getAnalyzer().setHopSize(hop);
+}
+/**
+\brief Set the hop so there is one analysis frame per display refresh
+
+\param hz --- frames per second, e.g. 120 or 144.
+
+The frame rate is kept with the analysis settings the playlist copies, so each track works the
+hop out for its own sample rate.
+
+*/
+void fft_SFML::setFrameRate(float hz){
+    if(isLive()){
+        if(hz > 0)
+            live.setHopSize((int)(LiveSampleRate / hz + 0.5f));
+    }
+    else
+        track->getAnalyzer().setFrameRate(hz);
+}
+/**
+\brief Set the window applied to each analysis frame
+
+*/
+void fft_SFML::setWindow(WindowType type){
+    if(isLive())
+        live.setWindow(type);
+    else
+        track->getAnalyzer().setWindow(type);
+}
+/**
+\brief Draw the bars from a saved timeline instead of analysing the track
+
+\param path --- a timeline written by saveTimeline.
+
+\return False if the file could not be opened, the track is then analysed as usual.
+
+*/
+bool fft_SFML::openTimeline(const std::string& path){
+    return track->openTimeline(path);
+}
+/**
+\brief Save the finished analysis as a compact timeline
+
+\param path --- the file to write.
+\param bits --- 8 or 16 bits per band value.
+\param view --- which view to save, see getViewCount.
+
+*/
+bool fft_SFML::saveTimeline(const std::string& path, int bits, int view){
+    return track->saveTimeline(path, bits, view);
 }
 /**
 \brief Perform the fft on the whole data of the audio
+
 */
 void fft_SFML::performFFT(){
-    //Perform FFT on set of Data
-    int buffLen = fftBuffer;
-    int numFftSamples = numSamples / fftBuffer; ///num of fftSamples
-
-    frames = (double *) malloc(fftBuffer * sizeof(double));///allocating memory
-
-    for(int i = 0; i <= numFftSamples; i++){
-        if(numSamples % fftBuffer != 0){
-            if(i == numFftSamples)
-                buffLen = numSamples - (numFftSamples * fftBuffer); ///incase there are left over samples
-        }
-        else{
-            if(i == numFftSamples){
-                return;
-            }
-        }
-
-        frames = &audioSamples[fftBuffer * i]; ///needed for the fftw plan
-        plan = fftw_plan_dft_r2c_1d(buffLen, frames, result, FFTW_ESTIMATE); ///the plan of execution to perfomr the fft
-        fftw_execute(plan); ///plan execution
-        for(int i = 0; i < buffLen/2; i++){
-            int freq = ( i * sampleRate / buffLen); ///determine the freq
-            double mag = sqrt((result[i][0] * result[i][0]) + (result[i][1] * result[i][1]) ); ///calculate the magnitude
-
-                if(freq > 19 && freq <= 140){
-                    if(mag > peakMag[counter1]){
-                        peakMag[counter1] = mag;
-                    }
-                    if(mag > overallPeakMag[0]){
-                            overallPeakMag[0] = mag;
-                        }
-                }
-                else if(freq >140 && freq <=400){
-                    if(mag > peakMag[counter1 + 1]){
-                        peakMag[counter1 + 1] = mag;
-                    }
-                    if(mag > overallPeakMag[1]){
-                            overallPeakMag[1] = mag;
-                        }
-                }
-                else if(freq > 400 && freq <= 2600){
-                    if(mag > peakMag[counter1 + 2]){
-                        peakMag[counter1 + 2] = mag;
-                    }
-                    if(mag > overallPeakMag[2]){
-                            overallPeakMag[2] = mag;
-                        }
-                }
-                else if(freq > 2600 && freq <= 5200){
-                    if(mag > peakMag[counter1 + 3]){
-                        peakMag[counter1 + 3] = mag;
-                    }
-                    if(mag > overallPeakMag[3]){
-                            overallPeakMag[3] = mag;
-                        }
-                }
-                else if(freq > 5200){
-                    if(mag > peakMag[counter1 + 4]){
-                        peakMag[counter1 + 4] = mag;
-                    }
-                    if(mag > overallPeakMag[4]){
-                            overallPeakMag[4] = mag;
-                        }
-                }
-        }
-
-        counter1+= 5;
+    track->getAnalyzer().performFFT();
+}
+/**
+\brief Run the analysis on a background thread, and start preparing the rest of the playlist
+
+The tracks after the first are analysed with the first track's settings, so call after any setter.
+
+*/
+void fft_SFML::startAnalysis(){
+    if(isLive())
+        return;
+    playlist.start(trackPaths, 1, track->getAnalyzer(), PlaylistPrepareAhead);
+    track->startAnalysis();
+}
+/**
+\brief Move on to the next track once it is being heard, call once per drawn frame before reading any frames
+
+The next track is queued on the stream as soon as the playlist has it ready, and the audio thread
+moves on to it at the exact sample the track before ends, so the two play without a gap. Here
+the render thread follows once the next track is being heard, swapping its analysis in by
+pointer, and the track before goes back to the playlist to be deleted off this thread. A track
+with another sample rate or channel count, or one that was not ready in time, starts as soon as
+the one before has stopped.
+
+\return True if a new track is now current, its frames and band peaks start again from 0.
+
+*/
+bool fft_SFML::advanceTrack(){
+    if(isLive())
+        return false;
+
+    PreparedTrack* next = playlist.peekNext();
+    if(next == NULL)
+        return false;
+    if(queuedTrack == NULL){
+        bool queued = next->isDecoded() ? audio.queueSource(next->getDecoder())
+                                        : audio.queueSource(next->getSamples(), next->getSampleRate());
+        if(queued)
+            queuedTrack = next;
     }
 
+    unsigned int heard = trackSerial;
+    audio.getPlaybackSample(&heard);
+    bool ended = started && audio.getStatus() == sf::SoundSource::Stopped;
+    if(heard == trackSerial && !ended)
+        return false;
+
+    PreparedTrack* old = track;
+    track = playlist.takeNext();
+    queuedTrack = NULL;
+    onsetFrame = 0;
+    if(heard == trackSerial){ ///the stream ran out before it could move on, start it again on the new track
+        setAudioSource();
+        audio.play();
+    }
+    else{
+        trackSerial = heard;
+    }
+    playlist.retire(old); ///the stream has let go of it either way
+    return true;
+}
+/**
+\brief Return the path of the track being heard
+
+*/
+std::string fft_SFML::getTrackPath(){
+    return track->getPath();
+}
+/**
+\brief Return how many leading frames have been analysed
+
+*/
+int fft_SFML::getFramesReady(){
+    if(isLive())
+        return live.getFramesPublished();
+    return track->getFramesReady();
+}
+/**
+\brief Return true once every frame has been analysed
+
+*/
+bool fft_SFML::isAnalysisComplete(){
+    if(isLive())
+        return false; ///live input is never done, the band peaks keep moving
+    return track->isAnalysisComplete();
 }
 /**
-\brief get the array filled with magnitudes of fft data
+\brief Copy the band magnitudes of one frame
+
+\param frame --- the frame index.
+\param mags --- getBandCount() values to fill.
+\param view --- which view, from 0 to getViewCount() - 1.
+
+\return False if the frame has not been analysed yet.
 
 */
-void fft_SFML::getPeakMag(double* array_to_be_filled){
-    for(int i = 0; i < (numSamples/fftBuffer) *5; i++){
-        array_to_be_filled[i] = peakMag[i];
+bool fft_SFML::getFrameMags(int frame, double* mags, int view){
+    if(isLive())
+        return live.getLatest(mags); ///always the newest frame
+    return track->getFrameMags(frame, mags, view);
+}
+/**
+\brief Return the band magnitudes of one analysed frame where they lie, see getFrames
+
+*/
+ValueSpan fft_SFML::getFrame(int frame, int view){
+    if(isLive()){
+        ValueSpan none = {NULL, 0, 1};
+        return none;
+    }
+    return track->getFrame(frame, view);
+}
+/**
+\brief Return the band magnitudes of a run of analysed frames where they lie
+
+\param first --- the first frame.
+\param count --- frames wanted, cut short at the frames analysed so far.
+\param view --- which view, from 0 to getViewCount() - 1.
+
+Empty for live input and for a track read from a timeline, their frames are read with getFrameMags.
+The span is the current track's and is not valid past advanceTrack.
+
+*/
+FrameSpan fft_SFML::getFrames(int first, int count, int view){
+    if(isLive()){
+        FrameSpan none = {NULL, 0, (std::size_t)getBandCount(), 1, 1};
+        return none;
+    }
+    return track->getFrames(first, count, view);
+}
+/**
+\brief Return the history of one band over the analysed frames, see getFrames
+
+*/
+ValueSpan fft_SFML::getBand(int band, int view){
+    if(isLive()){
+        ValueSpan none = {NULL, 0, 1};
+        return none;
     }
+    return track->getBand(band, view);
 }
 /**
 \brief Return the time per visual
 
 */
 float fft_SFML::getTimePerVisual(){
-    return timePerVisual;
+    if(isLive())
+        return live.getHopSize() / (float)live.getSampleRate();
+    return track->getTimePerVisual();
+}
+/**
+\brief Return the number of samples of the track being heard, over all channels
+
+*/
+std::uint64_t fft_SFML::getNumSamples(){
+    return track->getSamples().count;
+}
+
+/**
+\brief Return the number of analysis frames
+
+*/
+int fft_SFML::getNumFrames(){
+    if(isLive())
+        return live.getFramesPublished();
+    return track->getNumFrames();
+}
+
+/**
+\brief Return the number of bands per frame
+
+*/
+int fft_SFML::getBandCount(){
+    if(isLive())
+        return live.getBandCount();
+    return track->getBandCount();
+}
+
+/**
+\brief Return the number of views, the sets of bands per frame
+
+More than one when the channels are analysed separately, live input and timelines have one.
+
+*/
+int fft_SFML::getViewCount(){
+    if(isLive())
+        return 1;
+    return track->getViewCount();
+}
+
+/**
+\brief Set how the channels of the track are analysed
+
+\param mode --- a downmix, every channel on its own, or mid and side.
+
+Resets the analysis, call before startAnalysis.
+
+*/
+void fft_SFML::setChannelMode(ChannelMode mode){
+    track->getAnalyzer().setChannelMode(mode);
 }
+
 /**
-\brief Return the number of samples
+\brief Set how the spectrum is split into bands
+
+\param bands --- the band layout.
+
+Resets the analysis, call before startAnalysis.
 
 */
-int fft_SFML::getNumSamples(){
-    return numSamples;
+void fft_SFML::setBandLayout(const BandLayout& bands){
+    if(isLive())
+        live.setBandLayout(bands);
+    else
+        track->getAnalyzer().setBandLayout(bands);
 }
 
 /**
 \brief get the max mag data
 
+While the analysis is still running this is the max over the frames done so far.
+
 */
-void fft_SFML::getMaxMag( double* overallMagArr){
-    for(int i = 0; i < 5; i ++){
-            overallMagArr[i] = overallPeakMag[i];
-    }
+void fft_SFML::getMaxMag( double* overallMagArr, int view){
+    if(isLive())
+        live.getMaxMag(overallMagArr); ///decaying peak, see LivePeakHalfLife
+    else
+        track->getMaxMag(overallMagArr, view);
 }
 /**
 \brief Return Playing offset of audio
 
+Comes from the stream's playback clock, so it is cheap to call every frame.
+
 */
 float fft_SFML::grabPlayingOffset(){
-    //printf("%.6f",  audio.getPlayingOffset().asSeconds());
-    return audio.getPlayingOffset().asSeconds();
+    if(isLive())
+        return 0;
+    const SampleSpan& samples = track->getSamples();
+    if(samples.channels == 0 || track->getSampleRate() == 0)
+        return 0;
+    return (float)((double)(audio.getPlaybackSample() / samples.channels) / track->getSampleRate());
+}
+/**
+\brief Return the analysis frame for the audio being heard now
+
+The frame whose window is centred nearest the playback sample, so the bars are never more than
+half a hop away from the audio whatever the display rate. Once the next track can be heard and
+until advanceTrack swaps it in, this is the current track's last frame.
+
+*/
+int fft_SFML::getPlaybackFrame(){
+    if(isLive())
+        return live.getFramesPublished(); ///changes whenever a new frame is ready
+    int frames = getNumFrames();
+    int hop = track->getHopSize();
+    int frameLength = track->getFrameLength();
+    if(frames == 0 || hop <= 0)
+        return 0;
+
+    unsigned int channels = track->getSamples().channels;
+    if(channels == 0)
+        return 0;
+
+    unsigned int heard = trackSerial;
+    std::uint64_t sample = audio.getPlaybackSample(&heard);
+    if(heard != trackSerial)
+        return frames - 1;
+
+    std::int64_t centred = (std::int64_t)(sample / channels) - frameLength/2 + hop/2; ///frames are counted per channel, the way the analysis counts them
+    int frame = (centred > 0) ? (int)(centred / hop) : 0;
+    return (frame < frames) ? frame : frames - 1;
 }
 /**
 \brief return whether or not the audio is playing
 
 */
 sf::SoundSource::Status fft_SFML::isPlaying(){
+    if(isLive())
+        return live.isRunning() ? sf::SoundSource::Playing : sf::SoundSource::Paused;
     return audio.getStatus();
 }
+/**
+\brief Return true when visualising live input rather than a track
+
+*/
+bool fft_SFML::isLive(){
+    return inputMode != InputFile;
+}
+/**
+\brief Return true when the track being heard is decoded a block at a time rather than mapped
+
+*/
+bool fft_SFML::isDecoded(){
+    return track->isDecoded();
+}
+/**
+\brief Note that the frame last read has been drawn and swapped
+
+Call after the buffer swap, live mode times the frame from input to screen.
+
+*/
+void fft_SFML::markDisplayed(){
+    if(isLive())
+        live.markDisplayed();
+}
+/**
+\brief Get the input to bar latency of live mode
+
+\param mean --- output, mean over the frames shown since the last call, in milliseconds.
+\param worst --- output, worst over the same frames.
+
+\return False if not live or nothing has been shown since the last call.
+
+*/
+bool fft_SFML::getInputLatency(double* mean, double* worst){
+    return isLive() && live.getLatency(mean, worst);
+}
+/**
+\brief Return the onsets heard since the last call, call once per drawn frame
+
+A track's onsets are counted up to the playback frame, seeking back starts the count again from there.
+Timelines carry no onsets.
+
+*/
+int fft_SFML::takeOnsets(){
+    if(isLive()){
+        int total = live.getOnsetCount();
+        int fresh = total - onsetsSeen;
+        onsetsSeen = total;
+        return fresh;
+    }
+
+    int frame = getPlaybackFrame() + 1;
+    if(frame < onsetFrame)
+        onsetFrame = frame;
+    int fresh = track->countOnsets(onsetFrame, frame);
+    onsetFrame = frame;
+    return fresh;
+}
@@ -5,8 +5,13 @@
 
 //#include    "programDefines.h"
 #include    "ProgramDefines.h"
-#include	<fftw3.h>
+#include    "SpectrumAnalyzer.h"
+#include    "AudioStream.h"
+#include    "PreparedTrack.h"
+#include    "Playlist.h"
+#include    "LiveAnalyzer.h"
 #include <vector>
+#include <string>
 #include    <math.h>
 //#include    "callback.h"
 //#include "Box.h"
@@ -37,27 +42,22 @@ This class performs the FFT and manipulates the audio buffer.
 
 class fft_SFML {
 private:
-    //soundBuffer which interacts with the audio file.
-    sf::SoundBuffer soundBuffer; ///<sound buffer
-    sf::Sound audio; ///< audio obj
-    float timePerVisual; ///<Time per visual
-    //holds sample data....Perform FFT on this
-    std::vector<double> audioSamples; ///<actual audio samples
-
-    std::uint64_t numSamples; ///< Num of samples
-    unsigned int sampleRate; ///<Sample Rate
-    //points to the next sample.
-    std::size_t m_currentSample;
-
-    const char* audioPath;  ///< audio path for wav file
-
-    double *frames, *peakMag, overallPeakMag[5];  ///< frames are sample data for FFT, peakmag holds data per frequencies, and overall peak mag holds max mags per freq
-
-    int counter1, magIndex; ///<counter 1 is for general,
-
-    fftw_complex result[fftBuffer];///<Complex buffer which holds the FFT data
-
-    fftw_plan plan;///<the plan or course of execution to perform the FFT
+    //the tracks, each mapped in place when it is a WAV file and decoded by SFML a block at a time when it is not.
+    std::vector<std::string> trackPaths; ///<the playlist, in order
+    PreparedTrack* track; ///<the track being heard and its analysis, empty for live input, render thread only
+    PreparedTrack* queuedTrack; ///<the next track once it is queued on audio to follow track, or NULL
+    unsigned int trackSerial; ///<audio's number for the source of track
+    bool started; ///<soundStart was called, a stopped stream has then played to its end
+    Playlist playlist; ///<prepares the tracks after track
+    AudioStream audio; ///< audio obj, streams from the track's samples
+
+    InputMode inputMode; ///<a track, or live input analysed as it arrives
+    LiveAnalyzer live; ///<analyses the live input, unused for a track
+
+    int onsetFrame; ///<frames before this have had their onsets taken, render thread only
+    int onsetsSeen; ///<live onsets taken so far, render thread only
+
+    void setAudioSource();
 /*
 Sample rate(number of samples read per second)
 Samples (number of samples to be read; the amplitude of the signal to be played)
@@ -70,21 +70,54 @@ we can ask the time offset of where the audio is and when it reaches certain che
 
 public:
     //Constructor
-    fft_SFML();
+    fft_SFML(InputMode input = InputFile, const std::vector<std::string>& paths = std::vector<std::string>(1, DefaultTrackPath));
     //Destructor
     ~fft_SFML();
     //playFunct
     void soundStart();
     void soundPause();
-    void getPeakMag(double*);
+    ValueSpan getFrame(int, int view = 0);
+    FrameSpan getFrames(int, int, int view = 0);
+    ValueSpan getBand(int, int view = 0);
     float getTimePerVisual();
-    int getNumSamples();
-    void getMaxMag(double*);
+    std::uint64_t getNumSamples();
+    int getNumFrames();
+    int getBandCount();
+    int getViewCount();
+    void setChannelMode(ChannelMode);
+    void setBandLayout(const BandLayout&);
+    void getMaxMag(double*, int view = 0);
     float grabPlayingOffset();
+    int getPlaybackFrame();
     sf::SoundSource::Status isPlaying();
 
     //FTTdata
     void performFFT();
+    void startAnalysis();
+    int getFramesReady();
+    bool isAnalysisComplete();
+    bool getFrameMags(int, double*, int view = 0);
+    void setPlannerFlags(unsigned);
+    void setThreadCount(unsigned);
+    void setBatchMode(bool);
+    void setHopSize(int);
+    void setFrameRate(float);
+    void setWindow(WindowType);
+    bool openTimeline(const std::string&);
+    bool saveTimeline(const std::string&, int bits = 8, int view = 0);
+
+    //live input
+    bool isLive();
+    bool isDecoded();
+    void markDisplayed();
+    bool getInputLatency(double*, double*);
+
+    //playlist
+    bool advanceTrack();
+    std::string getTrackPath();
+
+    //onsets
+    int takeOnsets();
 
     //do windowing function if I have time
 
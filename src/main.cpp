@@ -10,9 +10,11 @@
 #include <SFML/System.hpp>
 #include <iostream>
 #include <string>
+#include <vector>
 
 #include "GraphicsEngine.h"
 #include "UI.h"
+#include "Tracer.h"
 
 /**
 \mainpage Cameras & Basic 3-D Setup
@@ -40,6 +42,11 @@ was loaded to the shader.
 - F2: Sets the flag to draw a grid of boxes.
 - F3: Sets the flag to draw boxes.
 - F4: Sets the flag to hide boxes.
+- F7: Shows or hides a graph of the last few seconds of frame times, split into the phases
+  of the frame, with a line at the 99th percentile.
+- F8: Saves the phase times of the last frames to FrameProfile###.csv.
+- F9: Saves the trace of the startup and the frames so far to TracePath, in builds with
+  ENABLE_TRACING.  Quitting saves it too.  chrome://tracing and Perfetto open the file.
 - F10: Saves a screen shot of the graphics window to a png file.
 - F11 or O: Turns on the spherical camera.
 - F12 or P: Turns on the yaw-pitch-roll camera.
@@ -85,6 +92,20 @@ If the spherical camera is currently selected, a click and drag with the left mo
 button will alter the theta and psi angles of the spherical camera to give the impression
 of the mouse grabbing and moving the coordinate system.
 
+\subsection commandline Command Line
+
+- No options: plays and visualises the default track, DefaultTrackPath.
+- One or more file names: plays and visualises those tracks instead, in order as a playlist.
+  While one track plays the next is opened and analysed in the background, and it follows on
+  without a gap when its sample rate and channels match, see PlaylistPrepareAhead.
+- --no-vsync: Draws as fast as possible instead of syncing to the display, see SetVS.
+- --live: Visualises the default recording device, such as line-in, as it is captured.
+- --stdin: Visualises raw mono 16 bit PCM at 44.1 kHz read from standard input, for example
+  piped from ffmpeg with -f s16le -ac 1 -ar 44100.
+
+In either live mode the title bar shows the mean and worst input to bar latency over the
+last second.
+
 \note Note that the shader programs "VertexShaderBasic3D.glsl" and "PassThroughFrag.glsl"
 are expected to be in the same folder as the executable.  Your graphics card must also be
 able to support OpenGL version 3.3 to run this program.
@@ -132,6 +153,9 @@ the user interface processor.
 /**
 \brief The Main function, program entry point.
 
+\param argc --- number of command line arguments.
+\param argv --- the arguments, see the command line section of the main page.
+
 \return Standard EXIT_SUCCESS return on successful run.
 
 The main function, responsible for initializing OpenGL and setting up
@@ -139,7 +163,7 @@ the SFML interface for OpenGL.
 
 */
 
-int main()
+int main(int argc, char** argv)
 {
     //  Program setup variables.
     std::string programTitle = "Cameras & Basic 3D";
@@ -148,6 +172,23 @@ int main()
     GLint WindowWidth = 700;
     GLint WindowHeight = 500;
     bool DisplayInfo = true;
+    InputMode input = InputFile;
+    std::vector<std::string> playlist;
+    bool vsync = SetVS;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::string(argv[i]) == "--live")
+            input = InputDevice;
+        else if (std::string(argv[i]) == "--stdin")
+            input = InputStdin;
+        else if (std::string(argv[i]) == "--no-vsync")
+            vsync = false;
+        else if (argv[i][0] != '-')
+            playlist.push_back(argv[i]);
+    }
+    if (playlist.empty())
+        playlist.push_back(DefaultTrackPath);
 
     //  Other variables
     GLint major;
@@ -155,22 +196,30 @@ int main()
     sf::Clock clock;
     sf::Time time = clock.restart();
     long framecount = 0;
+    std::vector<FrameRecord> lastSecond;
+
+    TRACE_THREAD_NAME("main");
+    TRACE_SPAN(startupSpan, "startup");
 
     // Try core context of 10.10 (too advanced) and see what card will resort to.
     // For setting up OpenGL, GLEW, and check versions.
+    TRACE_SPAN(probeSpan, "probe window");
     sf::RenderWindow window(sf::VideoMode(WindowWidth, WindowHeight), "OpenGL Setup", sf::Style::Default,
                             sf::ContextSettings(24, 8, 4, 10, 10, sf::ContextSettings::Core));
 
     window.setVisible(false);
+    TRACE_SPAN_END(probeSpan);
 
 #ifndef __APPLE__
     // Turn on GLEW for Windows and Linux.
+    TRACE_SPAN(glewSpan, "GLEW init");
     glewExperimental = true;
     if (glewInit())
     {
         std::cerr << "\nUnable to initialize GLEW ... exiting. \n";
         exit(EXIT_FAILURE);
     }
+    TRACE_SPAN_END(glewSpan);
 #endif // __APPLE__
 
     //  Get major and minor OpenGL version from graphics card.
@@ -204,20 +253,35 @@ int main()
         std::cout << "\n";
     }
     //  Close setup window and context.
-    window.close();
+    {
+        TRACE_SCOPE("probe window close");
+        window.close();
+    }
 
     //  Create graphics engine.
-    GraphicsEngine ge(programTitle, major, minor, WindowWidth, WindowHeight);
+    TRACE_SPAN(engineSpan, "GraphicsEngine");
+    GraphicsEngine ge(programTitle, major, minor, WindowWidth, WindowHeight, input, playlist, vsync);
+    TRACE_SPAN_END(engineSpan);
     UI ui(&ge);
     ge.startAudio();
+    TRACE_SPAN_END(startupSpan);
     // Start the Game/GUI loop
     while (ge.isOpen())
     {
+        TRACE_SCOPE("frame");
+        ge.getProfiler()->beginFrame();
+
         // Call the display function to do the OpenGL rendering.
         ge.display();
 
         // Process any events.
-        ui.processEvents();
+        {
+            ScopedPhase events(*ge.getProfiler(), PhaseEvents);
+            TRACE_SCOPE("processEvents");
+            ui.processEvents();
+        }
+
+        ge.getProfiler()->endFrame();
 
         //  Increment frame counts
         framecount++;
@@ -226,16 +290,25 @@ int main()
         float timesec = clock.getElapsedTime().asSeconds();
         char titlebar[1000];
 
-        //  If another second has elapsed, display the FPS and total FPS.
+        //  If another second has elapsed, display the FPS and the 99th percentile frame time of that second.
         if (timesec > 1.0)
         {
             float fps = framecount / timesec;
-            sprintf(titlebar, "%s     FPS: %.2f", programTitle.c_str(), fps);
+            ge.getProfiler()->snapshot(lastSecond, timesec);
+            double p99 = FrameProfiler::percentile(lastSecond, 99);
+            double latency, worstLatency;
+            if (ge.getInputLatency(&latency, &worstLatency))
+                sprintf(titlebar, "%s     FPS: %.2f     p99: %.1f ms     Latency: %.1f ms (worst %.1f ms)", programTitle.c_str(), fps, p99, latency, worstLatency);
+            else
+                sprintf(titlebar, "%s     FPS: %.2f     p99: %.1f ms", programTitle.c_str(), fps, p99);
             ge.setTitle(titlebar);
             time = clock.restart();
             framecount = 0;
         }
     }
 
+    if (TRACING_ENABLED && saveTrace(TracePath))
+        std::cout << "Saved the trace to " << TracePath << std::endl;
+
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,411 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include "SpectrumAnalyzer.h"
+#include "WavFile.h"
+#include "FileUtil.h"
+
+/**
+\file BatchAnalyzer.cpp
+\brief Analyses a library of tracks without a window, writing a timeline per track.
+
+Takes WAV files and folders of them, analyses several files at once and writes each track's
+bands as a SpectralTimeline the visualiser can open with TimelinePath.  Files run in parallel
+on --jobs workers and each file's frames on --threads analysis workers, so a library of short
+tracks keeps every core busy without splitting each track.  Ends with the throughput, files and
+hours of audio a second, and the peak resident memory.
+
+Only the analysis sources are linked, no SFML or OpenGL.  Tracks are read through WavFile, so
+they must be 16 bit, 24 bit or float WAV; other formats are reported and skipped.
+
+Build from this folder with, for example,
+
+~~~~~~~~~~~~~~~{.sh}
+g++ -O2 -std=c++11 -I../src BatchAnalyzer.cpp ../src/SpectrumAnalyzer.cpp ../src/FftPlanCache.cpp ../src/AnalysisKernels.cpp ../src/BandLayout.cpp ../src/WindowFunction.cpp ../src/WavFile.cpp ../src/MappedFile.cpp ../src/AnalysisCache.cpp ../src/AnalysisResult.cpp ../src/SpectralTimeline.cpp ../src/FileUtil.cpp ../src/OnsetDetector.cpp ../src/ConstantQKernel.cpp -lfftw3 -lfftw3f -lpthread -o BatchAnalyzer
+./BatchAnalyzer --out timelines --jobs 8 ~/Music/library
+~~~~~~~~~~~~~~~
+
+*/
+
+/**
+\brief Settings shared by every file of the run.
+
+*/
+
+struct BatchSettings
+{
+    std::string outDir;         ///< Folder for the timelines, empty to only analyse.
+    std::string cacheDir;       ///< Analysis cache folder, empty for none.
+    unsigned threads;           ///< Analysis workers per file.
+    int bits;                   ///< 8 or 16 bit timelines.
+    int hop;                    ///< Samples between frames.
+    WindowType window;          ///< Window applied to each frame.
+    bool single;                ///< Single precision analysis.
+    ChannelMode channels;       ///< How multichannel tracks are analysed.
+    BandScale scale;            ///< Band spacing.
+    int bands;                  ///< Band count, or bins per octave for constant-Q.
+    ResultLayout layout;        ///< How the results, and so the cached analyses, are laid out.
+};
+
+/**
+\brief Running totals, updated by every job.
+
+*/
+
+struct BatchTotals
+{
+    std::atomic<int> done;          ///< Files analysed.
+    std::atomic<int> failed;        ///< Files that could not be read or written.
+    std::mutex totalsMutex;         ///< Guards audioSeconds and the log.
+    double audioSeconds;            ///< Length of the audio analysed.
+};
+
+/**
+\brief Returns the peak resident memory of the process in bytes, 0 if unknown.
+
+*/
+
+static double peakResidentBytes()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return (double) counters.PeakWorkingSetSize;
+    return 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+#ifdef __APPLE__
+    return (double) usage.ru_maxrss;            // bytes on macOS
+#else
+    return (double) usage.ru_maxrss * 1024;     // kilobytes on Linux
+#endif
+#endif
+}
+
+/**
+\brief Returns true if the name ends in .wav, in any case.
+
+*/
+
+static bool isWavName(const std::string& name)
+{
+    if (name.size() < 4)
+        return false;
+    std::string ext = name.substr(name.size() - 4);
+    for (std::size_t i = 0; i < ext.size(); i++)
+        ext[i] = (char) tolower(ext[i]);
+    return ext == ".wav";
+}
+
+/**
+\brief Adds a file, or the WAV files of a folder and its subfolders, to the list.
+
+*/
+
+static void collectInputs(const std::string& path, std::vector<std::string>& files)
+{
+    if (!isDirectory(path))
+    {
+        files.push_back(path);
+        return;
+    }
+
+    std::vector<std::string> names;
+    if (!listDirectory(path, names))
+    {
+        fprintf(stderr, "cannot read folder %s\n", path.c_str());
+        return;
+    }
+    std::sort(names.begin(), names.end());
+    for (std::size_t i = 0; i < names.size(); i++)
+    {
+        std::string child = path + "/" + names[i];
+        if (isDirectory(child))
+            collectInputs(child, files);
+        else if (isWavName(names[i]))
+            files.push_back(child);
+    }
+}
+
+/**
+\brief Returns the file name without its folder or extension.
+
+*/
+
+static std::string baseName(const std::string& path)
+{
+    std::size_t slash = path.find_last_of("/\\");
+    std::string name = (slash == std::string::npos) ? path : path.substr(slash + 1);
+    std::size_t dot = name.find_last_of('.');
+    return (dot == std::string::npos || dot == 0) ? name : name.substr(0, dot);
+}
+
+/**
+\brief Analyses one file and writes its timelines.
+
+\param path --- the track.
+\param index --- the track's place in the list, keeps the timeline names of same named tracks apart.
+\param settings --- the run's settings.
+\param analyzer --- this job's analyser, reused from file to file.
+\param seconds --- output, length of the track.
+\param frames --- output, frames analysed.
+
+\return An error message, or NULL if it worked.
+
+*/
+
+static const char* analyseAndSave(const std::string& path, int index, const BatchSettings& settings,
+                                  SpectrumAnalyzer& analyzer, double* seconds, int* frames)
+{
+    WavFile wav;
+    if (!wav.open(path))
+        return "not a readable WAV file";
+
+    const SampleSpan& span = wav.getSamples();
+    unsigned int channels = (span.channels > 0) ? span.channels : 1;
+    *seconds = (double) span.count / channels / wav.getSampleRate();
+
+    analyzer.setSamples(span, wav.getSampleRate(), settings.single);
+    analyzer.setChannelMode(settings.channels);
+    analyzer.setHopSize(settings.hop);
+    analyzer.performFFT();
+    *frames = analyzer.getNumFrames();
+    if (!analyzer.isAnalysisComplete())
+        return "too short to analyse";
+
+    const char* error = NULL;
+    if (!settings.outDir.empty())
+    {
+        char prefix[16];
+        snprintf(prefix, sizeof(prefix), "%05d_", index);
+        std::string stem = settings.outDir + "/" + prefix + baseName(path);
+        int views = analyzer.getViewCount();
+        for (int v = 0; v < views && error == NULL; v++)
+        {
+            char suffix[32];
+            snprintf(suffix, sizeof(suffix), (views > 1) ? ".view%d.timeline" : ".timeline", v);
+            if (!analyzer.saveTimeline(stem + suffix, settings.bits, v))
+                error = "could not write the timeline";
+        }
+    }
+
+    analyzer.setSamples((double*) NULL, 0, wav.getSampleRate()); // forget the samples before the mapping goes
+    return error;
+}
+
+/**
+\brief One job, takes files off the list until there are none left.
+
+*/
+
+static void batchJob(const std::vector<std::string>* files, std::atomic<int>* next,
+                     const BatchSettings* settings, BatchTotals* totals)
+{
+    SpectrumAnalyzer analyzer;
+    analyzer.setThreadCount(settings->threads);
+    analyzer.setWindow(settings->window);
+    analyzer.setBandLayout(BandLayout(settings->scale, settings->bands));
+    analyzer.setResultLayout(settings->layout);
+    analyzer.setCacheDirectory(settings->cacheDir);
+
+    for (int i = next->fetch_add(1); i < (int) files->size(); i = next->fetch_add(1))
+    {
+        double seconds = 0;
+        int frames = 0;
+        const char* error = analyseAndSave((*files)[i], i, *settings, analyzer, &seconds, &frames);
+
+        std::lock_guard<std::mutex> lock(totals->totalsMutex);
+        if (error != NULL)
+        {
+            totals->failed++;
+            fprintf(stderr, "%s: %s\n", (*files)[i].c_str(), error);
+            continue;
+        }
+        totals->done++;
+        totals->audioSeconds += seconds;
+        printf("%5d/%d  %8.1f s  %8d frames  %s\n", totals->done + totals->failed, (int) files->size(),
+               seconds, frames, (*files)[i].c_str());
+    }
+}
+
+/**
+\brief Looks up a band scale by name.
+
+\return False if the name is unknown.
+
+*/
+
+static bool parseScale(const char* name, BandScale* scale)
+{
+    const char* names[] = {"classic", "linear", "log", "octave", "third", "mel", "bark", "cq"};
+    for (int s = BandClassic; s <= BandConstantQ; s++)
+    {
+        if (strcmp(name, names[s]) == 0)
+        {
+            *scale = (BandScale) s;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+\brief Prints the options.
+
+*/
+
+static void usage()
+{
+    printf("usage: BatchAnalyzer [options] file-or-folder ...\n"
+           "  --out DIR          write a timeline per track into DIR\n"
+           "  --jobs N           files analysed at once, default one per core\n"
+           "  --threads N        analysis workers per file, default 1\n"
+           "  --bits 8|16        timeline resolution, default 8\n"
+           "  --hop N            samples between frames\n"
+           "  --window NAME      rectangular, hann, blackman-harris or kaiser\n"
+           "  --precision P      single or double\n"
+           "  --channels MODE    downmix, split or midside\n"
+           "  --scale NAME       classic, linear, log, octave, third, mel, bark or cq\n"
+           "  --bands N          bands, or bins per octave for cq\n"
+           "  --cache DIR        reuse and keep analyses in DIR\n"
+           "  --layout L         frame or band major results, default frame\n");
+}
+
+/**
+\brief Batch analyser entry point.
+
+\return EXIT_SUCCESS if every file was analysed.
+
+*/
+
+int main(int argc, char** argv)
+{
+    BatchSettings settings;
+    settings.threads = 1;
+    settings.bits = 8;
+    settings.hop = AnalysisHopSize;
+    settings.window = AnalysisWindowType;
+    settings.single = SinglePrecisionAnalysis;
+    settings.channels = AnalysisChannelMode;
+    settings.scale = DefaultBandScale;
+    settings.bands = DefaultBandCount;
+    settings.layout = AnalysisResultLayout;
+    unsigned jobs = std::thread::hardware_concurrency();
+
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; i++)
+    {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0)
+        {
+            usage();
+            return EXIT_SUCCESS;
+        }
+        else if (strncmp(argv[i], "--", 2) != 0)
+            collectInputs(argv[i], files);
+        else if (!hasValue)
+        {
+            usage();
+            return EXIT_FAILURE;
+        }
+        else if (strcmp(argv[i], "--out") == 0)
+            settings.outDir = argv[++i];
+        else if (strcmp(argv[i], "--cache") == 0)
+            settings.cacheDir = argv[++i];
+        else if (strcmp(argv[i], "--jobs") == 0)
+            jobs = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--threads") == 0)
+            settings.threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--bits") == 0)
+            settings.bits = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--hop") == 0)
+            settings.hop = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--precision") == 0)
+            settings.single = strcmp(argv[++i], "single") == 0;
+        else if (strcmp(argv[i], "--bands") == 0)
+            settings.bands = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--channels") == 0)
+        {
+            i++;
+            settings.channels = (strcmp(argv[i], "split") == 0) ? ChannelSplit
+                              : (strcmp(argv[i], "midside") == 0) ? ChannelMidSide : ChannelDownmix;
+        }
+        else if (strcmp(argv[i], "--layout") == 0)
+            settings.layout = (strcmp(argv[++i], "band") == 0) ? ResultBandMajor : ResultFrameMajor;
+        else if (strcmp(argv[i], "--window") == 0)
+        {
+            i++;
+            for (int w = WindowRectangular; w <= WindowKaiser; w++)
+                if (strcmp(argv[i], windowName((WindowType) w)) == 0)
+                    settings.window = (WindowType) w;
+        }
+        else if (strcmp(argv[i], "--scale") == 0)
+        {
+            if (!parseScale(argv[++i], &settings.scale))
+            {
+                fprintf(stderr, "unknown band scale %s\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+        }
+        else
+        {
+            usage();
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (files.empty())
+    {
+        usage();
+        return EXIT_FAILURE;
+    }
+    if (!settings.outDir.empty())
+        makeDirectory(settings.outDir); // fails harmlessly if it is already there
+    jobs = (jobs < 1) ? 1 : (jobs > files.size() ? (unsigned) files.size() : jobs);
+    settings.threads = (settings.threads < 1) ? 1 : settings.threads;
+
+    printf("%d file(s), %u job(s) x %u analysis thread(s), %s precision (%s kernels)\n",
+           (int) files.size(), jobs, settings.threads, settings.single ? "single" : "double", magnitudeKernelName());
+
+    BatchTotals totals;
+    totals.done = 0;
+    totals.failed = 0;
+    totals.audioSeconds = 0;
+    std::atomic<int> next(0);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::vector<std::thread> pool;
+    for (unsigned j = 1; j < jobs; j++)
+        pool.push_back(std::thread(batchJob, &files, &next, &settings, &totals));
+    batchJob(&files, &next, &settings, &totals); // this thread is a job too
+    for (std::size_t j = 0; j < pool.size(); j++)
+        pool[j].join();
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    FftPlanCache::instance().saveWisdom();
+
+    wall = (wall > 0) ? wall : 1e-9;
+    printf("\n%d analysed, %d failed, %.2f h of audio in %.2f s\n", (int) totals.done, (int) totals.failed,
+           totals.audioSeconds / 3600, wall);
+    printf("%.2f files/s, %.3f audio-hours/s, peak RSS %.1f MB\n", totals.done / wall,
+           totals.audioSeconds / 3600 / wall, peakResidentBytes() / (1024 * 1024));
+
+    return (totals.failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}